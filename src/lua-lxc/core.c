@@ -36,6 +36,7 @@
 #define luaL_newlib(L,l) (lua_newtable(L), luaL_register(L,NULL,l))
 #define luaL_setfuncs(L,l,n) (assert(n==0), luaL_register(L,NULL,l))
 #define luaL_checkunsigned(L,n) luaL_checknumber(L,n)
+#define lua_rawlen(L,i) lua_objlen(L,i)
 #endif
 
 #ifdef NO_CHECK_UDATA
@@ -306,6 +307,42 @@ not_found:
     return 1;
 }
 
+static int container_get_cgroup_items(lua_State *L)
+{
+    struct lxc_container *c = lua_unboxpointer(L, 1, CONTAINER_TYPENAME);
+    struct lxc_cgroup_item *items;
+    const char **keys;
+    int i, n, count;
+
+    luaL_checktype(L, 2, LUA_TTABLE);
+    n = lua_rawlen(L, 2);
+
+    keys = alloca(sizeof(char *) * (n + 1));
+    for (i = 0; i < n; i++) {
+	lua_rawgeti(L, 2, i + 1);
+	keys[i] = luaL_checkstring(L, -1);
+	lua_pop(L, 1);
+    }
+    keys[n] = NULL;
+
+    count = c->get_cgroup_items(c, keys, &items);
+    if (count < 0) {
+	lua_pushnil(L);
+	return 1;
+    }
+
+    lua_newtable(L);
+    for (i = 0; i < count; i++) {
+	if (items[i].value) {
+	    lua_pushstring(L, items[i].value);
+	    lua_setfield(L, -2, items[i].key);
+	}
+	items[i].free(&items[i]);
+    }
+    free(items);
+    return 1;
+}
+
 static int container_get_config_item(lua_State *L)
 {
     struct lxc_container *c = lua_unboxpointer(L, 1, CONTAINER_TYPENAME);
@@ -396,6 +433,7 @@ static luaL_Reg lxc_container_methods[] =
     {"load_config",		container_load_config},
     {"save_config",		container_save_config},
     {"get_cgroup_item",		container_get_cgroup_item},
+    {"get_cgroup_items",	container_get_cgroup_items},
     {"set_cgroup_item",		container_set_cgroup_item},
     {"get_config_path",		container_get_config_path},
     {"set_config_path",		container_set_config_path},
@@ -441,6 +479,32 @@ not_found:
     return 1;
 }
 
+static int lxc_shutdown_containers_lua(lua_State *L)
+{
+    struct lxc_container **containers;
+    int timeout = luaL_optinteger(L, 2, -1);
+    int count, i, ret;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    count = lua_rawlen(L, 1);
+    /* userdata, so it is collected even if a check below raises */
+    containers = lua_newuserdata(L, (count ? count : 1) * sizeof(*containers));
+    for (i = 0; i < count; i++) {
+	lua_rawgeti(L, 1, i + 1);
+	containers[i] = lua_unboxpointer(L, -1, CONTAINER_TYPENAME);
+	lua_pop(L, 1);
+    }
+
+    ret = lxc_shutdown_containers(containers, count, timeout);
+    if (ret < 0) {
+	lua_pushnil(L);
+	return 1;
+    }
+
+    lua_pushinteger(L, ret);
+    return 1;
+}
+
 /* utility functions */
 static int lxc_util_usleep(lua_State *L) {
     usleep((useconds_t)luaL_checkunsigned(L, 1));
@@ -458,6 +522,7 @@ static luaL_Reg lxc_lib_methods[] = {
     {"default_config_path_get",	lxc_default_config_path_get},
     {"cmd_get_config_item",	cmd_get_config_item},
     {"container_new",		container_new},
+    {"shutdown_containers",	lxc_shutdown_containers_lua},
     {"usleep",			lxc_util_usleep},
     {"dirname",			lxc_util_dirname},
     {NULL, NULL}
@@ -167,6 +167,10 @@ function container:get_cgroup_item(key)
     return self.core:get_cgroup_item(key)
 end
 
+function container:get_cgroup_items(keys)
+    return self.core:get_cgroup_items(keys)
+end
+
 function container:get_config_item(key)
     local value
     local vals = {}
@@ -377,6 +381,17 @@ function M.containers_running(names_only)
     return containers
 end
 
+-- shut down several containers at once, stopping the ones still running
+-- after timeout seconds; returns the number of clean shutdowns
+function M.containers_shutdown(containers, timeout)
+    local cores = {}
+
+    for _,ct in ipairs(containers) do
+	table.insert(cores, ct.core)
+    end
+    return core.shutdown_containers(cores, timeout or -1)
+end
+
 function M.version_get()
     return core.version_get()
 end
@@ -215,6 +215,14 @@ function test_container_cgroup()
     assert(container:set_cgroup_item("memory.limit_in_bytes", max_mem))
     assert(container:get_cgroup_item("memory.limit_in_bytes") ~= saved_limit)
     assert(container:set_cgroup_item("memory.limit_in_bytes", "-1"))
+
+    items = container:get_cgroup_items({"memory.limit_in_bytes",
+                                        "memory.max_usage_in_bytes",
+                                        "memory.no_such_file"})
+    assert(items["memory.max_usage_in_bytes"] ~= nil)
+    assert(items["memory.limit_in_bytes"] ==
+           container:get_cgroup_item("memory.limit_in_bytes"))
+    assert(items["memory.no_such_file"] == nil)
 end
 
 function test_container_cmd()
@@ -230,7 +230,8 @@ int lxc_abstract_unix_send_credential(int fd, void *data, size_t size)
 	msg.msg_iov = &iov;
 	msg.msg_iovlen = 1;
 
-	return sendmsg(fd, &msg, 0);
+	/* the peer going away must not kill us with SIGPIPE */
+	return sendmsg(fd, &msg, MSG_NOSIGNAL);
 }
 
 int lxc_abstract_unix_rcv_credential(int fd, void *data, size_t size)
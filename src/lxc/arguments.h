@@ -93,6 +93,7 @@ struct lxc_arguments {
 	int ignore_auto;
 	int list;
 	char *groups;
+	int jobs;
 
 	/* remaining arguments */
 	char *const *argv;
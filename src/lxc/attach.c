@@ -1093,6 +1093,7 @@ int lxc_attach_run_command(void* payload)
 {
 	lxc_attach_command_t* cmd = (lxc_attach_command_t*)payload;
 
+	lxc_log_flush();
 	execvp(cmd->program, cmd->argv);
 	SYSERROR("failed to exec '%s'", cmd->program);
 	return -1;
@@ -1122,6 +1123,7 @@ int lxc_attach_run_shell(void* payload)
 	else
 		user_shell = passwd->pw_shell;
 
+	lxc_log_flush();
 	if (user_shell)
 		execlp(user_shell, user_shell, NULL);
 
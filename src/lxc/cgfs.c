@@ -30,6 +30,8 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/param.h>
@@ -123,6 +125,35 @@ struct cgfs_data {
 	struct cgroup_process_info *info;
 };
 
+/*
+ * cgroup_path_cache_entry: the absolute path of the cgroup of a
+ *                          container in the hierarchy of a subsystem
+ */
+struct cgroup_path_cache_entry {
+	struct cgroup_path_cache_entry *next;
+	char *name;
+	char *lxcpath;
+	char *subsystem;
+	char *path;
+};
+
+/*
+ * cgroup_meta_cache: metadata and resolved container paths cached
+ *                    for lxc_cgroupfs_get/set
+ *
+ * The metadata is refcounted without any locking, so the cache is
+ * kept per thread. It is dropped whenever /proc/self/mountinfo
+ * signals a change of the mount table or when we are running in
+ * a different process than the one which filled it (i.e. after
+ * a fork).
+ */
+struct cgroup_meta_cache {
+	pid_t pid;
+	int mountinfo_fd;
+	struct cgroup_meta_data *meta;
+	struct cgroup_path_cache_entry *paths;
+};
+
 lxc_log_define(lxc_cgfs, lxc);
 
 static struct cgroup_process_info *lxc_cgroup_process_info_getx(const char *proc_pid_cgroup_str, struct cgroup_meta_data *meta);
@@ -136,6 +167,7 @@ static char *cgroup_to_absolute_path(struct cgroup_mount_point *mp, const char *
 static struct cgroup_process_info *find_info_for_subsystem(struct cgroup_process_info *info, const char *subsystem);
 static int do_cgroup_get(const char *cgroup_path, const char *sub_filename, char *value, size_t len);
 static int do_cgroup_set(const char *cgroup_path, const char *sub_filename, const char *value);
+static char *do_cgroup_read(const char *cgroup_path, const char *sub_filename);
 static bool cgroup_devices_has_allow_or_deny(struct cgfs_data *d, char *v, bool for_allow);
 static int do_setup_cgroup_limits(struct cgfs_data *d, struct lxc_list *cgroup_settings, bool do_devices);
 static int cgroup_recursive_task_count(const char *cgroup_path);
@@ -612,6 +644,126 @@ static struct cgroup_meta_data *lxc_cgroup_put_meta(struct cgroup_meta_data *met
 	return NULL;
 }
 
+static pthread_key_t cgroup_meta_cache_key;
+static pthread_once_t cgroup_meta_cache_once = PTHREAD_ONCE_INIT;
+
+static void cgroup_meta_cache_clear(struct cgroup_meta_cache *cache)
+{
+	struct cgroup_path_cache_entry *entry, *next;
+
+	for (entry = cache->paths; entry; entry = next) {
+		next = entry->next;
+		free(entry->name);
+		free(entry->lxcpath);
+		free(entry->subsystem);
+		free(entry->path);
+		free(entry);
+	}
+	cache->paths = NULL;
+	cache->meta = lxc_cgroup_put_meta(cache->meta);
+	if (cache->mountinfo_fd >= 0)
+		close(cache->mountinfo_fd);
+	cache->mountinfo_fd = -1;
+}
+
+static void cgroup_meta_cache_free(void *data)
+{
+	struct cgroup_meta_cache *cache = data;
+
+	cgroup_meta_cache_clear(cache);
+	free(cache);
+}
+
+static void cgroup_meta_cache_key_init(void)
+{
+	if (pthread_key_create(&cgroup_meta_cache_key, cgroup_meta_cache_free))
+		ERROR("failed to create cgroup metadata cache key");
+}
+
+/*
+ * The kernel reports POLLERR|POLLPRI on an open mountinfo file
+ * once after each change to the mount namespace.
+ */
+static bool mountinfo_changed(int fd)
+{
+	struct pollfd pfd = {
+		.fd = fd,
+		.events = POLLPRI,
+	};
+
+	if (poll(&pfd, 1, 0) < 0)
+		return true;
+	return (pfd.revents & (POLLERR | POLLPRI)) != 0;
+}
+
+/*
+ * Return this thread's cache, (re)loading the metadata if necessary.
+ * Returns NULL if the metadata can't be cached, in which case callers
+ * should fall back to lxc_cgroup_load_meta().
+ */
+static struct cgroup_meta_cache *cgroup_meta_cache_get(void)
+{
+	struct cgroup_meta_cache *cache;
+
+	if (pthread_once(&cgroup_meta_cache_once, cgroup_meta_cache_key_init))
+		return NULL;
+
+	cache = pthread_getspecific(cgroup_meta_cache_key);
+	if (!cache) {
+		cache = calloc(1, sizeof(*cache));
+		if (!cache)
+			return NULL;
+		cache->mountinfo_fd = -1;
+		if (pthread_setspecific(cgroup_meta_cache_key, cache)) {
+			free(cache);
+			return NULL;
+		}
+	}
+
+	/*
+	 * After a fork, the fd may have been closed by lxc_check_inherited()
+	 * and its number reused, so leave it alone - it is O_CLOEXEC anyway.
+	 */
+	if (cache->pid != getpid())
+		cache->mountinfo_fd = -1;
+
+	if (cache->meta && (cache->mountinfo_fd < 0 ||
+			    mountinfo_changed(cache->mountinfo_fd))) {
+		DEBUG("mount table changed, dropping cached cgroup metadata");
+		cgroup_meta_cache_clear(cache);
+	}
+
+	if (cache->meta)
+		return cache;
+
+	/* open mountinfo first so that no change can slip through */
+	cache->mountinfo_fd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+	if (cache->mountinfo_fd < 0)
+		return NULL;
+	cache->meta = lxc_cgroup_load_meta();
+	if (!cache->meta) {
+		cgroup_meta_cache_clear(cache);
+		return NULL;
+	}
+	cache->pid = getpid();
+	return cache;
+}
+
+/*
+ * Like lxc_cgroup_load_meta(), but share the cached metadata when
+ * possible. The caller must not modify the result and has to drop
+ * it with lxc_cgroup_put_meta().
+ */
+static struct cgroup_meta_data *lxc_cgroup_load_meta_cached(void)
+{
+	struct cgroup_meta_cache *cache;
+
+	cache = cgroup_meta_cache_get();
+	if (cache)
+		return lxc_cgroup_get_meta(cache->meta);
+	return lxc_cgroup_load_meta();
+}
+
 static struct cgroup_hierarchy *lxc_cgroup_find_hierarchy(struct cgroup_meta_data *meta_data, const char *subsystem)
 {
 	size_t i;
@@ -671,7 +823,7 @@ static char *lxc_cgroup_find_abs_path(const char *subsystem, const char *group,
 	char *result;
 	int saved_errno;
 
-	meta_data = lxc_cgroup_load_meta();
+	meta_data = lxc_cgroup_load_meta_cached();
 	if (!meta_data)
 		return NULL;
 
@@ -1241,35 +1393,127 @@ static char *lxc_cgroup_get_hierarchy_abs_path_data(const char *subsystem, struc
 	return cgroup_to_absolute_path(mp, info->cgroup_path, NULL);
 }
 
-static char *lxc_cgroup_get_hierarchy_abs_path(const char *subsystem, const char *name, const char *lxcpath)
+/*
+ * Resolve the absolute path of a container's cgroup in the hierarchy
+ * of subsystem. Only the one hierarchy we need is asked for over the
+ * command socket, and meta is not modified.
+ */
+static char *lxc_cgroup_resolve_abs_path(struct cgroup_meta_data *meta, const char *subsystem, const char *name, const char *lxcpath)
 {
-	struct cgroup_meta_data *meta;
-	struct cgroup_process_info *base_info, *info;
+	struct cgroup_hierarchy *h;
 	struct cgroup_mount_point *mp;
-	char *result = NULL;
+	char *cgroup_path, *result = NULL;
 
-	meta = lxc_cgroup_load_meta();
-	if (!meta)
+	h = lxc_cgroup_find_hierarchy(meta, subsystem);
+	if (!h || !h->used)
 		return NULL;
-	base_info = lxc_cgroup_get_container_info(name, lxcpath, meta);
-	if (!base_info)
-		goto out1;
-	info = find_info_for_subsystem(base_info, subsystem);
-	if (!info)
-		goto out2;
-	if (info->designated_mount_point) {
-		mp = info->designated_mount_point;
-	} else {
-		mp = lxc_cgroup_find_mount_point(info->hierarchy, info->cgroup_path, true);
-		if (!mp)
-			goto out3;
-	}
-	result = cgroup_to_absolute_path(mp, info->cgroup_path, NULL);
-out3:
-out2:
-	lxc_cgroup_process_info_free(base_info);
-out1:
-	lxc_cgroup_put_meta(meta);
+
+	cgroup_path = lxc_cmd_get_cgroup_path(name, lxcpath, h->subsystems[0]);
+	if (!cgroup_path)
+		return NULL;
+
+	mp = lxc_cgroup_find_mount_point(h, cgroup_path, true);
+	if (mp)
+		result = cgroup_to_absolute_path(mp, cgroup_path, NULL);
+	free(cgroup_path);
+	return result;
+}
+
+static void cgroup_path_cache_add(struct cgroup_meta_cache *cache, const char *subsystem, const char *name, const char *lxcpath, const char *path)
+{
+	struct cgroup_path_cache_entry *entry;
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return;
+	entry->name = strdup(name);
+	entry->lxcpath = strdup(lxcpath);
+	entry->subsystem = strdup(subsystem);
+	entry->path = strdup(path);
+	if (!entry->name || !entry->lxcpath || !entry->subsystem || !entry->path) {
+		free(entry->name);
+		free(entry->lxcpath);
+		free(entry->subsystem);
+		free(entry->path);
+		free(entry);
+		return;
+	}
+	entry->next = cache->paths;
+	cache->paths = entry;
+}
+
+static struct cgroup_path_cache_entry **cgroup_path_cache_find(struct cgroup_meta_cache *cache, const char *subsystem, const char *name, const char *lxcpath)
+{
+	struct cgroup_path_cache_entry **entry;
+
+	for (entry = &cache->paths; *entry; entry = &(*entry)->next) {
+		if (strcmp((*entry)->name, name) == 0 &&
+		    strcmp((*entry)->lxcpath, lxcpath) == 0 &&
+		    strcmp((*entry)->subsystem, subsystem) == 0)
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * Drop a cached path, e.g. because the container was restarted in
+ * a different cgroup.
+ */
+static void cgroup_path_cache_forget(const char *subsystem, const char *name, const char *lxcpath)
+{
+	struct cgroup_meta_cache *cache;
+	struct cgroup_path_cache_entry **entry, *victim;
+
+	cache = pthread_getspecific(cgroup_meta_cache_key);
+	if (!cache)
+		return;
+	entry = cgroup_path_cache_find(cache, subsystem, name, lxcpath);
+	if (!entry)
+		return;
+	victim = *entry;
+	*entry = victim->next;
+	free(victim->name);
+	free(victim->lxcpath);
+	free(victim->subsystem);
+	free(victim->path);
+	free(victim);
+}
+
+/*
+ * Get the absolute path of a container's cgroup for subsystem. If
+ * cached is not NULL, it is set to whether the path came from the
+ * cache (and so may be stale).
+ */
+static char *lxc_cgroup_get_hierarchy_abs_path(const char *subsystem, const char *name, const char *lxcpath, bool *cached)
+{
+	struct cgroup_meta_cache *cache;
+	struct cgroup_meta_data *meta;
+	struct cgroup_path_cache_entry **entry;
+	char *result;
+
+	if (cached)
+		*cached = false;
+
+	cache = cgroup_meta_cache_get();
+	if (!cache) {
+		meta = lxc_cgroup_load_meta();
+		if (!meta)
+			return NULL;
+		result = lxc_cgroup_resolve_abs_path(meta, subsystem, name, lxcpath);
+		lxc_cgroup_put_meta(meta);
+		return result;
+	}
+
+	entry = cgroup_path_cache_find(cache, subsystem, name, lxcpath);
+	if (entry) {
+		if (cached)
+			*cached = true;
+		return strdup((*entry)->path);
+	}
+
+	result = lxc_cgroup_resolve_abs_path(cache->meta, subsystem, name, lxcpath);
+	if (result)
+		cgroup_path_cache_add(cache, subsystem, name, lxcpath, result);
 	return result;
 }
 
@@ -1294,37 +1538,83 @@ static int lxc_cgroup_set_data(const char *filename, const char *value, struct c
 static int lxc_cgroupfs_set(const char *filename, const char *value, const char *name, const char *lxcpath)
 {
 	char *subsystem = NULL, *p, *path;
-	int ret = -1;
+	bool cached;
+	int ret;
 
 	subsystem = alloca(strlen(filename) + 1);
 	strcpy(subsystem, filename);
 	if ((p = index(subsystem, '.')) != NULL)
 		*p = '\0';
 
-	path = lxc_cgroup_get_hierarchy_abs_path(subsystem, name, lxcpath);
-	if (path) {
+	for (;;) {
+		path = lxc_cgroup_get_hierarchy_abs_path(subsystem, name, lxcpath, &cached);
+		if (!path)
+			return -1;
 		ret = do_cgroup_set(path, filename, value);
 		free(path);
+		/* a cached path is stale if the container was restarted */
+		if (ret >= 0 || !cached || errno != ENOENT)
+			return ret;
+		cgroup_path_cache_forget(subsystem, name, lxcpath);
 	}
-	return ret;
 }
 
 static int lxc_cgroupfs_get(const char *filename, char *value, size_t len, const char *name, const char *lxcpath)
 {
 	char *subsystem = NULL, *p, *path;
-	int ret = -1;
+	bool cached;
+	int ret;
 
 	subsystem = alloca(strlen(filename) + 1);
 	strcpy(subsystem, filename);
 	if ((p = index(subsystem, '.')) != NULL)
 		*p = '\0';
 
-	path = lxc_cgroup_get_hierarchy_abs_path(subsystem, name, lxcpath);
-	if (path) {
+	for (;;) {
+		path = lxc_cgroup_get_hierarchy_abs_path(subsystem, name, lxcpath, &cached);
+		if (!path)
+			return -1;
 		ret = do_cgroup_get(path, filename, value, len);
 		free(path);
+		/* a cached path is stale if the container was restarted */
+		if (ret >= 0 || !cached || errno != ENOENT)
+			return ret;
+		cgroup_path_cache_forget(subsystem, name, lxcpath);
 	}
-	return ret;
+}
+
+static int lxc_cgroupfs_get_items(const char **filenames, char **values, const char *name, const char *lxcpath)
+{
+	char *subsystem, *p, *path;
+	bool cached;
+	int i, count = 0;
+
+	for (i = 0; filenames[i]; i++) {
+		values[i] = NULL;
+
+		subsystem = strdup(filenames[i]);
+		if (!subsystem)
+			continue;
+		if ((p = index(subsystem, '.')) != NULL)
+			*p = '\0';
+
+		for (;;) {
+			path = lxc_cgroup_get_hierarchy_abs_path(subsystem, name, lxcpath, &cached);
+			if (!path)
+				break;
+			values[i] = do_cgroup_read(path, filenames[i]);
+			free(path);
+			/* a cached path is stale if the container was restarted */
+			if (values[i] || !cached || errno != ENOENT)
+				break;
+			cgroup_path_cache_forget(subsystem, name, lxcpath);
+		}
+		free(subsystem);
+
+		if (values[i])
+			count++;
+	}
+	return count;
 }
 
 static bool cgroupfs_mount_cgroup(void *hdata, const char *root, int type)
@@ -1826,6 +2116,61 @@ static int do_cgroup_get(const char *cgroup_path, const char *sub_filename,
 	return ret;
 }
 
+/* read a whole cgroup file, which may be larger than a page */
+static char *do_cgroup_read(const char *cgroup_path, const char *sub_filename)
+{
+	const char *parts[3] = {
+		cgroup_path,
+		sub_filename,
+		NULL
+	};
+	char *filename, *buf = NULL, *newbuf;
+	size_t len = 0, size = 0;
+	ssize_t ret;
+	int fd, saved_errno;
+
+	filename = lxc_string_join("/", parts, false);
+	if (!filename)
+		return NULL;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	saved_errno = errno;
+	free(filename);
+	if (fd < 0) {
+		errno = saved_errno;
+		return NULL;
+	}
+
+	for (;;) {
+		if (size - len < 2) {
+			size = size ? size * 2 : 4096;
+			newbuf = realloc(buf, size);
+			if (!newbuf)
+				goto out_error;
+			buf = newbuf;
+		}
+		ret = read(fd, buf + len, size - len - 1);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			goto out_error;
+		}
+		if (ret == 0)
+			break;
+		len += ret;
+	}
+	buf[len] = '\0';
+	close(fd);
+	return buf;
+
+out_error:
+	saved_errno = errno;
+	free(buf);
+	close(fd);
+	errno = saved_errno;
+	return NULL;
+}
+
 static int do_cgroup_set(const char *cgroup_path, const char *sub_filename,
 			 const char *value)
 {
@@ -2349,6 +2694,7 @@ static struct cgroup_ops cgfs_ops = {
 	.create_legacy = cgfs_create_legacy,
 	.get_cgroup = cgfs_get_cgroup,
 	.get = lxc_cgroupfs_get,
+	.get_items = lxc_cgroupfs_get_items,
 	.set = lxc_cgroupfs_set,
 	.unfreeze = cgfs_unfreeze,
 	.setup_limits = cgroupfs_setup_limits,
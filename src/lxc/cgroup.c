@@ -21,6 +21,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdlib.h>
+
 #include "cgroup.h"
 #include "conf.h"
 #include "log.h"
@@ -168,6 +170,40 @@ int lxc_cgroup_get(const char *filename, char *value, size_t len, const char *na
 	return -1;
 }
 
+/*
+ * Read the full contents of several cgroup files of a container. Drivers
+ * which can't do better fall back to two get calls per file (one for the
+ * size and one for the value).
+ */
+int lxc_cgroup_get_items(const char **filenames, char **values, const char *name, const char *lxcpath)
+{
+	int i, len, count = 0;
+
+	if (!ops)
+		return -1;
+	if (ops->get_items)
+		return ops->get_items(filenames, values, name, lxcpath);
+
+	for (i = 0; filenames[i]; i++) {
+		values[i] = NULL;
+		len = ops->get(filenames[i], NULL, 0, name, lxcpath);
+		if (len < 0)
+			continue;
+		values[i] = malloc(len + 1);
+		if (!values[i])
+			continue;
+		len = ops->get(filenames[i], values[i], len + 1, name, lxcpath);
+		if (len < 0) {
+			free(values[i]);
+			values[i] = NULL;
+			continue;
+		}
+		values[i][len] = '\0';
+		count++;
+	}
+	return count;
+}
+
 void cgroup_disconnect(void)
 {
 	if (ops && ops->disconnect)
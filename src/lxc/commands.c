@@ -32,6 +32,7 @@
 #include <sys/param.h>
 #include <malloc.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "log.h"
 #include "lxc.h"
@@ -44,6 +45,7 @@
 #include "confile.h"
 #include "mainloop.h"
 #include "af_unix.h"
+#include "trace.h"
 #include "config.h"
 
 /*
@@ -69,6 +71,12 @@
  * This is necessary in order to avoid having a newly compiled lxc command
  * communicating with a running (old) monitor from crashing the running
  * container.
+ *
+ * The server keeps a client connection in its mainloop until the client
+ * closes it, and answers the requests on a connection in the order it
+ * received them. Clients polling a container can therefore keep one
+ * connection open (see struct lxc_cmd_conn) and send several requests
+ * before reading the responses, without any change to the protocol.
  */
 
 lxc_log_define(lxc_commands, lxc);
@@ -105,6 +113,9 @@ static const char *lxc_cmd_str(lxc_cmd_t cmd)
 		[LXC_CMD_GET_CLONE_FLAGS] = "get_clone_flags",
 		[LXC_CMD_GET_CGROUP]      = "get_cgroup",
 		[LXC_CMD_GET_CONFIG_ITEM] = "get_config_item",
+		[LXC_CMD_GET_TRACE]       = "get_trace",
+		[LXC_CMD_UNPARK]          = "unpark",
+		[LXC_CMD_CONSOLE_LOG]     = "console_log",
 	};
 
 	if (cmd >= LXC_CMD_MAX)
@@ -163,7 +174,8 @@ static int lxc_cmd_rsp_recv(int sock, struct lxc_cmd_rr *cmd)
 
 	if (rsp->datalen == 0)
 		return ret;
-	if (rsp->datalen > LXC_CMD_DATA_MAX) {
+	if (rsp->datalen > (cmd->req.cmd == LXC_CMD_CONSOLE_LOG ?
+			    LXC_CONSOLE_BUFFER_MAX : LXC_CMD_DATA_MAX)) {
 		ERROR("command %s response data %d too long",
 		      lxc_cmd_str(cmd->req.cmd), rsp->datalen);
 		errno = EFBIG;
@@ -176,7 +188,7 @@ static int lxc_cmd_rsp_recv(int sock, struct lxc_cmd_rr *cmd)
 		      lxc_cmd_str(cmd->req.cmd));
 		return -1;
 	}
-	ret = recv(sock, rsp->data, rsp->datalen, 0);
+	ret = recv(sock, rsp->data, rsp->datalen, MSG_WAITALL);
 	if (ret != rsp->datalen) {
 		ERROR("command %s failed to receive response data",
 		      lxc_cmd_str(cmd->req.cmd));
@@ -217,6 +229,56 @@ static int lxc_cmd_rsp_send(int fd, struct lxc_cmd_rsp *rsp)
 	return 0;
 }
 
+static int lxc_cmd_connect(const char *name, const char *lxcpath,
+			   lxc_cmd_t cmd, int *stopped)
+{
+	int sock;
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)] = { 0 };
+	char *offset = &path[1];
+	int len;
+
+	len = sizeof(path)-1;
+	if (fill_sock_name(offset, len, name, lxcpath))
+		return -1;
+
+	sock = lxc_abstract_unix_connect(path);
+	if (sock < 0) {
+		if (errno == ECONNREFUSED)
+			*stopped = 1;
+		else
+			SYSERROR("command %s failed to connect to '@%s'",
+				 lxc_cmd_str(cmd), offset);
+		return -1;
+	}
+	return sock;
+}
+
+static int lxc_cmd_req_send(int sock, struct lxc_cmd_req *req)
+{
+	int ret;
+
+	ret = lxc_abstract_unix_send_credential(sock, req, sizeof(*req));
+	if (ret != sizeof(*req)) {
+		SYSERROR("command %s failed to send req %d",
+			 lxc_cmd_str(req->cmd), ret);
+		if (ret >=0)
+			ret = -1;
+		return ret;
+	}
+
+	if (req->datalen > 0) {
+		ret = send(sock, req->data, req->datalen, MSG_NOSIGNAL);
+		if (ret != req->datalen) {
+			SYSERROR("command %s failed to send request data %d",
+				 lxc_cmd_str(req->cmd), ret);
+			if (ret >=0)
+				ret = -1;
+			return ret;
+		}
+	}
+	return 0;
+}
+
 /*
  * lxc_cmd: Connect to the specified running container, send it a command
  * request and collect the response
@@ -240,46 +302,17 @@ static int lxc_cmd(const char *name, struct lxc_cmd_rr *cmd, int *stopped,
 		   const char *lxcpath)
 {
 	int sock, ret = -1;
-	char path[sizeof(((struct sockaddr_un *)0)->sun_path)] = { 0 };
-	char *offset = &path[1];
-	int len;
 	int stay_connected = cmd->req.cmd == LXC_CMD_CONSOLE;
 
 	*stopped = 0;
 
-	len = sizeof(path)-1;
-	if (fill_sock_name(offset, len, name, lxcpath))
-		return -1;
-
-	sock = lxc_abstract_unix_connect(path);
-	if (sock < 0) {
-		if (errno == ECONNREFUSED)
-			*stopped = 1;
-		else
-			SYSERROR("command %s failed to connect to '@%s'",
-				 lxc_cmd_str(cmd->req.cmd), offset);
+	sock = lxc_cmd_connect(name, lxcpath, cmd->req.cmd, stopped);
+	if (sock < 0)
 		return -1;
-	}
 
-	ret = lxc_abstract_unix_send_credential(sock, &cmd->req, sizeof(cmd->req));
-	if (ret != sizeof(cmd->req)) {
-		SYSERROR("command %s failed to send req to '@%s' %d",
-			 lxc_cmd_str(cmd->req.cmd), offset, ret);
-		if (ret >=0)
-			ret = -1;
+	ret = lxc_cmd_req_send(sock, &cmd->req);
+	if (ret < 0)
 		goto out;
-	}
-
-	if (cmd->req.datalen > 0) {
-		ret = send(sock, cmd->req.data, cmd->req.datalen, 0);
-		if (ret != cmd->req.datalen) {
-			SYSERROR("command %s failed to send request data to '@%s' %d",
-				 lxc_cmd_str(cmd->req.cmd), offset, ret);
-			if (ret >=0)
-				ret = -1;
-			goto out;
-		}
-	}
 
 	ret = lxc_cmd_rsp_recv(sock, cmd);
 out:
@@ -291,6 +324,209 @@ out:
 	return ret;
 }
 
+/*
+ * lxc_cmd_conn: a connection to the command socket of a container which
+ * is kept open across commands. It is (re)connected on demand, so it can
+ * be created before the container is started and survives restarts.
+ */
+struct lxc_cmd_conn {
+	pthread_mutex_t lock;
+	int sock;
+	pid_t pid;	/* process owning sock, we don't share it across fork */
+	char *name;	/* container sock is connected to */
+	char *lxcpath;
+};
+
+struct lxc_cmd_conn *lxc_cmd_conn_new(void)
+{
+	struct lxc_cmd_conn *conn;
+
+	conn = calloc(1, sizeof(*conn));
+	if (!conn)
+		return NULL;
+	if (pthread_mutex_init(&conn->lock, NULL)) {
+		free(conn);
+		return NULL;
+	}
+	conn->sock = -1;
+	return conn;
+}
+
+static void lxc_cmd_conn_close(struct lxc_cmd_conn *conn)
+{
+	if (conn->sock >= 0)
+		close(conn->sock);
+	conn->sock = -1;
+	free(conn->name);
+	conn->name = NULL;
+	free(conn->lxcpath);
+	conn->lxcpath = NULL;
+}
+
+void lxc_cmd_conn_free(struct lxc_cmd_conn *conn)
+{
+	if (!conn)
+		return;
+	lxc_cmd_conn_close(conn);
+	pthread_mutex_destroy(&conn->lock);
+	free(conn);
+}
+
+/*
+ * An idle connection has nothing to read, unless the server closed it
+ * (i.e. the container stopped or was restarted since we last used it).
+ */
+static bool lxc_cmd_conn_is_stale(struct lxc_cmd_conn *conn)
+{
+	struct pollfd pfd = {
+		.fd = conn->sock,
+		.events = POLLIN,
+	};
+
+	return poll(&pfd, 1, 0) != 0;
+}
+
+/*
+ * Make sure conn is connected to the command socket of the container,
+ * returns 1 if an existing connection is reused, 0 if a new one was
+ * made and < 0 on failure
+ */
+static int lxc_cmd_conn_connect(struct lxc_cmd_conn *conn, const char *name,
+				const char *lxcpath, lxc_cmd_t cmd,
+				int *stopped)
+{
+	if (conn->sock >= 0 && conn->pid == getpid() &&
+	    strcmp(conn->name, name) == 0 &&
+	    strcmp(conn->lxcpath, lxcpath) == 0 &&
+	    !lxc_cmd_conn_is_stale(conn))
+		return 1;
+
+	lxc_cmd_conn_close(conn);
+
+	conn->name = strdup(name);
+	conn->lxcpath = strdup(lxcpath);
+	if (!conn->name || !conn->lxcpath)
+		goto out_close;
+
+	conn->sock = lxc_cmd_connect(name, lxcpath, cmd, stopped);
+	if (conn->sock < 0)
+		goto out_close;
+
+	if (fcntl(conn->sock, F_SETFD, FD_CLOEXEC)) {
+		SYSERROR("failed to set close-on-exec on command connection");
+		goto out_close;
+	}
+	conn->pid = getpid();
+	return 0;
+
+out_close:
+	lxc_cmd_conn_close(conn);
+	return -1;
+}
+
+/*
+ * lxc_cmd_conn_pipeline: Send several command requests over a persistent
+ * connection before collecting their responses
+ *
+ * @conn           : the connection to use
+ * @name           : name of container to connect to
+ * @cmds           : commands with initialized requests to send
+ * @count          : number of commands in @cmds
+ * @stopped        : output indicator if the container was not running
+ * @lxcpath        : the lxcpath in which the container is running
+ *
+ * Returns @count on success, 0 if the container went away before
+ * answering all requests, < 0 on failure
+ *
+ * If the connection was closed by the other end (i.e. the container was
+ * restarted since the last use), the requests are sent once more over a
+ * new connection. Commands which hold on to their connection or wait for
+ * it to be closed (console and stop) can't be sent this way.
+ */
+int lxc_cmd_conn_pipeline(struct lxc_cmd_conn *conn, const char *name,
+			  struct lxc_cmd_rr *cmds, int count, int *stopped,
+			  const char *lxcpath)
+{
+	int i, received, attempt, reused, ret = -1;
+
+	*stopped = 0;
+
+	for (i = 0; i < count; i++) {
+		if (cmds[i].req.cmd == LXC_CMD_CONSOLE ||
+		    cmds[i].req.cmd == LXC_CMD_STOP) {
+			ERROR("command %s can't be sent over a shared connection",
+			      lxc_cmd_str(cmds[i].req.cmd));
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	if (!lxcpath)
+		lxcpath = lxc_global_config_value("lxc.lxcpath");
+	if (!lxcpath)
+		return -1;
+
+	if (pthread_mutex_lock(&conn->lock))
+		return -1;
+
+	for (attempt = 0; attempt < 2; attempt++) {
+		reused = lxc_cmd_conn_connect(conn, name, lxcpath,
+					      cmds[0].req.cmd, stopped);
+		if (reused < 0) {
+			ret = -1;
+			break;
+		}
+
+		for (i = 0; i < count; i++) {
+			ret = lxc_cmd_req_send(conn->sock, &cmds[i].req);
+			if (ret < 0)
+				break;
+		}
+
+		received = 0;
+		if (ret == 0) {
+			for (i = 0; i < count; i++) {
+				ret = lxc_cmd_rsp_recv(conn->sock, &cmds[i]);
+				if (ret <= 0)
+					break;
+				received++;
+			}
+		}
+
+		if (received == count) {
+			ret = count;
+			break;
+		}
+
+		/* drop what we got so far, the responses are out of sync now */
+		for (i = 0; i < received; i++) {
+			if (cmds[i].rsp.datalen > 0)
+				free(cmds[i].rsp.data);
+			cmds[i].rsp.data = NULL;
+			cmds[i].rsp.datalen = 0;
+		}
+		lxc_cmd_conn_close(conn);
+
+		/* only retry if an old connection turned out to be stale */
+		if (!reused)
+			break;
+		DEBUG("command connection to '%s' went away, reconnecting", name);
+	}
+
+	pthread_mutex_unlock(&conn->lock);
+	return ret;
+}
+
+/* send one command, over @conn if it is not NULL */
+static int lxc_cmd_via(struct lxc_cmd_conn *conn, const char *name,
+		       struct lxc_cmd_rr *cmd, int *stopped,
+		       const char *lxcpath)
+{
+	if (conn)
+		return lxc_cmd_conn_pipeline(conn, name, cmd, 1, stopped, lxcpath);
+	return lxc_cmd(name, cmd, stopped, lxcpath);
+}
+
 int lxc_try_cmd(const char *name, const char *lxcpath)
 {
 	int stopped, ret;
@@ -324,27 +560,34 @@ int lxc_try_cmd(const char *name, const char *lxcpath)
 /* Implentations of the commands and their callbacks */
 
 /*
- * lxc_cmd_get_init_pid: Get pid of the container's init process
+ * lxc_cmd_conn_get_init_pid: Get pid of the container's init process
  *
+ * @conn      : persistent connection to use, or NULL for a new one
  * @name      : name of container to connect to
  * @lxcpath   : the lxcpath in which the container is running
  *
  * Returns the pid on success, < 0 on failure
  */
-pid_t lxc_cmd_get_init_pid(const char *name, const char *lxcpath)
+pid_t lxc_cmd_conn_get_init_pid(struct lxc_cmd_conn *conn, const char *name,
+				const char *lxcpath)
 {
 	int ret, stopped;
 	struct lxc_cmd_rr cmd = {
 		.req = { .cmd = LXC_CMD_GET_INIT_PID },
 	};
 
-	ret = lxc_cmd(name, &cmd, &stopped, lxcpath);
+	ret = lxc_cmd_via(conn, name, &cmd, &stopped, lxcpath);
 	if (ret < 0)
 		return ret;
 
 	return PTR_TO_INT(cmd.rsp.data);
 }
 
+pid_t lxc_cmd_get_init_pid(const char *name, const char *lxcpath)
+{
+	return lxc_cmd_conn_get_init_pid(NULL, name, lxcpath);
+}
+
 static int lxc_cmd_get_init_pid_callback(int fd, struct lxc_cmd_req *req,
 					 struct lxc_handler *handler)
 {
@@ -446,8 +689,9 @@ static int lxc_cmd_get_cgroup_callback(int fd, struct lxc_cmd_req *req,
 }
 
 /*
- * lxc_cmd_get_config_item: Get config item the running container
+ * lxc_cmd_conn_get_config_item: Get config item the running container
  *
+ * @conn     : persistent connection to use, or NULL for a new one
  * @name     : name of container to connect to
  * @item     : the configuration item to retrieve (ex: lxc.network.0.veth.pair)
  * @lxcpath  : the lxcpath in which the container is running
@@ -455,8 +699,8 @@ static int lxc_cmd_get_cgroup_callback(int fd, struct lxc_cmd_req *req,
  * Returns the item on success, NULL on failure. The caller must free() the
  * returned item.
  */
-char *lxc_cmd_get_config_item(const char *name, const char *item,
-			      const char *lxcpath)
+char *lxc_cmd_conn_get_config_item(struct lxc_cmd_conn *conn, const char *name,
+				   const char *item, const char *lxcpath)
 {
 	int ret, stopped;
 	struct lxc_cmd_rr cmd = {
@@ -466,7 +710,7 @@ char *lxc_cmd_get_config_item(const char *name, const char *item,
 		       },
 	};
 
-	ret = lxc_cmd(name, &cmd, &stopped, lxcpath);
+	ret = lxc_cmd_via(conn, name, &cmd, &stopped, lxcpath);
 	if (ret < 0)
 		return NULL;
 
@@ -475,6 +719,12 @@ char *lxc_cmd_get_config_item(const char *name, const char *item,
 	return NULL;
 }
 
+char *lxc_cmd_get_config_item(const char *name, const char *item,
+			      const char *lxcpath)
+{
+	return lxc_cmd_conn_get_config_item(NULL, name, item, lxcpath);
+}
+
 static int lxc_cmd_get_config_item_callback(int fd, struct lxc_cmd_req *req,
 					    struct lxc_handler *handler)
 {
@@ -503,21 +753,181 @@ out:
 }
 
 /*
- * lxc_cmd_get_state: Get current state of the container
+ * lxc_cmd_get_trace: Get the timed phases of the last start of the
+ * container
  *
  * @name      : name of container to connect to
  * @lxcpath   : the lxcpath in which the container is running
+ * @spans     : set to the spans, to be free()ed by the caller
+ *
+ * Returns the number of spans on success, < 0 on failure
+ */
+int lxc_cmd_get_trace(const char *name, const char *lxcpath,
+		      struct lxc_trace_span **spans)
+{
+	int ret, stopped;
+	struct lxc_cmd_rr cmd = {
+		.req = { .cmd = LXC_CMD_GET_TRACE },
+	};
+
+	*spans = NULL;
+	ret = lxc_cmd(name, &cmd, &stopped, lxcpath);
+	if (ret < 0)
+		return ret;
+
+	if (cmd.rsp.ret < 0)
+		return cmd.rsp.ret;
+	if (cmd.rsp.datalen == 0)
+		return 0;
+
+	*spans = cmd.rsp.data;
+	return cmd.rsp.datalen / sizeof(**spans);
+}
+
+static int lxc_cmd_get_trace_callback(int fd, struct lxc_cmd_req *req,
+				      struct lxc_handler *handler)
+{
+	struct lxc_trace_span spans[LXC_TRACE_SPANS_MAX];
+	struct lxc_cmd_rsp rsp = { .ret = -ENOENT };
+	int count;
+
+	if (handler->trace) {
+		count = lxc_trace_copy(handler->trace, spans);
+		if (count > 0) {
+			rsp.data = spans;
+			rsp.datalen = count * sizeof(spans[0]);
+		}
+		rsp.ret = 0;
+	}
+
+	return lxc_cmd_rsp_send(fd, &rsp);
+}
+
+/*
+ * lxc_cmd_console_log: Get the last output of the container console, as
+ * kept in memory when lxc.console.buffer.size is set
+ *
+ * @name      : name of container to connect to
+ * @lxcpath   : the lxcpath in which the container is running
+ * @clear     : whether to empty the buffer once read
+ * @data      : set to the output, to be free()ed by the caller
+ *
+ * Returns the length of the output on success, < 0 on failure (-ENODATA
+ * if the container keeps no console buffer)
+ */
+int lxc_cmd_console_log(const char *name, const char *lxcpath, int clear,
+			char **data)
+{
+	int ret, stopped;
+	struct lxc_cmd_rr cmd = {
+		.req = { .cmd = LXC_CMD_CONSOLE_LOG, .data = INT_TO_PTR(clear) },
+	};
+
+	*data = NULL;
+	ret = lxc_cmd(name, &cmd, &stopped, lxcpath);
+	if (ret < 0)
+		return ret;
+
+	if (cmd.rsp.ret < 0)
+		return cmd.rsp.ret;
+
+	*data = cmd.rsp.datalen ? cmd.rsp.data : NULL;
+	return cmd.rsp.datalen;
+}
+
+static int lxc_cmd_console_log_callback(int fd, struct lxc_cmd_req *req,
+					struct lxc_handler *handler)
+{
+	struct lxc_cmd_rsp rsp = { 0 };
+	char *data;
+	int ret;
+
+	ret = lxc_console_ringbuf_get(&handler->conf->console, &data,
+				      PTR_TO_INT(req->data));
+	if (ret < 0) {
+		rsp.ret = ret;
+	} else {
+		rsp.data = data;
+		rsp.datalen = ret;
+	}
+
+	ret = lxc_cmd_rsp_send(fd, &rsp);
+	free(data);
+	return ret;
+}
+
+/*
+ * lxc_cmd_unpark: Have a container started parked exec a command as its
+ * init, completing its start.
+ *
+ * @name      : name of container to connect to
+ * @lxcpath   : the lxcpath in which the container is running
+ * @argv      : the command to exec, NULL terminated
+ *
+ * Returns 0 on success, < 0 on failure (-EBUSY if the container is not
+ * parked, for instance because someone else unparked it first)
+ */
+int lxc_cmd_unpark(const char *name, const char *lxcpath, char *const argv[])
+{
+	int ret, stopped, i, len = 0;
+	char *args, *p;
+	struct lxc_cmd_rr cmd = {
+		.req = { .cmd = LXC_CMD_UNPARK },
+	};
+
+	if (!argv || !argv[0])
+		return -EINVAL;
+
+	for (i = 0; argv[i]; i++)
+		len += strlen(argv[i]) + 1;
+	if (len > LXC_CMD_DATA_MAX) {
+		ERROR("command to unpark '%s' with is too long", name);
+		return -E2BIG;
+	}
+
+	args = alloca(len);
+	for (i = 0, p = args; argv[i]; i++)
+		p = stpcpy(p, argv[i]) + 1;
+
+	cmd.req.data = args;
+	cmd.req.datalen = len;
+
+	ret = lxc_cmd(name, &cmd, &stopped, lxcpath);
+	if (ret < 0)
+		return ret;
+
+	return cmd.rsp.ret;
+}
+
+static int lxc_cmd_unpark_callback(int fd, struct lxc_cmd_req *req,
+				   struct lxc_handler *handler)
+{
+	struct lxc_cmd_rsp rsp;
+
+	memset(&rsp, 0, sizeof(rsp));
+	rsp.ret = lxc_unpark(handler, req->data, req->datalen);
+
+	return lxc_cmd_rsp_send(fd, &rsp);
+}
+
+/*
+ * lxc_cmd_conn_get_state: Get current state of the container
+ *
+ * @conn      : persistent connection to use, or NULL for a new one
+ * @name      : name of container to connect to
+ * @lxcpath   : the lxcpath in which the container is running
  *
  * Returns the state on success, < 0 on failure
  */
-lxc_state_t lxc_cmd_get_state(const char *name, const char *lxcpath)
+lxc_state_t lxc_cmd_conn_get_state(struct lxc_cmd_conn *conn, const char *name,
+				   const char *lxcpath)
 {
 	int ret, stopped;
 	struct lxc_cmd_rr cmd = {
 		.req = { .cmd = LXC_CMD_GET_STATE }
 	};
 
-	ret = lxc_cmd(name, &cmd, &stopped, lxcpath);
+	ret = lxc_cmd_via(conn, name, &cmd, &stopped, lxcpath);
 	if (ret < 0 && stopped)
 		return STOPPED;
 
@@ -534,6 +944,11 @@ lxc_state_t lxc_cmd_get_state(const char *name, const char *lxcpath)
 	return PTR_TO_INT(cmd.rsp.data);
 }
 
+lxc_state_t lxc_cmd_get_state(const char *name, const char *lxcpath)
+{
+	return lxc_cmd_conn_get_state(NULL, name, lxcpath);
+}
+
 static int lxc_cmd_get_state_callback(int fd, struct lxc_cmd_req *req,
 				      struct lxc_handler *handler)
 {
@@ -729,6 +1144,9 @@ static int lxc_cmd_process(int fd, struct lxc_cmd_req *req,
 		[LXC_CMD_GET_CLONE_FLAGS] = lxc_cmd_get_clone_flags_callback,
 		[LXC_CMD_GET_CGROUP]      = lxc_cmd_get_cgroup_callback,
 		[LXC_CMD_GET_CONFIG_ITEM] = lxc_cmd_get_config_item_callback,
+		[LXC_CMD_GET_TRACE]       = lxc_cmd_get_trace_callback,
+		[LXC_CMD_UNPARK]          = lxc_cmd_unpark_callback,
+		[LXC_CMD_CONSOLE_LOG]     = lxc_cmd_console_log_callback,
 	};
 
 	if (req->cmd >= LXC_CMD_MAX) {
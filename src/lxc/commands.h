@@ -41,6 +41,9 @@ typedef enum {
 	LXC_CMD_GET_CLONE_FLAGS,
 	LXC_CMD_GET_CGROUP,
 	LXC_CMD_GET_CONFIG_ITEM,
+	LXC_CMD_GET_TRACE,
+	LXC_CMD_UNPARK,
+	LXC_CMD_CONSOLE_LOG,
 	LXC_CMD_MAX,
 } lxc_cmd_t;
 
@@ -69,6 +72,8 @@ struct lxc_cmd_console_rsp_data {
 extern int lxc_cmd_console_winch(const char *name, const char *lxcpath);
 extern int lxc_cmd_console(const char *name, int *ttynum, int *fd,
 			   const char *lxcpath);
+extern int lxc_cmd_console_log(const char *name, const char *lxcpath,
+			       int clear, char **data);
 /*
  * Get the 'real' cgroup path (as seen in /proc/self/cgroup) for a container
  * for a particular subsystem
@@ -80,6 +85,32 @@ extern char *lxc_cmd_get_config_item(const char *name, const char *item, const c
 extern pid_t lxc_cmd_get_init_pid(const char *name, const char *lxcpath);
 extern lxc_state_t lxc_cmd_get_state(const char *name, const char *lxcpath);
 extern int lxc_cmd_stop(const char *name, const char *lxcpath);
+extern int lxc_cmd_unpark(const char *name, const char *lxcpath,
+			  char *const argv[]);
+
+struct lxc_trace_span;
+extern int lxc_cmd_get_trace(const char *name, const char *lxcpath,
+			     struct lxc_trace_span **spans);
+
+/*
+ * A connection to a container's command socket which stays open across
+ * commands, for callers which query a container repeatedly. It is safe
+ * to share between threads.
+ */
+struct lxc_cmd_conn;
+
+extern struct lxc_cmd_conn *lxc_cmd_conn_new(void);
+extern void lxc_cmd_conn_free(struct lxc_cmd_conn *conn);
+extern int lxc_cmd_conn_pipeline(struct lxc_cmd_conn *conn, const char *name,
+				 struct lxc_cmd_rr *cmds, int count,
+				 int *stopped, const char *lxcpath);
+extern char *lxc_cmd_conn_get_config_item(struct lxc_cmd_conn *conn,
+					  const char *name, const char *item,
+					  const char *lxcpath);
+extern pid_t lxc_cmd_conn_get_init_pid(struct lxc_cmd_conn *conn,
+				       const char *name, const char *lxcpath);
+extern lxc_state_t lxc_cmd_conn_get_state(struct lxc_cmd_conn *conn,
+					  const char *name, const char *lxcpath);
 
 struct lxc_epoll_descr;
 struct lxc_handler;
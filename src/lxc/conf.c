@@ -55,9 +55,11 @@
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <net/if.h>
+#include <linux/netlink.h>
 #include <libgen.h>
 
 #include "network.h"
+#include "nl.h"
 #include "error.h"
 #include "parse.h"
 #include "utils.h"
@@ -68,6 +70,7 @@
 #include "cgroup.h"
 #include "lxclock.h"
 #include "namespace.h"
+#include "trace.h"
 #include "lsm/lsm.h"
 
 #if HAVE_SYS_CAPABILITY_H
@@ -170,6 +173,7 @@ static int instanciate_vlan(struct lxc_handler *, struct lxc_netdev *);
 static int instanciate_phys(struct lxc_handler *, struct lxc_netdev *);
 static int instanciate_empty(struct lxc_handler *, struct lxc_netdev *);
 static int instanciate_none(struct lxc_handler *, struct lxc_netdev *);
+static int instanciate_ipvlan(struct lxc_handler *, struct lxc_netdev *);
 
 static  instanciate_cb netdev_conf[LXC_NET_MAXCONFTYPE + 1] = {
 	[LXC_NET_VETH]    = instanciate_veth,
@@ -178,6 +182,7 @@ static  instanciate_cb netdev_conf[LXC_NET_MAXCONFTYPE + 1] = {
 	[LXC_NET_PHYS]    = instanciate_phys,
 	[LXC_NET_EMPTY]   = instanciate_empty,
 	[LXC_NET_NONE]    = instanciate_none,
+	[LXC_NET_IPVLAN]  = instanciate_ipvlan,
 };
 
 static int shutdown_veth(struct lxc_handler *, struct lxc_netdev *);
@@ -186,6 +191,7 @@ static int shutdown_vlan(struct lxc_handler *, struct lxc_netdev *);
 static int shutdown_phys(struct lxc_handler *, struct lxc_netdev *);
 static int shutdown_empty(struct lxc_handler *, struct lxc_netdev *);
 static int shutdown_none(struct lxc_handler *, struct lxc_netdev *);
+static int shutdown_ipvlan(struct lxc_handler *, struct lxc_netdev *);
 
 static  instanciate_cb netdev_deconf[LXC_NET_MAXCONFTYPE + 1] = {
 	[LXC_NET_VETH]    = shutdown_veth,
@@ -194,6 +200,7 @@ static  instanciate_cb netdev_deconf[LXC_NET_MAXCONFTYPE + 1] = {
 	[LXC_NET_PHYS]    = shutdown_phys,
 	[LXC_NET_EMPTY]   = shutdown_empty,
 	[LXC_NET_NONE]    = shutdown_none,
+	[LXC_NET_IPVLAN]  = shutdown_ipvlan,
 };
 
 static struct mount_opt mount_opt[] = {
@@ -377,6 +384,13 @@ static int run_script(const char *name, const char *section,
 	INFO("Executing script '%s' for container '%s', config section '%s'",
 	     script, name, section);
 
+	/* the script has to see the network changes queued so far */
+	ret = netlink_session_flush(NULL);
+	if (ret) {
+		ERROR("failed to configure the network : %s", strerror(-ret));
+		return -1;
+	}
+
 	va_start(ap, script);
 	while ((p = va_arg(ap, char *)))
 		size += strlen(p) + 1;
@@ -2546,6 +2560,17 @@ static int setup_network(struct lxc_list *network)
 {
 	struct lxc_list *iterator;
 	struct lxc_netdev *netdev;
+	struct nl_session session;
+	int err;
+
+	if (lxc_list_empty(network))
+		return 0;
+
+	err = netlink_session_begin(&session, NETLINK_ROUTE);
+	if (err) {
+		ERROR("failed to open a netlink session : %s", strerror(-err));
+		return -1;
+	}
 
 	lxc_list_for_each(iterator, network) {
 
@@ -2553,10 +2578,17 @@ static int setup_network(struct lxc_list *network)
 
 		if (setup_netdev(netdev)) {
 			ERROR("failed to setup netdev");
+			netlink_session_end(&session);
 			return -1;
 		}
 	}
 
+	err = netlink_session_end(&session);
+	if (err) {
+		ERROR("failed to setup the network : %s", strerror(-err));
+		return -1;
+	}
+
 	if (!lxc_list_empty(network))
 		INFO("network has been setup");
 
@@ -2665,10 +2697,46 @@ struct lxc_conf *lxc_conf_init(void)
 
 	for (i = 0; i < LXC_NS_MAX; i++)
 		new->inherit_ns_fd[i] = -1;
+	new->warm_netns_fd = -1;
 
 	return new;
 }
 
+/*
+ * Spread the packet processing of both ends of a veth pair over the cpus
+ * of the container.  The queue settings follow the container end into
+ * the container.
+ */
+static int steer_veth(struct lxc_conf *conf, const char *veth1, const char *veth2)
+{
+	struct lxc_list *iterator;
+	struct lxc_cgroup *cg;
+	const char *cpus = NULL;
+	int err;
+
+	lxc_list_for_each(iterator, &conf->cgroup) {
+		cg = iterator->elem;
+		if (!strcmp(cg->subsystem, "cpuset.cpus"))
+			cpus = cg->value;
+	}
+	if (!cpus) {
+		WARN("no lxc.cgroup.cpuset.cpus to steer %s-%s to", veth1, veth2);
+		return 0;
+	}
+
+	err = lxc_netdev_steer_queues(veth1, cpus);
+	if (!err)
+		err = lxc_netdev_steer_queues(veth2, cpus);
+	if (err) {
+		ERROR("failed to steer the queues of %s-%s to cpus '%s' : %s",
+		      veth1, veth2, cpus, strerror(-err));
+		return -1;
+	}
+
+	DEBUG("steered the queues of %s-%s to cpus '%s'", veth1, veth2, cpus);
+	return 0;
+}
+
 static int instanciate_veth(struct lxc_handler *handler, struct lxc_netdev *netdev)
 {
 	char veth1buf[IFNAMSIZ], *veth1;
@@ -2699,13 +2767,18 @@ static int instanciate_veth(struct lxc_handler *handler, struct lxc_netdev *netd
 		goto out_delete;
 	}
 
-	err = lxc_veth_create(veth1, veth2);
+	err = lxc_veth_create_mq(veth1, veth2, netdev->priv.veth_attr.txqueues,
+				 netdev->priv.veth_attr.rxqueues);
 	if (err) {
 		ERROR("failed to create %s-%s : %s", veth1, veth2,
 		      strerror(-err));
 		goto out_delete;
 	}
 
+	if (netdev->priv.veth_attr.steering == LXC_STEER_CPUSET &&
+	    steer_veth(handler->conf, veth1, veth2))
+		goto out_delete;
+
 	/* changing the high byte of the mac address to 0xfe, the bridge interface
 	 * will always keep the host's mac address and not take the mac address
 	 * of a container */
@@ -2853,6 +2926,72 @@ static int shutdown_macvlan(struct lxc_handler *handler, struct lxc_netdev *netd
 	return 0;
 }
 
+static int instanciate_ipvlan(struct lxc_handler *handler, struct lxc_netdev *netdev)
+{
+	char peerbuf[IFNAMSIZ], *peer;
+	int err;
+
+	if (!netdev->link) {
+		ERROR("no link specified for ipvlan netdev");
+		return -1;
+	}
+
+	err = snprintf(peerbuf, sizeof(peerbuf), "ipXXXXXX");
+	if (err >= sizeof(peerbuf))
+		return -1;
+
+	peer = lxc_mkifname(peerbuf);
+	if (!peer) {
+		ERROR("failed to make a temporary name");
+		return -1;
+	}
+
+	err = lxc_ipvlan_create(netdev->link, peer,
+				netdev->priv.ipvlan_attr.mode);
+	if (err) {
+		ERROR("failed to create ipvlan interface '%s' on '%s' : %s",
+		      peer, netdev->link, strerror(-err));
+		goto out;
+	}
+
+	netdev->ifindex = if_nametoindex(peer);
+	if (!netdev->ifindex) {
+		ERROR("failed to retrieve the index for %s", peer);
+		goto out;
+	}
+
+	if (netdev->upscript) {
+		err = run_script(handler->name, "net", netdev->upscript, "up",
+				 "ipvlan", netdev->link, (char*) NULL);
+		if (err)
+			goto out;
+	}
+
+	DEBUG("instanciated ipvlan '%s', index is '%d' and mode '%d'",
+	      peer, netdev->ifindex, netdev->priv.ipvlan_attr.mode);
+
+	free(peer);
+	return 0;
+out:
+	lxc_netdev_delete_by_name(peer);
+	free(peer);
+	return -1;
+}
+
+static int shutdown_ipvlan(struct lxc_handler *handler, struct lxc_netdev *netdev)
+{
+	int err;
+
+	if (netdev->downscript) {
+		err = run_script(handler->name, "net", netdev->downscript,
+				 "down", "ipvlan", netdev->link,
+				 (char*) NULL);
+		if (err)
+			return -1;
+	}
+	return 0;
+}
+
 /* XXX: merge with instanciate_macvlan */
 static int instanciate_vlan(struct lxc_handler *handler, struct lxc_netdev *netdev)
 {
@@ -2998,11 +3137,20 @@ int lxc_create_network(struct lxc_handler *handler)
 	struct lxc_list *network = &handler->conf->network;
 	struct lxc_list *iterator;
 	struct lxc_netdev *netdev;
+	struct nl_session session;
 	int am_root = (getuid() == 0);
+	int err;
 
 	if (!am_root)
 		return 0;
 
+	/* one netlink socket for all the devices */
+	err = netlink_session_begin(&session, NETLINK_ROUTE);
+	if (err) {
+		ERROR("failed to open a netlink session : %s", strerror(-err));
+		return -1;
+	}
+
 	lxc_list_for_each(iterator, network) {
 
 		netdev = iterator->elem;
@@ -3010,16 +3158,24 @@ int lxc_create_network(struct lxc_handler *handler)
 		if (netdev->type < 0 || netdev->type > LXC_NET_MAXCONFTYPE) {
 			ERROR("invalid network configuration type '%d'",
 			      netdev->type);
+			netlink_session_end(&session);
 			return -1;
 		}
 
 		if (netdev_conf[netdev->type](handler, netdev)) {
 			ERROR("failed to create netdev");
+			netlink_session_end(&session);
 			return -1;
 		}
 
 	}
 
+	err = netlink_session_end(&session);
+	if (err) {
+		ERROR("failed to create the network : %s", strerror(-err));
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -3146,16 +3302,25 @@ int lxc_assign_network(struct lxc_list *network, pid_t pid)
 {
 	struct lxc_list *iterator;
 	struct lxc_netdev *netdev;
+	struct nl_session session;
 	int am_root = (getuid() == 0);
 	int err;
 
+	err = netlink_session_begin(&session, NETLINK_ROUTE);
+	if (err) {
+		ERROR("failed to open a netlink session : %s", strerror(-err));
+		return -1;
+	}
+
 	lxc_list_for_each(iterator, network) {
 
 		netdev = iterator->elem;
 
 		if (netdev->type == LXC_NET_VETH && !am_root) {
-			if (unpriv_assign_nic(netdev, pid))
+			if (unpriv_assign_nic(netdev, pid)) {
+				netlink_session_end(&session);
 				return -1;
+			}
 			// lxc-user-nic has moved the nic to the new ns.
 			// unpriv_assign_nic() fills in netdev->name.
 			// netdev->ifindex will be filed in at setup_netdev.
@@ -3170,12 +3335,20 @@ int lxc_assign_network(struct lxc_list *network, pid_t pid)
 		if (err) {
 			ERROR("failed to move '%s' to the container : %s",
 			      netdev->link, strerror(-err));
+			netlink_session_end(&session);
 			return -1;
 		}
 
 		DEBUG("move '%s' to '%d'", netdev->name, pid);
 	}
 
+	err = netlink_session_end(&session);
+	if (err) {
+		ERROR("failed to move the network devices to the container : %s",
+		      strerror(-err));
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -3339,9 +3512,10 @@ int lxc_find_gateway_addresses(struct lxc_handler *handler)
 		if (!netdev->ipv4_gateway_auto && !netdev->ipv6_gateway_auto)
 			continue;
 
-		if (netdev->type != LXC_NET_VETH && netdev->type != LXC_NET_MACVLAN) {
+		if (netdev->type != LXC_NET_VETH && netdev->type != LXC_NET_MACVLAN &&
+		    netdev->type != LXC_NET_IPVLAN) {
 			ERROR("gateway = auto only supported for "
-			      "veth and macvlan");
+			      "veth, macvlan and ipvlan");
 			return -1;
 		}
 
@@ -3711,7 +3885,9 @@ int lxc_setup(struct lxc_handler *handler)
 	struct lxc_conf *lxc_conf = handler->conf;
 	const char *lxcpath = handler->lxcpath;
 	void *data = handler->data;
+	int span;
 
+	/* a failing phase leaves its span open */
 	if (lxc_conf->inherit_ns_fd[LXC_NS_UTS] == -1) {
 		if (setup_utsname(lxc_conf->utsname)) {
 			ERROR("failed to setup the utsname for '%s'", name);
@@ -3719,20 +3895,27 @@ int lxc_setup(struct lxc_handler *handler)
 		}
 	}
 
-	if (setup_network(&lxc_conf->network)) {
+	/* after a warm reboot the interfaces are still configured */
+	span = lxc_trace_begin(handler->trace, "setup_network");
+	if (lxc_conf->warm_netns_fd == -1 && setup_network(&lxc_conf->network)) {
 		ERROR("failed to setup the network for '%s'", name);
 		return -1;
 	}
+	lxc_trace_end(handler->trace, span);
 
+	span = lxc_trace_begin(handler->trace, "hook:pre-mount");
 	if (run_lxc_hooks(name, "pre-mount", lxc_conf, lxcpath, NULL)) {
 		ERROR("failed to run pre-mount hooks for container '%s'.", name);
 		return -1;
 	}
+	lxc_trace_end(handler->trace, span);
 
+	span = lxc_trace_begin(handler->trace, "setup_rootfs");
 	if (setup_rootfs(lxc_conf)) {
 		ERROR("failed to setup rootfs for '%s'", name);
 		return -1;
 	}
+	lxc_trace_end(handler->trace, span);
 
 	if (lxc_conf->autodev < 0) {
 		lxc_conf->autodev = check_autodev(lxc_conf->rootfs.mount, data);
@@ -3753,6 +3936,7 @@ int lxc_setup(struct lxc_handler *handler)
 		return -1;
 	}
 
+	span = lxc_trace_begin(handler->trace, "setup_mount_entries");
 	if (setup_mount(&lxc_conf->rootfs, lxc_conf->fstab, name)) {
 		ERROR("failed to setup the mounts for '%s'", name);
 		return -1;
@@ -3762,6 +3946,7 @@ int lxc_setup(struct lxc_handler *handler)
 		ERROR("failed to setup the mount entries for '%s'", name);
 		return -1;
 	}
+	lxc_trace_end(handler->trace, span);
 
 	/* now mount only cgroup, if wanted;
 	 * before, /sys could not have been mounted
@@ -3772,16 +3957,20 @@ int lxc_setup(struct lxc_handler *handler)
 		return -1;
 	}
 
+	span = lxc_trace_begin(handler->trace, "hook:mount");
 	if (run_lxc_hooks(name, "mount", lxc_conf, lxcpath, NULL)) {
 		ERROR("failed to run mount hooks for container '%s'.", name);
 		return -1;
 	}
+	lxc_trace_end(handler->trace, span);
 
 	if (lxc_conf->autodev > 0) {
+		span = lxc_trace_begin(handler->trace, "hook:autodev");
 		if (run_lxc_hooks(name, "autodev", lxc_conf, lxcpath, NULL)) {
 			ERROR("failed to run autodev hooks for container '%s'.", name);
 			return -1;
 		}
+		lxc_trace_end(handler->trace, span);
 		if (setup_autodev(lxc_conf->rootfs.mount)) {
 			ERROR("failed to populate /dev in the container");
 			return -1;
@@ -4157,6 +4346,7 @@ void lxc_conf_free(struct lxc_conf *conf)
 		free(conf->rootfs.pivot);
 	if (conf->logfile)
 		free(conf->logfile);
+	free(conf->tracefile);
 	if (conf->utsname)
 		free(conf->utsname);
 	if (conf->ttydir)
@@ -45,6 +45,7 @@ enum {
 	LXC_NET_PHYS,
 	LXC_NET_VLAN,
 	LXC_NET_NONE,
+	LXC_NET_IPVLAN,
 	LXC_NET_MAXCONFTYPE,
 };
 
@@ -85,6 +86,14 @@ struct lxc_route6 {
 struct ifla_veth {
 	char *pair; /* pair name */
 	char veth1[IFNAMSIZ]; /* needed for deconf */
+	int txqueues; /* number of queues, 0 for the kernel default */
+	int rxqueues;
+	int steering; /* spread the queues over the cpuset, see LXC_STEER_* */
+};
+
+enum {
+	LXC_STEER_NONE,
+	LXC_STEER_CPUSET,
 };
 
 struct ifla_vlan {
@@ -98,10 +107,15 @@ struct ifla_macvlan {
 	int mode; /* private, vepa, bridge */
 };
 
+struct ifla_ipvlan {
+	int mode; /* l2, l3, l3s */
+};
+
 union netdev_p {
 	struct ifla_veth veth_attr;
 	struct ifla_vlan vlan_attr;
 	struct ifla_macvlan macvlan_attr;
+	struct ifla_ipvlan ipvlan_attr;
 };
 
 /*
@@ -190,10 +204,27 @@ struct lxc_tty_info {
 
 struct lxc_tty_state;
 
+/*
+ * Last output of the console, kept in memory by lxc-start
+ * @buf    : the buffer, NULL unless lxc.console.buffer.size is set
+ * @size   : the size of buf
+ * @pos    : offset in buf of the next byte written
+ * @full   : set once buf wrapped around, all of it is then valid
+ */
+struct lxc_console_ringbuf {
+	char *buf;
+	size_t size;
+	size_t pos;
+	int full;
+};
+
+#define LXC_CONSOLE_BUFFER_MAX (16 * 1024 * 1024)
+
 /*
  * Defines the structure to store the console information
  * @peer   : the file descriptor put/get console traffic
  * @name   : the file name of the slave pty
+ * @ringbuf: the in-memory log of the console output
  */
 struct lxc_console {
 	int slave;
@@ -207,6 +238,7 @@ struct lxc_console {
 	char name[MAXPATHLEN];
 	struct termios *tios;
 	struct lxc_tty_state *tty_state;
+	struct lxc_console_ringbuf ringbuf;
 };
 
 /*
@@ -274,13 +306,17 @@ struct saved_nic {
 	char *orig_name;
 };
 
+struct lxc_config_record;
+
 struct lxc_conf {
 	int is_execute;
 	char *fstab;
 	int tty;
 	int pts;
 	int reboot;
+	int warm_reboot; // keep the netns, cgroups and ttys across a reboot
 	int need_utmp_watch;
+	int park;	// stop just before exec'ing init, until unparked
 	int personality;
 	struct utsname *utsname;
 	struct lxc_list cgroup;
@@ -312,6 +348,7 @@ struct lxc_conf {
 	int stopsignal; // signal used to hard stop container
 	int kmsg;  // if 1, create /dev/kmsg symlink
 	char *rcfile;	// Copy of the top level rcfile we read
+	struct lxc_config_record *config_record; // set while filling config.cache
 
 	// Logfile and logleve can be set in a container config file.
 	// Those function as defaults.  The defaults can be overriden
@@ -320,9 +357,17 @@ struct lxc_conf {
 	// store the config file specified values here.
 	char *logfile;  // the logfile as specifed in config
 	int loglevel;   // loglevel as specifed in config (if any)
+	size_t logbuffer;  // bytes of events kept before writing the logfile
+	size_t logmaxsize; // size at which the logfile is rotated
+
+	char *tracefile; // where to append the start trace, if anywhere
 
 	int inherit_ns_fd[LXC_NS_MAX];
 
+	// What a warm reboot hands over to the next boot, see lxc_fini()
+	int warm_netns_fd;
+	void *warm_cgroup_data;
+
 	int start_auto;
 	int start_delay;
 	int start_order;
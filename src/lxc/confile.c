@@ -29,6 +29,9 @@
 #include <fcntl.h>
 #include <ctype.h>
 #include <signal.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/param.h>
@@ -45,6 +48,7 @@
 #include "conf.h"
 #include "network.h"
 #include "lxcseccomp.h"
+#include "version.h"
 
 #if HAVE_SYS_PERSONALITY_H
 #include <sys/personality.h>
@@ -52,6 +56,18 @@
 
 lxc_log_define(lxc_confile, lxc);
 
+#ifndef IPVLAN_MODE_L2
+#  define IPVLAN_MODE_L2 0
+#endif
+
+#ifndef IPVLAN_MODE_L3
+#  define IPVLAN_MODE_L3 1
+#endif
+
+#ifndef IPVLAN_MODE_L3S
+#  define IPVLAN_MODE_L3S 2
+#endif
+
 static int config_personality(const char *, const char *, struct lxc_conf *);
 static int config_pts(const char *, const char *, struct lxc_conf *);
 static int config_tty(const char *, const char *, struct lxc_conf *);
@@ -63,6 +79,8 @@ static int config_cgroup(const char *, const char *, struct lxc_conf *);
 static int config_idmap(const char *, const char *, struct lxc_conf *);
 static int config_loglevel(const char *, const char *, struct lxc_conf *);
 static int config_logfile(const char *, const char *, struct lxc_conf *);
+static int config_logfile_size(const char *, const char *, struct lxc_conf *);
+static int config_tracefile(const char *, const char *, struct lxc_conf *);
 static int config_mount(const char *, const char *, struct lxc_conf *);
 static int config_rootfs(const char *, const char *, struct lxc_conf *);
 static int config_rootfs_mount(const char *, const char *, struct lxc_conf *);
@@ -75,7 +93,10 @@ static int config_network_flags(const char *, const char *, struct lxc_conf *);
 static int config_network_link(const char *, const char *, struct lxc_conf *);
 static int config_network_name(const char *, const char *, struct lxc_conf *);
 static int config_network_veth_pair(const char *, const char *, struct lxc_conf *);
+static int config_network_veth_queues(const char *, const char *, struct lxc_conf *);
+static int config_network_veth_steering(const char *, const char *, struct lxc_conf *);
 static int config_network_macvlan_mode(const char *, const char *, struct lxc_conf *);
+static int config_network_ipvlan_mode(const char *, const char *, struct lxc_conf *);
 static int config_network_hwaddr(const char *, const char *, struct lxc_conf *);
 static int config_network_vlan_id(const char *, const char *, struct lxc_conf *);
 static int config_network_mtu(const char *, const char *, struct lxc_conf *);
@@ -88,6 +109,7 @@ static int config_network_ipv6_gateway(const char *, const char *, struct lxc_co
 static int config_cap_drop(const char *, const char *, struct lxc_conf *);
 static int config_cap_keep(const char *, const char *, struct lxc_conf *);
 static int config_console(const char *, const char *, struct lxc_conf *);
+static int config_console_buffer_size(const char *, const char *, struct lxc_conf *);
 static int config_seccomp(const char *, const char *, struct lxc_conf *);
 static int config_includefile(const char *, const char *, struct lxc_conf *);
 static int config_network_nic(const char *, const char *, struct lxc_conf *);
@@ -95,6 +117,7 @@ static int config_autodev(const char *, const char *, struct lxc_conf *);
 static int config_haltsignal(const char *, const char *, struct lxc_conf *);
 static int config_stopsignal(const char *, const char *, struct lxc_conf *);
 static int config_start(const char *, const char *, struct lxc_conf *);
+static int config_reboot(const char *, const char *, struct lxc_conf *);
 static int config_group(const char *, const char *, struct lxc_conf *);
 
 static struct lxc_config_t config[] = {
@@ -109,7 +132,10 @@ static struct lxc_config_t config[] = {
 	{ "lxc.cgroup",               config_cgroup               },
 	{ "lxc.id_map",               config_idmap                },
 	{ "lxc.loglevel",             config_loglevel             },
+	{ "lxc.logfile.buffer",       config_logfile_size         },
+	{ "lxc.logfile.maxsize",      config_logfile_size         },
 	{ "lxc.logfile",              config_logfile              },
+	{ "lxc.tracefile",            config_tracefile            },
 	{ "lxc.mount",                config_mount                },
 	{ "lxc.rootfs.mount",         config_rootfs_mount         },
 	{ "lxc.rootfs.options",       config_rootfs_options       },
@@ -128,7 +154,11 @@ static struct lxc_config_t config[] = {
 	{ "lxc.network.link",         config_network_link         },
 	{ "lxc.network.name",         config_network_name         },
 	{ "lxc.network.macvlan.mode", config_network_macvlan_mode },
+	{ "lxc.network.ipvlan.mode",  config_network_ipvlan_mode  },
 	{ "lxc.network.veth.pair",    config_network_veth_pair    },
+	{ "lxc.network.veth.txqueues", config_network_veth_queues },
+	{ "lxc.network.veth.rxqueues", config_network_veth_queues },
+	{ "lxc.network.veth.steering", config_network_veth_steering },
 	{ "lxc.network.script.up",    config_network_script_up    },
 	{ "lxc.network.script.down",  config_network_script_down  },
 	{ "lxc.network.hwaddr",       config_network_hwaddr       },
@@ -142,6 +172,7 @@ static struct lxc_config_t config[] = {
 	{ "lxc.network.",             config_network_nic          },
 	{ "lxc.cap.drop",             config_cap_drop             },
 	{ "lxc.cap.keep",             config_cap_keep             },
+	{ "lxc.console.buffer.size",  config_console_buffer_size  },
 	{ "lxc.console",              config_console              },
 	{ "lxc.seccomp",              config_seccomp              },
 	{ "lxc.include",              config_includefile          },
@@ -151,6 +182,7 @@ static struct lxc_config_t config[] = {
 	{ "lxc.start.auto",           config_start                },
 	{ "lxc.start.delay",          config_start                },
 	{ "lxc.start.order",          config_start                },
+	{ "lxc.reboot.warm",          config_reboot               },
 	{ "lxc.group",                config_group                },
 };
 
@@ -183,14 +215,74 @@ static const struct signame signames[] = {
 
 static const size_t config_size = sizeof(config)/sizeof(struct lxc_config_t);
 
+/*
+ * A key is handled by the longest entry of config[] which is a prefix of
+ * it, "lxc.cgroup" handling "lxc.cgroup.cpuset.cpus" for instance.  The
+ * index holds config[] sorted by name, each entry pointing to the longest
+ * other entry which is a prefix of it.  The entry handling a key is on
+ * that chain starting from the last entry sorting before or equal to the
+ * key, so lookups take a binary search instead of a scan of config[].
+ */
+struct lxc_config_index {
+	struct lxc_config_t *config;
+	size_t len;
+	int parent;
+};
+
+static struct lxc_config_index config_index[sizeof(config)/sizeof(struct lxc_config_t)];
+static pthread_once_t config_index_once = PTHREAD_ONCE_INIT;
+
+static int config_index_cmp(const void *a, const void *b)
+{
+	const struct lxc_config_index *first = a, *second = b;
+
+	return strcmp(first->config->name, second->config->name);
+}
+
+static void config_index_init(void)
+{
+	int i, j;
+
+	for (i = 0; i < config_size; i++) {
+		config_index[i].config = &config[i];
+		config_index[i].len = strlen(config[i].name);
+	}
+
+	qsort(config_index, config_size, sizeof(struct lxc_config_index),
+	      config_index_cmp);
+
+	/* the prefixes of an entry sort before it, longest last */
+	for (i = 0; i < config_size; i++) {
+		config_index[i].parent = -1;
+		for (j = i - 1; j >= 0; j--) {
+			if (!strncmp(config_index[j].config->name,
+				     config_index[i].config->name,
+				     config_index[j].len)) {
+				config_index[i].parent = j;
+				break;
+			}
+		}
+	}
+}
+
 extern struct lxc_config_t *lxc_getconfig(const char *key)
 {
-	int i;
+	int lo = 0, hi = config_size, mid, i;
 
-	for (i = 0; i < config_size; i++)
-		if (!strncmp(config[i].name, key,
-			     strlen(config[i].name)))
-			return &config[i];
+	pthread_once(&config_index_once, config_index_init);
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strcmp(config_index[mid].config->name, key) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (i = lo - 1; i >= 0; i = config_index[i].parent)
+		if (!strncmp(config_index[i].config->name, key,
+			     config_index[i].len))
+			return config_index[i].config;
 	return NULL;
 }
 
@@ -347,7 +439,11 @@ static int config_network_type(const char *key, const char *value,
 		netdev->type = LXC_NET_EMPTY;
 	else if (!strcmp(value, "none"))
 		netdev->type = LXC_NET_NONE;
-	else {
+	else if (!strcmp(value, "ipvlan")) {
+		netdev->type = LXC_NET_IPVLAN;
+		/* the kernel default */
+		netdev->priv.ipvlan_attr.mode = IPVLAN_MODE_L3;
+	} else {
 		ERROR("invalid network type %s", value);
 		return -1;
 	}
@@ -434,10 +530,16 @@ extern int lxc_list_nicconfigs(struct lxc_conf *c, const char *key,
 	switch(netdev->type) {
 	case LXC_NET_VETH:
 		strprint(retv, inlen, "veth.pair\n");
+		strprint(retv, inlen, "veth.txqueues\n");
+		strprint(retv, inlen, "veth.rxqueues\n");
+		strprint(retv, inlen, "veth.steering\n");
 		break;
 	case LXC_NET_MACVLAN:
 		strprint(retv, inlen, "macvlan.mode\n");
 		break;
+	case LXC_NET_IPVLAN:
+		strprint(retv, inlen, "ipvlan.mode\n");
+		break;
 	case LXC_NET_VLAN:
 		strprint(retv, inlen, "vlan.id\n");
 		break;
@@ -513,11 +615,49 @@ static int macvlan_mode(int *valuep, const char *value)
 	return -1;
 }
 
+static int ipvlan_mode(int *valuep, const char *value)
+{
+	struct mc_mode {
+		char *name;
+		int mode;
+	} m[] = {
+		{ "l2", IPVLAN_MODE_L2 },
+		{ "l3", IPVLAN_MODE_L3 },
+		{ "l3s", IPVLAN_MODE_L3S },
+	};
+
+	int i;
+
+	for (i = 0; i < sizeof(m)/sizeof(m[0]); i++) {
+		if (strcmp(m[i].name, value))
+			continue;
+
+		*valuep = m[i].mode;
+		return 0;
+	}
+
+	return -1;
+}
+
+static const char *ipvlan_mode_str(int mode)
+{
+	switch (mode) {
+	case IPVLAN_MODE_L2: return "l2";
+	case IPVLAN_MODE_L3: return "l3";
+	case IPVLAN_MODE_L3S: return "l3s";
+	default: return "(invalid)";
+	}
+}
+
 static int rand_complete_hwaddr(char *hwaddr)
 {
 	const char hex[] = "0123456789abcdef";
 	char *curs = hwaddr;
 
+	/* don't read /dev/urandom for the seed of a complete address */
+	if (!strpbrk(hwaddr, "xX"))
+		return 0;
+
 #ifndef HAVE_RAND_R
 	randseed(true);
 #else
@@ -594,6 +734,51 @@ static int config_network_veth_pair(const char *key, const char *value,
 	return network_ifname(&netdev->priv.veth_attr.pair, value);
 }
 
+static int config_network_veth_queues(const char *key, const char *value,
+				      struct lxc_conf *lxc_conf)
+{
+	struct lxc_netdev *netdev;
+	char *endp = NULL;
+	long n;
+
+	netdev = network_netdev(key, value, &lxc_conf->network);
+	if (!netdev)
+		return -1;
+
+	errno = 0;
+	n = strtol(value, &endp, 10);
+	if (value == endp || *endp || n < 1 || n > 4096 || errno) {
+		ERROR("invalid number of queues '%s'", value);
+		return -1;
+	}
+
+	if (strstr(key, "txqueues"))
+		netdev->priv.veth_attr.txqueues = n;
+	else
+		netdev->priv.veth_attr.rxqueues = n;
+	return 0;
+}
+
+static int config_network_veth_steering(const char *key, const char *value,
+					struct lxc_conf *lxc_conf)
+{
+	struct lxc_netdev *netdev;
+
+	netdev = network_netdev(key, value, &lxc_conf->network);
+	if (!netdev)
+		return -1;
+
+	if (!strcmp(value, "none"))
+		netdev->priv.veth_attr.steering = LXC_STEER_NONE;
+	else if (!strcmp(value, "cpuset"))
+		netdev->priv.veth_attr.steering = LXC_STEER_CPUSET;
+	else {
+		ERROR("invalid veth steering '%s'", value);
+		return -1;
+	}
+	return 0;
+}
+
 static int config_network_macvlan_mode(const char *key, const char *value,
 				       struct lxc_conf *lxc_conf)
 {
@@ -606,6 +791,18 @@ static int config_network_macvlan_mode(const char *key, const char *value,
 	return macvlan_mode(&netdev->priv.macvlan_attr.mode, value);
 }
 
+static int config_network_ipvlan_mode(const char *key, const char *value,
+				      struct lxc_conf *lxc_conf)
+{
+	struct lxc_netdev *netdev;
+
+	netdev = network_netdev(key, value, &lxc_conf->network);
+	if (!netdev)
+		return -1;
+
+	return ipvlan_mode(&netdev->priv.ipvlan_attr.mode, value);
+}
+
 static int config_network_hwaddr(const char *key, const char *value,
 				 struct lxc_conf *lxc_conf)
 {
@@ -1002,6 +1199,13 @@ static int config_start(const char *key, const char *value,
 	return -1;
 }
 
+static int config_reboot(const char *key, const char *value,
+		      struct lxc_conf *lxc_conf)
+{
+	lxc_conf->warm_reboot = atoi(value);
+	return 0;
+}
+
 static int config_group(const char *key, const char *value,
 		      struct lxc_conf *lxc_conf)
 {
@@ -1099,6 +1303,40 @@ static int config_logfile(const char *key, const char *value,
 	return ret;
 }
 
+static int config_logfile_size(const char *key, const char *value,
+			       struct lxc_conf *lxc_conf)
+{
+	char *endp = NULL;
+	long n;
+
+	errno = 0;
+	n = strtol(value, &endp, 10);
+	if (value == endp || *endp || n < 0 || n > INT_MAX || errno) {
+		ERROR("invalid size '%s' for %s", value, key);
+		return -1;
+	}
+
+	if (strcmp(key, "lxc.logfile.maxsize") == 0) {
+		lxc_conf->logmaxsize = n;
+		lxc_log_set_max_size(n);
+		return 0;
+	}
+
+	if (n > LXC_LOG_BUFFER_MAX) {
+		ERROR("log buffer size %ld is larger than %d", n,
+		      LXC_LOG_BUFFER_MAX);
+		return -1;
+	}
+	lxc_conf->logbuffer = n;
+	return lxc_log_set_buffer(n);
+}
+
+static int config_tracefile(const char *key, const char *value,
+			    struct lxc_conf *lxc_conf)
+{
+	return config_path_item(&lxc_conf->tracefile, value);
+}
+
 static int config_loglevel(const char *key, const char *value,
 			     struct lxc_conf *lxc_conf)
 {
@@ -1548,6 +1786,24 @@ static int config_console(const char *key, const char *value,
 	return config_path_item(&lxc_conf->console.path, value);
 }
 
+static int config_console_buffer_size(const char *key, const char *value,
+				      struct lxc_conf *lxc_conf)
+{
+	char *endp = NULL;
+	long n;
+
+	errno = 0;
+	n = strtol(value, &endp, 10);
+	if (value == endp || *endp || n < 0 || n > LXC_CONSOLE_BUFFER_MAX ||
+	    errno) {
+		ERROR("invalid console buffer size '%s'", value);
+		return -1;
+	}
+
+	lxc_conf->console.ringbuf.size = n;
+	return 0;
+}
+
 static int config_includefile(const char *key, const char *value,
 			  struct lxc_conf *lxc_conf)
 {
@@ -1604,49 +1860,357 @@ static int config_utsname(const char *key, const char *value,
 	return 0;
 }
 
+/*
+ * Compiled config cache.
+ *
+ * Loading a container means reading its config and every file it
+ * includes, then splitting and dispatching each line.  When
+ * lxc.config_cache is enabled in lxc.conf, the resolved key/value pairs
+ * are saved next to the config as "config.cache", along with the device,
+ * inode, size and mtime of each file they came from.  While none of those
+ * files changed, the pairs are replayed straight from the mmap()ed cache.
+ *
+ * The cache is only meant to be read back on the same host by the same
+ * version of liblxc, so integers are in host byte order.
+ */
+#define CONFIG_CACHE_MAGIC "lxccfgc"
+#define CONFIG_CACHE_VERSION 1
+#define CONFIG_CACHE_ALIGN(x) (((x) + 7) & ~((size_t)7))
+
+struct config_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nfiles;
+	uint32_t nentries;
+	uint32_t size;
+	char lxc_version[32];
+};
+
+/* followed by the path, '\0' terminated */
+struct config_cache_file {
+	uint64_t dev;
+	uint64_t ino;
+	int64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint32_t pathlen;
+	uint32_t pad;
+};
+
+/* followed by the key and the value, each '\0' terminated */
+struct config_cache_entry {
+	uint32_t keylen;
+	uint32_t valuelen;
+};
+
+struct config_cache_buf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+struct lxc_config_record {
+	struct config_cache_buf files;
+	struct config_cache_buf entries;
+	uint32_t nfiles;
+	uint32_t nentries;
+	mode_t mode;
+	bool failed;
+};
+
+/* append one record made of @hdr and two strings, padded to 8 bytes */
+static bool config_cache_buf_add(struct config_cache_buf *b, const void *hdr,
+				 size_t hdrlen, const char *s1, size_t len1,
+				 const char *s2, size_t len2)
+{
+	size_t len = CONFIG_CACHE_ALIGN(hdrlen + len1 + len2);
+	char *p;
+
+	if (b->len + len > b->size) {
+		size_t size = b->size ? b->size * 2 : 4096;
+
+		while (size < b->len + len)
+			size *= 2;
+		p = realloc(b->data, size);
+		if (!p)
+			return false;
+		b->data = p;
+		b->size = size;
+	}
+
+	p = b->data + b->len;
+	memset(p, 0, len);
+	memcpy(p, hdr, hdrlen);
+	memcpy(p + hdrlen, s1, len1);
+	if (s2)
+		memcpy(p + hdrlen + len1, s2, len2);
+	b->len += len;
+	return true;
+}
+
+static void config_record_file(struct lxc_conf *conf, const char *file)
+{
+	struct lxc_config_record *rec = conf->config_record;
+	struct config_cache_file f;
+	struct stat st;
+
+	if (!rec || rec->failed)
+		return;
+
+	/* stat before reading, so a concurrent update invalidates the cache */
+	if (stat(file, &st) < 0) {
+		rec->failed = true;
+		return;
+	}
+	if (!rec->nfiles)
+		rec->mode = st.st_mode & 0777;
+
+	memset(&f, 0, sizeof(f));
+	f.dev = st.st_dev;
+	f.ino = st.st_ino;
+	f.size = st.st_size;
+	f.mtime_sec = st.st_mtim.tv_sec;
+	f.mtime_nsec = st.st_mtim.tv_nsec;
+	f.pathlen = strlen(file) + 1;
+	if (!config_cache_buf_add(&rec->files, &f, sizeof(f), file, f.pathlen,
+				  NULL, 0)) {
+		rec->failed = true;
+		return;
+	}
+	rec->nfiles++;
+}
+
+static void config_record_entry(struct lxc_conf *conf, const char *key,
+				const char *value)
+{
+	struct lxc_config_record *rec = conf->config_record;
+	struct config_cache_entry e;
+
+	if (!rec || rec->failed)
+		return;
+
+	e.keylen = strlen(key) + 1;
+	e.valuelen = strlen(value) + 1;
+	if (!config_cache_buf_add(&rec->entries, &e, sizeof(e), key, e.keylen,
+				  value, e.valuelen)) {
+		rec->failed = true;
+		return;
+	}
+	rec->nentries++;
+}
+
+static void config_cache_save(const char *cachefile,
+			      struct lxc_config_record *rec)
+{
+	struct config_cache_header h;
+	char *tmp;
+	int fd, len;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CONFIG_CACHE_MAGIC, sizeof(h.magic));
+	h.version = CONFIG_CACHE_VERSION;
+	h.nfiles = rec->nfiles;
+	h.nentries = rec->nentries;
+	h.size = sizeof(h) + rec->files.len + rec->entries.len;
+	strncpy(h.lxc_version, LXC_VERSION, sizeof(h.lxc_version) - 1);
+
+	len = strlen(cachefile) + 8;
+	tmp = alloca(len);
+	snprintf(tmp, len, "%s.XXXXXX", cachefile);
+
+	/* written aside and renamed, concurrent readers never see half a cache */
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		INFO("could not create %s: %m", tmp);
+		return;
+	}
+	if (fchmod(fd, rec->mode) < 0 ||
+	    lxc_write_nointr(fd, &h, sizeof(h)) != sizeof(h) ||
+	    lxc_write_nointr(fd, rec->files.data, rec->files.len) != rec->files.len ||
+	    lxc_write_nointr(fd, rec->entries.data, rec->entries.len) != rec->entries.len ||
+	    close(fd) < 0) {
+		INFO("could not write %s: %m", tmp);
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+	if (rename(tmp, cachefile) < 0) {
+		INFO("could not rename %s to %s: %m", tmp, cachefile);
+		unlink(tmp);
+	}
+}
+
+/*
+ * Walk the cache in @map of @size bytes, checking its files are unchanged
+ * and, if @conf is set, applying its entries to @conf.  Returns 1 if the
+ * cache cannot be used, 0 on success and -1 if an entry was rejected.
+ */
+static int config_cache_walk(char *map, size_t size, const char *file,
+			     struct lxc_conf *conf)
+{
+	struct config_cache_header *h = (struct config_cache_header *)map;
+	char *p = map + sizeof(*h), *end = map + size, *key, *value;
+	struct lxc_config_t *config;
+	struct stat st;
+	uint32_t i;
+
+	for (i = 0; i < h->nfiles; i++) {
+		struct config_cache_file *f = (struct config_cache_file *)p;
+
+		if (end - p < sizeof(*f) || !f->pathlen ||
+		    end - p - sizeof(*f) < f->pathlen)
+			return 1;
+		key = p + sizeof(*f);
+		if (key[f->pathlen - 1] != '\0')
+			return 1;
+		if (!conf && (stat(key, &st) < 0 ||
+		    st.st_dev != f->dev || st.st_ino != f->ino ||
+		    st.st_size != f->size ||
+		    st.st_mtim.tv_sec != f->mtime_sec ||
+		    st.st_mtim.tv_nsec != f->mtime_nsec ||
+		    (i == 0 && strcmp(key, file))))
+			return 1;
+		p += CONFIG_CACHE_ALIGN(sizeof(*f) + f->pathlen);
+	}
+
+	for (i = 0; i < h->nentries; i++) {
+		struct config_cache_entry *e = (struct config_cache_entry *)p;
+
+		if (end - p < sizeof(*e) || !e->keylen || !e->valuelen ||
+		    end - p - sizeof(*e) < (size_t)e->keylen + e->valuelen)
+			return 1;
+		key = p + sizeof(*e);
+		value = key + e->keylen;
+		if (key[e->keylen - 1] != '\0' || value[e->valuelen - 1] != '\0')
+			return 1;
+		config = lxc_getconfig(key);
+		if (!config)
+			return 1;
+		if (conf && config->cb(key, value, conf)) {
+			ERROR("failed to apply %s from the config cache", key);
+			return -1;
+		}
+		p += CONFIG_CACHE_ALIGN(sizeof(*e) + e->keylen + e->valuelen);
+	}
+
+	return 0;
+}
+
+static int config_cache_load(const char *cachefile, const char *file,
+			     struct lxc_conf *conf)
+{
+	struct config_cache_header *h;
+	struct stat st;
+	char *map;
+	int fd, ret = 1;
+
+	fd = open(cachefile, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return 1;
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(*h)) {
+		close(fd);
+		return 1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return 1;
+
+	h = (struct config_cache_header *)map;
+	if (memcmp(h->magic, CONFIG_CACHE_MAGIC, sizeof(h->magic)) ||
+	    h->version != CONFIG_CACHE_VERSION || h->size != st.st_size ||
+	    strncmp(h->lxc_version, LXC_VERSION, sizeof(h->lxc_version)) ||
+	    !h->nfiles)
+		goto out;
+
+	/* check the whole cache before applying any of it */
+	if (config_cache_walk(map, st.st_size, file, NULL))
+		goto out;
+
+	if (!conf->rcfile)
+		conf->rcfile = strdup(file);
+	ret = config_cache_walk(map, st.st_size, file, conf);
+	if (ret > 0)
+		ret = -1;
+	else if (!ret)
+		DEBUG("loaded %s from %s", file, cachefile);
+
+out:
+	munmap(map, st.st_size);
+	return ret;
+}
+
+static bool config_cache_enabled(void)
+{
+	const char *v = lxc_global_config_value("lxc.config_cache");
+
+	return v && strcmp(v, "1") == 0;
+}
+
+/*
+ * Read @file like lxc_config_read(), through its config.cache when the
+ * config cache is enabled.
+ */
+int lxc_config_read_cached(const char *file, struct lxc_conf *conf)
+{
+	struct lxc_config_record rec;
+	char *cachefile;
+	int len, ret;
+
+	if (!config_cache_enabled() || conf->config_record)
+		return lxc_config_read(file, conf);
+
+	len = strlen(file) + 7;
+	cachefile = alloca(len);
+	snprintf(cachefile, len, "%s.cache", file);
+
+	ret = config_cache_load(cachefile, file, conf);
+	if (ret <= 0)
+		return ret;
+
+	memset(&rec, 0, sizeof(rec));
+	conf->config_record = &rec;
+	ret = lxc_config_read(file, conf);
+	conf->config_record = NULL;
+
+	if (!ret && !rec.failed)
+		config_cache_save(cachefile, &rec);
+	free(rec.files.data);
+	free(rec.entries.data);
+	return ret;
+}
+
 static int parse_line(char *buffer, void *data)
 {
 	struct lxc_config_t *config;
-	char *line, *linep;
+	char *line = buffer;
 	char *dot;
 	char *key;
 	char *value;
-	int ret = 0;
 
 	if (lxc_is_line_empty(buffer))
 		return 0;
 
-	/* we have to dup the buffer otherwise, at the re-exec for
-	 * reboot we modified the original string on the stack by
-	 * replacing '=' by '\0' below
-	 */
-	linep = line = strdup(buffer);
-	if (!line) {
-		SYSERROR("failed to allocate memory for '%s'", buffer);
-		return -1;
-	}
-
+	/* the line is split in place, see lxc_config_readline() */
 	line += lxc_char_left_gc(line, strlen(line));
 
 	/* martian option - ignoring it, the commented lines beginning by '#'
 	 * fall in this case
 	 */
 	if (strncmp(line, "lxc.", 4))
-		goto out;
-
-	ret = -1;
+		return 0;
 
-	dot = strstr(line, "=");
+	dot = strchr(line, '=');
 	if (!dot) {
 		ERROR("invalid configuration line: %s", line);
-		goto out;
+		return -1;
 	}
 
 	*dot = '\0';
 	value = dot + 1;
 
 	key = line;
-	key[lxc_char_right_gc(key, strlen(key))] = '\0';
+	key[lxc_char_right_gc(key, dot - key)] = '\0';
 
 	value += lxc_char_left_gc(value, strlen(value));
 	value[lxc_char_right_gc(value, strlen(value))] = '\0';
@@ -1654,19 +2218,36 @@ static int parse_line(char *buffer, void *data)
 	config = lxc_getconfig(key);
 	if (!config) {
 		ERROR("unknown key %s", key);
-		goto out;
+		return -1;
 	}
 
-	ret = config->cb(key, value, data);
+	if (config->cb(key, value, data))
+		return -1;
 
-out:
-	free(linep);
-	return ret;
+	/* includes are recorded as the lines they contain */
+	if (config->cb != config_includefile)
+		config_record_entry(data, key, value);
+	return 0;
 }
 
 static int lxc_config_readline(char *buffer, struct lxc_conf *conf)
 {
-	return parse_line(buffer, conf);
+	char *line;
+	int ret;
+
+	/* we have to dup the buffer otherwise, at the re-exec for
+	 * reboot we modified the original string on the stack by
+	 * replacing '=' by '\0' in parse_line
+	 */
+	line = strdup(buffer);
+	if (!line) {
+		SYSERROR("failed to allocate memory for '%s'", buffer);
+		return -1;
+	}
+
+	ret = parse_line(line, conf);
+	free(line);
+	return ret;
 }
 
 int lxc_config_read(const char *file, struct lxc_conf *conf)
@@ -1674,6 +2255,7 @@ int lxc_config_read(const char *file, struct lxc_conf *conf)
 	if( access(file, R_OK) == -1 ) {
 		return -1;
 	}
+	config_record_file(conf, file);
 	/* Catch only the top level config file name in the structure */
 	if( ! conf->rcfile ) {
 		conf->rcfile = strdup( file );
@@ -1943,7 +2525,8 @@ static int lxc_get_mount_entries(struct lxc_conf *c, char *retv, int inlen)
 
 /*
  * lxc.network.0.XXX, where XXX can be: name, type, link, flags, type,
- * macvlan.mode, veth.pair, vlan, ipv4, ipv6, script.up, hwaddr, mtu,
+ * macvlan.mode, ipvlan.mode, veth.pair, veth.txqueues, veth.rxqueues,
+ * veth.steering, vlan, ipv4, ipv6, script.up, hwaddr, mtu,
  * ipv4_gateway, ipv6_gateway.  ipvX_gateway can return 'auto' instead
  * of an address.  ipv4 and ipv6 return lists (newline-separated).
  * things like veth.pair return '' if invalid (i.e. if called for vlan
@@ -2002,6 +2585,10 @@ static int lxc_get_item_nic(struct lxc_conf *c, char *retv, int inlen,
 			}
 			strprint(retv, inlen, "%s", mode);
 		}
+	} else if (strcmp(p1, "ipvlan.mode") == 0) {
+		if (netdev->type == LXC_NET_IPVLAN)
+			strprint(retv, inlen, "%s",
+				 ipvlan_mode_str(netdev->priv.ipvlan_attr.mode));
 	} else if (strcmp(p1, "veth.pair") == 0) {
 		if (netdev->type == LXC_NET_VETH) {
 			strprint(retv, inlen, "%s",
@@ -2009,6 +2596,17 @@ static int lxc_get_item_nic(struct lxc_conf *c, char *retv, int inlen,
 				  netdev->priv.veth_attr.pair :
 				  netdev->priv.veth_attr.veth1);
 		}
+	} else if (strcmp(p1, "veth.txqueues") == 0) {
+		if (netdev->type == LXC_NET_VETH && netdev->priv.veth_attr.txqueues)
+			strprint(retv, inlen, "%d", netdev->priv.veth_attr.txqueues);
+	} else if (strcmp(p1, "veth.rxqueues") == 0) {
+		if (netdev->type == LXC_NET_VETH && netdev->priv.veth_attr.rxqueues)
+			strprint(retv, inlen, "%d", netdev->priv.veth_attr.rxqueues);
+	} else if (strcmp(p1, "veth.steering") == 0) {
+		if (netdev->type == LXC_NET_VETH)
+			strprint(retv, inlen, "%s",
+				 netdev->priv.veth_attr.steering == LXC_STEER_CPUSET ?
+				  "cpuset" : "none");
 	} else if (strcmp(p1, "vlan") == 0) {
 		if (netdev->type == LXC_NET_VLAN) {
 			strprint(retv, inlen, "%d", netdev->priv.vlan_attr.vid);
@@ -2090,8 +2688,14 @@ int lxc_get_config_item(struct lxc_conf *c, const char *key, char *retv,
 		v = c->lsm_se_context;
 	else if (strcmp(key, "lxc.logfile") == 0)
 		v = lxc_log_get_file();
+	else if (strcmp(key, "lxc.logfile.buffer") == 0)
+		return lxc_get_conf_int(c, retv, inlen, c->logbuffer);
+	else if (strcmp(key, "lxc.logfile.maxsize") == 0)
+		return lxc_get_conf_int(c, retv, inlen, c->logmaxsize);
 	else if (strcmp(key, "lxc.loglevel") == 0)
 		v = lxc_log_priority_to_string(lxc_log_get_level());
+	else if (strcmp(key, "lxc.tracefile") == 0)
+		v = c->tracefile;
 	else if (strcmp(key, "lxc.cgroup") == 0) // all cgroup info
 		return lxc_get_cgroup_entry(c, retv, inlen, "all");
 	else if (strncmp(key, "lxc.cgroup.", 11) == 0) // specific cgroup info
@@ -2100,6 +2704,8 @@ int lxc_get_config_item(struct lxc_conf *c, const char *key, char *retv,
 		v = c->utsname ? c->utsname->nodename : NULL;
 	else if (strcmp(key, "lxc.console") == 0)
 		v = c->console.path;
+	else if (strcmp(key, "lxc.console.buffer.size") == 0)
+		return lxc_get_conf_int(c, retv, inlen, c->console.ringbuf.size);
 	else if (strcmp(key, "lxc.rootfs.mount") == 0)
 		v = c->rootfs.mount;
 	else if (strcmp(key, "lxc.rootfs.options") == 0)
@@ -2124,6 +2730,8 @@ int lxc_get_config_item(struct lxc_conf *c, const char *key, char *retv,
 		return lxc_get_conf_int(c, retv, inlen, c->start_delay);
 	else if (strcmp(key, "lxc.start.order") == 0)
 		return lxc_get_conf_int(c, retv, inlen, c->start_order);
+	else if (strcmp(key, "lxc.reboot.warm") == 0)
+		return lxc_get_conf_int(c, retv, inlen, c->warm_reboot);
 	else if (strcmp(key, "lxc.group") == 0)
 		return lxc_get_item_groups(c, retv, inlen);
 	else if (strcmp(key, "lxc.seccomp") == 0)
@@ -2230,6 +2838,12 @@ void write_config(FILE *fout, struct lxc_conf *c)
 		fprintf(fout, "lxc.loglevel = %s\n", lxc_log_priority_to_string(c->loglevel));
 	if (c->logfile)
 		fprintf(fout, "lxc.logfile = %s\n", c->logfile);
+	if (c->logbuffer)
+		fprintf(fout, "lxc.logfile.buffer = %zu\n", c->logbuffer);
+	if (c->logmaxsize)
+		fprintf(fout, "lxc.logfile.maxsize = %zu\n", c->logmaxsize);
+	if (c->tracefile)
+		fprintf(fout, "lxc.tracefile = %s\n", c->tracefile);
 	lxc_list_for_each(it, &c->cgroup) {
 		struct lxc_cgroup *cg = it->elem;
 		fprintf(fout, "lxc.cgroup.%s = %s\n", cg->subsystem, cg->value);
@@ -2256,10 +2870,21 @@ void write_config(FILE *fout, struct lxc_conf *c)
 			default: mode = "(invalid)"; break;
 			}
 			fprintf(fout, "lxc.network.macvlan.mode = %s\n", mode);
+		} else if (n->type == LXC_NET_IPVLAN) {
+			fprintf(fout, "lxc.network.ipvlan.mode = %s\n",
+				ipvlan_mode_str(n->priv.ipvlan_attr.mode));
 		} else if (n->type == LXC_NET_VETH) {
 			if (n->priv.veth_attr.pair)
 				fprintf(fout, "lxc.network.veth.pair = %s\n",
 					n->priv.veth_attr.pair);
+			if (n->priv.veth_attr.txqueues)
+				fprintf(fout, "lxc.network.veth.txqueues = %d\n",
+					n->priv.veth_attr.txqueues);
+			if (n->priv.veth_attr.rxqueues)
+				fprintf(fout, "lxc.network.veth.rxqueues = %d\n",
+					n->priv.veth_attr.rxqueues);
+			if (n->priv.veth_attr.steering == LXC_STEER_CPUSET)
+				fprintf(fout, "lxc.network.veth.steering = cpuset\n");
 		} else if (n->type == LXC_NET_VLAN) {
 			fprintf(fout, "lxc.network.vlan.id = %d\n", n->priv.vlan_attr.vid);
 		}
@@ -2331,6 +2956,9 @@ void write_config(FILE *fout, struct lxc_conf *c)
 	}
 	if (c->console.path)
 		fprintf(fout, "lxc.console = %s\n", c->console.path);
+	if (c->console.ringbuf.size)
+		fprintf(fout, "lxc.console.buffer.size = %zu\n",
+			c->console.ringbuf.size);
 	if (c->rootfs.path)
 		fprintf(fout, "lxc.rootfs = %s\n", c->rootfs.path);
 	if (c->rootfs.mount && strcmp(c->rootfs.mount, LXCROOTFSMOUNT) != 0)
@@ -2345,6 +2973,8 @@ void write_config(FILE *fout, struct lxc_conf *c)
 		fprintf(fout, "lxc.start.delay = %d\n", c->start_delay);
 	if (c->start_order)
 		fprintf(fout, "lxc.start.order = %d\n", c->start_order);
+	if (c->warm_reboot)
+		fprintf(fout, "lxc.reboot.warm = %d\n", c->warm_reboot);
 	lxc_list_for_each(it, &c->groups)
 		fprintf(fout, "lxc.group = %s\n", (char *)it->elem);
 }
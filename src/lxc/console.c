@@ -25,9 +25,11 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <termios.h>
 
@@ -210,6 +212,72 @@ static void lxc_console_sigwinch_fini(struct lxc_tty_state *ts)
 	free(ts);
 }
 
+/*
+ * lxc_console_ringbuf_write: append to the in-memory console log, the
+ * oldest bytes are overwritten once it is full
+ */
+static void lxc_console_ringbuf_write(struct lxc_console_ringbuf *rb,
+				      const char *buf, size_t len)
+{
+	size_t n;
+
+	if (len >= rb->size) {
+		memcpy(rb->buf, buf + len - rb->size, rb->size);
+		rb->pos = 0;
+		rb->full = 1;
+		return;
+	}
+
+	n = rb->size - rb->pos;
+	if (n > len)
+		n = len;
+	memcpy(rb->buf + rb->pos, buf, n);
+	memcpy(rb->buf, buf + n, len - n);
+
+	if (rb->pos + len >= rb->size)
+		rb->full = 1;
+	rb->pos = (rb->pos + len) % rb->size;
+}
+
+/*
+ * lxc_console_ringbuf_get: get a copy of the in-memory console log
+ *
+ * @console : the console
+ * @data    : set to the log, oldest byte first, to be free()ed by the caller
+ * @clear   : whether to empty the log once copied
+ *
+ * Returns the length of the log, < 0 on failure (-ENODATA if the console
+ * has no in-memory log)
+ */
+int lxc_console_ringbuf_get(struct lxc_console *console, char **data,
+			    int clear)
+{
+	struct lxc_console_ringbuf *rb = &console->ringbuf;
+	size_t len, tail;
+
+	*data = NULL;
+	if (!rb->buf)
+		return -ENODATA;
+
+	len = rb->full ? rb->size : rb->pos;
+	if (len) {
+		*data = malloc(len);
+		if (!*data)
+			return -ENOMEM;
+
+		/* when full, the oldest byte is the next one overwritten */
+		tail = len - rb->pos;
+		memcpy(*data, rb->buf + rb->pos % len, tail);
+		memcpy(*data + tail, rb->buf, rb->pos);
+	}
+
+	if (clear) {
+		rb->pos = 0;
+		rb->full = 0;
+	}
+	return len;
+}
+
 static int lxc_console_cb_con(int fd, uint32_t events, void *data,
 			      struct lxc_epoll_descr *descr)
 {
@@ -234,6 +302,9 @@ static int lxc_console_cb_con(int fd, uint32_t events, void *data,
 		w = write(console->master, buf, r);
 
 	if (fd == console->master) {
+		if (console->ringbuf.buf)
+			lxc_console_ringbuf_write(&console->ringbuf, buf, r);
+
 		if (console->log_fd >= 0)
 			w = write(console->log_fd, buf, r);
 
@@ -544,11 +615,17 @@ void lxc_console_delete(struct lxc_console *console)
 	free(console->tios);
 	console->tios = NULL;
 
+	/* a console client, its command socket is gone by now */
+	if (console->peerpty.busy != -1)
+		lxc_console_peer_proxy_free(console);
+
 	close(console->peer);
 	close(console->master);
 	close(console->slave);
 	if (console->log_fd >= 0)
 		close(console->log_fd);
+	free(console->ringbuf.buf);
+	console->ringbuf.buf = NULL;
 
 	console->peer = -1;
 	console->master = -1;
@@ -604,6 +681,18 @@ int lxc_console_create(struct lxc_conf *conf)
 		DEBUG("using '%s' as console log", console->log_path);
 	}
 
+	if (console->ringbuf.size) {
+		console->ringbuf.buf = malloc(console->ringbuf.size);
+		if (!console->ringbuf.buf) {
+			ERROR("failed to allocate the console buffer");
+			goto err;
+		}
+		console->ringbuf.pos = 0;
+		console->ringbuf.full = 0;
+		DEBUG("keeping the last %zu bytes of console output",
+		      console->ringbuf.size);
+	}
+
 	return 0;
 
 err:
@@ -613,52 +702,97 @@ err:
 
 
 
+/*
+ * Write the whole buffer: a pty accepts less than asked for when its
+ * queue is (nearly) full, and nothing at all if fd is non-blocking.
+ */
+static int lxc_console_write_all(int fd, const char *buf, size_t len)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, buf, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN && (poll(&pfd, 1, -1) >= 0 ||
+						errno == EINTR))
+				continue;
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
 static int lxc_console_cb_tty_stdin(int fd, uint32_t events, void *cbdata,
 				    struct lxc_epoll_descr *descr)
 {
 	struct lxc_tty_state *ts = cbdata;
-	char c;
+	char buf[4096];
+	ssize_t r, i, len = 0;
+	int quit = 0;
 
 	assert(fd == ts->stdinfd);
-	if (read(ts->stdinfd, &c, 1) < 0) {
+	r = read(ts->stdinfd, buf, sizeof(buf));
+	if (r < 0) {
+		if (errno == EINTR || errno == EAGAIN)
+			return 0;
 		SYSERROR("failed to read");
 		return 1;
 	}
+	if (!r)
+		return 1;
 
-	/* we want to exit the console with Ctrl+a q */
-	if (c == ts->escape && !ts->saw_escape) {
-		ts->saw_escape = 1;
-		return 0;
+	/*
+	 * We want to exit the console with Ctrl+a q, Ctrl+a Ctrl+a sends
+	 * Ctrl+a itself and Ctrl+a is dropped before anything else. The
+	 * escape is filtered out of the buffer in place, a sequence split
+	 * between two reads is completed by the next one.
+	 */
+	for (i = 0; i < r; i++) {
+		if (buf[i] == ts->escape && !ts->saw_escape) {
+			ts->saw_escape = 1;
+			continue;
+		}
+		if (buf[i] == 'q' && ts->saw_escape) {
+			quit = 1;
+			break;
+		}
+		ts->saw_escape = 0;
+		buf[len++] = buf[i];
 	}
 
-	if (c == 'q' && ts->saw_escape)
-		return 1;
-
-	ts->saw_escape = 0;
-	if (write(ts->masterfd, &c, 1) < 0) {
+	/* what was typed before Ctrl+a q is still sent */
+	if (lxc_console_write_all(ts->masterfd, buf, len) < 0) {
 		SYSERROR("failed to write");
 		return 1;
 	}
 
-	return 0;
+	return quit;
 }
 
 static int lxc_console_cb_tty_master(int fd, uint32_t events, void *cbdata,
 				     struct lxc_epoll_descr *descr)
 {
 	struct lxc_tty_state *ts = cbdata;
-	char buf[1024];
-	int r,w;
+	char buf[4096];
+	ssize_t r;
 
 	assert(fd == ts->masterfd);
 	r = read(fd, buf, sizeof(buf));
 	if (r < 0) {
+		if (errno == EINTR || errno == EAGAIN)
+			return 0;
 		SYSERROR("failed to read");
 		return 1;
 	}
+	if (!r)
+		return 1;
 
-	w = write(ts->stdoutfd, buf, r);
-	if (w < 0 || w != r) {
+	if (lxc_console_write_all(ts->stdoutfd, buf, r) < 0) {
 		SYSERROR("failed to write");
 		return 1;
 	}
@@ -712,6 +846,7 @@ int lxc_console(struct lxc_container *c, int ttynum,
 		ret = -1;
 		goto err2;
 	}
+	ts->stdoutfd = stdoutfd;
 	ts->escape = escape;
 	ts->winch_proxy = c->name;
 	ts->winch_proxy_lxcpath = c->config_path;
@@ -28,6 +28,8 @@ extern int  lxc_console_allocate(struct lxc_conf *conf, int sockfd, int *ttynum)
 extern int  lxc_console_create(struct lxc_conf *);
 extern void lxc_console_delete(struct lxc_console *);
 extern void lxc_console_free(struct lxc_conf *conf, int fd);
+extern int  lxc_console_ringbuf_get(struct lxc_console *console, char **data,
+				    int clear);
 
 extern int  lxc_console_mainloop_add(struct lxc_epoll_descr *, struct lxc_handler *);
 extern void lxc_console_sigwinch(int sig);
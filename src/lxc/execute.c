@@ -132,6 +132,7 @@ static int execute_start(struct lxc_handler *handler, void* data)
 	argv[i++] = NULL;
 
 	NOTICE("exec'ing '%s'", my_args->argv[0]);
+	lxc_log_flush();
 
 	execvp(argv[0], argv);
 	SYSERROR("failed to exec %s", argv[0]);
@@ -28,6 +28,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/param.h>
 
@@ -50,38 +51,135 @@ lxc_state_t freezer_state(const char *name, const char *lxcpath)
 	return lxc_str2state(v);
 }
 
-static int do_freeze_thaw(int freeze, const char *name, const char *lxcpath)
+/* initial and maximum delay between two checks of freezer.state */
+#define FREEZER_POLL_MIN_NSEC	100000L
+#define FREEZER_POLL_MAX_NSEC	100000000L
+
+static int freezer_check(int freeze, const char *name, const char *lxcpath)
 {
 	char v[100];
 	const char *state = freeze ? "FROZEN" : "THAWED";
 
-	if (lxc_cgroup_set("freezer.state", state, name, lxcpath) < 0) {
-		ERROR("Failed to freeze %s:%s", lxcpath, name);
+	if (lxc_cgroup_get("freezer.state", v, 100, name, lxcpath) < 0) {
+		ERROR("Failed to get new freezer state for %s:%s", lxcpath, name);
 		return -1;
 	}
-	while (1) {
-		if (lxc_cgroup_get("freezer.state", v, 100, name, lxcpath) < 0) {
-			ERROR("Failed to get new freezer state for %s:%s", lxcpath, name);
-			return -1;
+	if (v[strlen(v)-1] == '\n')
+		v[strlen(v)-1] = '\0';
+	if (strncmp(v, state, strlen(state)) != 0)
+		return 0;
+
+	if (name)
+		lxc_monitor_send_state(name, freeze ? FROZEN : THAWED, lxcpath);
+	return 1;
+}
+
+static bool freezer_deadline_passed(const struct timespec *start, int timeout)
+{
+	struct timespec now;
+
+	if (timeout < 0)
+		return false;
+	if (clock_gettime(CLOCK_MONOTONIC, &now) < 0)
+		return true;
+	return now.tv_sec - start->tv_sec > timeout ||
+		(now.tv_sec - start->tv_sec == timeout &&
+		 now.tv_nsec >= start->tv_nsec);
+}
+
+/*
+ * Ask all containers to change their freezer state at once, then wait
+ * for them with an exponentially growing delay, so that fast transitions
+ * complete quickly while slow ones don't keep us busy.
+ * @timeout : seconds to wait, or < 0 to wait forever
+ * @done    : if not NULL, set to whether each container reached the state
+ * Returns the number of containers which reached the state
+ */
+static int do_freeze_thaw_many(int freeze, const char **names,
+			       const char **lxcpaths, int count, int timeout,
+			       bool *done)
+{
+	const char *state = freeze ? "FROZEN" : "THAWED";
+	struct timespec start, delay = { 0, FREEZER_POLL_MIN_NSEC };
+	int *pending, npending = 0, nreached = 0, i, j, ret;
+
+	pending = malloc(count * sizeof(*pending));
+	if (!pending)
+		return -1;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &start) < 0) {
+		free(pending);
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (done)
+			done[i] = false;
+		if (freeze)
+			lxc_monitor_send_state(names[i], FREEZING, lxcpaths[i]);
+		if (lxc_cgroup_set("freezer.state", state, names[i], lxcpaths[i]) < 0) {
+			ERROR("Failed to %s %s:%s", freeze ? "freeze" : "thaw",
+			      lxcpaths[i], names[i]);
+			continue;
+		}
+		pending[npending++] = i;
+	}
+
+	while (npending) {
+		for (i = 0, j = 0; i < npending; i++) {
+			int n = pending[i];
+
+			ret = freezer_check(freeze, names[n], lxcpaths[n]);
+			if (ret == 0) {
+				pending[j++] = n;
+				continue;
+			}
+			if (ret > 0) {
+				nreached++;
+				if (done)
+					done[n] = true;
+			}
 		}
-		if (v[strlen(v)-1] == '\n')
-			v[strlen(v)-1] = '\0';
-		if (strncmp(v, state, strlen(state)) == 0) {
-			if (name)
-				lxc_monitor_send_state(name, freeze ? FROZEN : THAWED, lxcpath);
-			return 0;
+		npending = j;
+		if (!npending)
+			break;
+
+		if (freezer_deadline_passed(&start, timeout)) {
+			for (i = 0; i < npending; i++)
+				ERROR("Timed out waiting for %s:%s to become %s",
+				      lxcpaths[pending[i]], names[pending[i]], state);
+			break;
 		}
-		sleep(1);
+
+		nanosleep(&delay, NULL);
+		if (delay.tv_nsec < FREEZER_POLL_MAX_NSEC / 2)
+			delay.tv_nsec *= 2;
+		else
+			delay.tv_nsec = FREEZER_POLL_MAX_NSEC;
 	}
+
+	free(pending);
+	return nreached;
 }
 
 int lxc_freeze(const char *name, const char *lxcpath)
 {
-	lxc_monitor_send_state(name, FREEZING, lxcpath);
-	return do_freeze_thaw(1, name, lxcpath);
+	return do_freeze_thaw_many(1, &name, &lxcpath, 1, -1, NULL) == 1 ? 0 : -1;
 }
 
 int lxc_unfreeze(const char *name, const char *lxcpath)
 {
-	return do_freeze_thaw(0, name, lxcpath);
+	return do_freeze_thaw_many(0, &name, &lxcpath, 1, -1, NULL) == 1 ? 0 : -1;
+}
+
+int lxc_freeze_many(const char **names, const char **lxcpaths, int count,
+		    int timeout, bool *frozen)
+{
+	return do_freeze_thaw_many(1, names, lxcpaths, count, timeout, frozen);
+}
+
+int lxc_unfreeze_many(const char **names, const char **lxcpaths, int count,
+		      int timeout, bool *thawed)
+{
+	return do_freeze_thaw_many(0, names, lxcpaths, count, timeout, thawed);
 }
@@ -32,6 +32,7 @@
 
 #include <fcntl.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "log.h"
 #include "caps.h"
@@ -39,11 +40,24 @@
 
 #define LXC_LOG_PREFIX_SIZE	32
 #define LXC_LOG_BUFFER_SIZE	512
+#define LXC_LOG_FLUSH_MS	500
+
+/* events not yet written to the log file, see lxc_log_set_buffer() */
+struct lxc_log_buffer {
+	char *data;
+	size_t size;
+	size_t len;
+	pid_t pid;		/* the process which logged the events */
+	struct timeval first;	/* when the oldest event was logged */
+};
 
 #ifdef HAVE_TLS
 __thread int lxc_log_fd = -1;
 static __thread char log_prefix[LXC_LOG_PREFIX_SIZE] = "lxc";
 static __thread char *log_fname = NULL;
+static __thread struct lxc_log_buffer log_buffer;
+static __thread size_t log_max_size = 0;
+static __thread size_t log_size = 0;
 /* command line values for logfile or logpriority should always override
  * values from the configuration file or defaults
  */
@@ -53,6 +67,9 @@ static __thread int lxc_loglevel_specified = 0;
 int lxc_log_fd = -1;
 static char log_prefix[LXC_LOG_PREFIX_SIZE] = "lxc";
 static char *log_fname = NULL;
+static struct lxc_log_buffer log_buffer;
+static size_t log_max_size = 0;
+static size_t log_size = 0;
 /* command line values for logfile or logpriority should always override
  * values from the configuration file or defaults
  */
@@ -60,8 +77,39 @@ static int lxc_logfile_specified = 0;
 static int lxc_loglevel_specified = 0;
 #endif
 
+static pthread_once_t log_buffer_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_buffer_key;
+
+/* 0 is never valid, so that no category starts with a cached priority */
+unsigned int lxc_log_generation = 1;
+
 lxc_log_define(lxc_log, lxc);
 
+/*
+ * Look up the priority a category inherits from its parents and cache it,
+ * along with the generation it is valid for, in category->cached.
+ */
+extern unsigned int lxc_log_priority_resolve(struct lxc_log_category *category)
+{
+	const struct lxc_log_category *c = category;
+	unsigned int generation = lxc_log_generation;
+
+	/* the generation is read first, a change meanwhile invalidates us */
+	__sync_synchronize();
+	while (c->priority == LXC_LOG_PRIORITY_NOTSET && c->parent)
+		c = c->parent;
+
+	category->cached = generation << 4 | c->priority;
+	return category->cached;
+}
+
+static void lxc_log_set_priority(struct lxc_log_category *category,
+				 int priority)
+{
+	category->priority = priority;
+	__sync_fetch_and_add(&lxc_log_generation, 1);
+}
+
 /*---------------------------------------------------------------------------*/
 static int log_append_stderr(const struct lxc_log_appender *appender,
 			     struct lxc_log_event *event)
@@ -76,37 +124,173 @@ static int log_append_stderr(const struct lxc_log_appender *appender,
 }
 
 /*---------------------------------------------------------------------------*/
-static int log_append_logfile(const struct lxc_log_appender *appender,
-			      struct lxc_log_event *event)
+/*
+ * Move the log file to <file>.1, replacing the previous one, and go on
+ * with a new file.  Nothing is logged from here, as that would come back
+ * here.
+ */
+static void log_rotate(void)
 {
-	char buffer[LXC_LOG_BUFFER_SIZE];
-	int n;
-	int ms;
+	struct stat st_fd, st_path;
+	char *old;
+	int fd;
 
-	if (lxc_log_fd == -1)
-		return 0;
+	log_size = 0;
+	if (!log_fname || fstat(lxc_log_fd, &st_fd) < 0)
+		return;
+
+	/* another process sharing the file may have rotated it already */
+	if (stat(log_fname, &st_path) == 0 &&
+	    st_path.st_dev == st_fd.st_dev && st_path.st_ino == st_fd.st_ino) {
+		old = malloc(strlen(log_fname) + 3);
+		if (!old)
+			return;
+		sprintf(old, "%s.1", log_fname);
+		if (rename(log_fname, old) < 0) {
+			free(old);
+			return;
+		}
+		free(old);
+	}
 
-	ms = event->timestamp.tv_usec / 1000;
-	n = snprintf(buffer, sizeof(buffer),
-		     "%15s %10ld.%03d %-8s %s - ",
+	fd = lxc_unpriv(open(log_fname, O_CREAT | O_WRONLY |
+			     O_APPEND | O_CLOEXEC, 0666));
+	if (fd < 0)
+		return;
+
+	/* keep the fd number, lxc_log_fd is left open by lxc_check_inherited() */
+	if (dup2(fd, lxc_log_fd) >= 0 &&
+	    fcntl(lxc_log_fd, F_SETFD, FD_CLOEXEC) == 0 &&
+	    fstat(lxc_log_fd, &st_fd) == 0)
+		log_size = st_fd.st_size;
+	close(fd);
+}
+
+static int log_write(const char *buf, size_t len)
+{
+	ssize_t ret;
+
+	if (log_max_size && log_size + len > log_max_size)
+		log_rotate();
+
+	while (len > 0) {
+		ret = write(lxc_log_fd, buf, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+		log_size += ret;
+	}
+	return 0;
+}
+
+/*
+ * Format an event in buf of size bytes, without its trailing newline.
+ * Returns the length of the event, which did not fit if >= size.
+ */
+static int log_format(char *buf, size_t size, struct lxc_log_event *event)
+{
+	va_list va;
+	int n, ret;
+
+	n = snprintf(buf, size, "%15s %10ld.%03d %-8s %s - ",
 		     log_prefix,
 		     event->timestamp.tv_sec,
-		     ms,
+		     (int)(event->timestamp.tv_usec / 1000),
 		     lxc_log_priority_to_string(event->priority),
 		     event->category);
+	if (n < 0)
+		return n;
 
-	n += vsnprintf(buffer + n, sizeof(buffer) - n, event->fmt,
-		       *event->vap);
+	va_copy(va, *event->vap);
+	ret = vsnprintf(n < size ? buf + n : NULL, n < size ? size - n : 0,
+			event->fmt, va);
+	va_end(va);
+	if (ret < 0)
+		return ret;
 
-	if (n >= sizeof(buffer) - 1) {
-		WARN("truncated next event from %d to %zd bytes", n,
-		     sizeof(buffer));
-		n = sizeof(buffer) - 1;
+	return n + ret;
+}
+
+/*
+ * Append an event to the log buffer, returns -1 if it does not fit. The
+ * events inherited from a parent process are dropped, the parent writes
+ * them.
+ */
+static int log_buffer_append(struct lxc_log_event *event)
+{
+	struct lxc_log_buffer *b = &log_buffer;
+	pid_t pid = getpid();
+	long ms;
+	int n;
+
+	if (b->pid != pid) {
+		b->pid = pid;
+		b->len = 0;
 	}
 
-	buffer[n] = '\n';
+	if (b->len) {
+		ms = (event->timestamp.tv_sec - b->first.tv_sec) * 1000 +
+		     (event->timestamp.tv_usec - b->first.tv_usec) / 1000;
+		if (ms >= LXC_LOG_FLUSH_MS)
+			lxc_log_flush();
+	}
+
+	n = log_format(b->data + b->len, b->size - b->len, event);
+	if (n < 0 || n >= b->size - b->len)
+		return -1;
 
-	return write(lxc_log_fd, buffer, n + 1);
+	if (!b->len)
+		b->first = event->timestamp;
+	b->data[b->len + n] = '\n';
+	b->len += n + 1;
+
+	/* errors go out right away, the process may not live much longer */
+	if (b->len == b->size || event->priority >= LXC_LOG_PRIORITY_ERROR)
+		lxc_log_flush();
+	return 0;
+}
+
+static int log_append_logfile(const struct lxc_log_appender *appender,
+			      struct lxc_log_event *event)
+{
+	char buffer[LXC_LOG_BUFFER_SIZE], *line = buffer;
+	int n, ret;
+
+	if (lxc_log_fd == -1)
+		return 0;
+
+	if (log_buffer.data) {
+		if (log_buffer_append(event) == 0)
+			return 0;
+		lxc_log_flush();
+		if (log_buffer_append(event) == 0)
+			return 0;
+		/* larger than the whole buffer, written on its own */
+	}
+
+	n = log_format(buffer, sizeof(buffer), event);
+	if (n < 0)
+		return n;
+
+	if (n >= sizeof(buffer)) {
+		line = malloc(n + 1);
+		if (line)
+			log_format(line, n + 1, event);
+		else {
+			line = buffer;
+			n = sizeof(buffer) - 1;
+		}
+	}
+
+	line[n] = '\n';
+	ret = log_write(line, n + 1);
+	if (line != buffer)
+		free(line);
+	return ret;
 }
 
 static struct lxc_log_appender log_appender_stderr = {
@@ -255,8 +439,11 @@ static char *build_log_path(const char *name, const char *lxcpath)
  */
 static int __lxc_log_set_file(const char *fname, int create_dirs)
 {
+	struct stat st;
+
 	if (lxc_log_fd != -1) {
 		// we are overriding the default.
+		lxc_log_flush();
 		close(lxc_log_fd);
 		free(log_fname);
 	}
@@ -281,6 +468,7 @@ static int __lxc_log_set_file(const char *fname, int create_dirs)
 	if (lxc_log_fd == -1)
 		return -1;
 
+	log_size = fstat(lxc_log_fd, &st) == 0 ? st.st_size : 0;
 	log_fname = strdup(fname);
 	return 0;
 }
@@ -315,7 +503,7 @@ extern int lxc_log_init(const char *name, const char *file,
 	if (priority)
 		lxc_priority = lxc_log_priority_to_int(priority);
 
-	lxc_log_category_lxc.priority = lxc_priority;
+	lxc_log_set_priority(&lxc_log_category_lxc, lxc_priority);
 	lxc_log_category_lxc.appender = &log_appender_logfile;
 
 	if (!quiet)
@@ -372,6 +560,7 @@ extern void lxc_log_close(void)
 {
 	if (lxc_log_fd == -1)
 		return;
+	lxc_log_flush();
 	close(lxc_log_fd);
 	lxc_log_fd = -1;
 	free(log_fname);
@@ -391,7 +580,7 @@ extern int lxc_log_set_level(int level)
 		ERROR("invalid log priority %d", level);
 		return -1;
 	}
-	lxc_log_category_lxc.priority = level;
+	lxc_log_set_priority(&lxc_log_category_lxc, level);
 	return 0;
 }
 
@@ -425,6 +614,82 @@ extern const char *lxc_log_get_file(void)
 	return log_fname;
 }
 
+/* write what a thread buffered when it exits */
+static void log_buffer_thread_exit(void *data)
+{
+	lxc_log_flush();
+	free(log_buffer.data);
+	log_buffer.data = NULL;
+	log_buffer.size = 0;
+}
+
+static void log_buffer_init(void)
+{
+	pthread_key_create(&log_buffer_key, log_buffer_thread_exit);
+}
+
+/* and what the process buffered when it exits */
+__attribute__((destructor))
+static void log_buffer_fini(void)
+{
+	lxc_log_flush();
+}
+
+/*
+ * Keep up to size bytes of events in memory before writing them to the
+ * log file in one go, 0 writes each event as it comes.  The buffer is
+ * written when full, when its oldest event is LXC_LOG_FLUSH_MS old at the
+ * next event, on an error, on lxc_log_flush() and when the thread or
+ * process exits.
+ */
+extern int lxc_log_set_buffer(size_t size)
+{
+	char *data = NULL;
+
+	if (size == log_buffer.size)
+		return 0;
+
+	lxc_log_flush();
+	if (size) {
+		data = malloc(size);
+		if (!data) {
+			ERROR("failed to allocate a %zu bytes log buffer", size);
+			return -1;
+		}
+		pthread_once(&log_buffer_once, log_buffer_init);
+		pthread_setspecific(log_buffer_key, &log_buffer);
+	}
+
+	free(log_buffer.data);
+	log_buffer.data = data;
+	log_buffer.size = size;
+	log_buffer.len = 0;
+	log_buffer.pid = getpid();
+	return 0;
+}
+
+extern void lxc_log_flush(void)
+{
+	struct lxc_log_buffer *b = &log_buffer;
+
+	if (!b->len)
+		return;
+
+	/* the parent process writes the events we inherited from it */
+	if (b->pid == getpid() && lxc_log_fd != -1)
+		log_write(b->data, b->len);
+	b->len = 0;
+}
+
+/*
+ * Rotate the log file to <file>.1 when it would grow past size bytes,
+ * 0 lets it grow forever.
+ */
+extern void lxc_log_set_max_size(size_t size)
+{
+	log_max_size = size;
+}
+
 extern void lxc_log_set_prefix(const char *prefix)
 {
 	strncpy(log_prefix, prefix, sizeof(log_prefix));
@@ -43,6 +43,7 @@
 
 #define LXC_LOG_PREFIX_SIZE	32
 #define LXC_LOG_BUFFER_SIZE	512
+#define LXC_LOG_BUFFER_MAX	(1024 * 1024)
 
 /* predefined priorities. */
 enum lxc_loglevel {
@@ -58,6 +59,13 @@ enum lxc_loglevel {
 	LXC_LOG_PRIORITY_NOTSET,
 };
 
+/*
+ * Events of a lower priority are compiled out, see --with-log-min-level
+ */
+#ifndef LXC_LOG_MIN_PRIORITY
+#define LXC_LOG_MIN_PRIORITY LXC_LOG_PRIORITY_TRACE
+#endif
+
 /* location information of the logging event */
 struct lxc_log_locinfo {
 	const char	*file;
@@ -95,21 +103,31 @@ struct lxc_log_category {
 	int				priority;
 	struct lxc_log_appender		*appender;
 	const struct lxc_log_category	*parent;
+	unsigned int			cached; /* see lxc_log_priority_resolve() */
 };
 
+/*
+ * Bumped each time the priority of a category changes, which invalidates
+ * the priorities cached by the categories.
+ */
+extern unsigned int lxc_log_generation;
+
+extern unsigned int lxc_log_priority_resolve(struct lxc_log_category *category);
+
 /*
  * Returns true if the chained priority is equal to or higher than
  * given priority.
  */
 static inline int
-lxc_log_priority_is_enabled(const struct lxc_log_category* category,
+lxc_log_priority_is_enabled(struct lxc_log_category* category,
 			   int priority)
 {
-	while (category->priority == LXC_LOG_PRIORITY_NOTSET &&
-	       category->parent)
-		category = category->parent;
+	unsigned int cached = category->cached;
 
-	return priority >= category->priority;
+	if (cached >> 4 != lxc_log_generation)
+		cached = lxc_log_priority_resolve(category);
+
+	return priority >= (cached & 0xf);
 }
 
 /*
@@ -175,6 +193,13 @@ __lxc_log(const struct lxc_log_category* category,
 	}
 }
 
+/*
+ * Whether events of the given priority are compiled in. The arguments of
+ * those which are not are still checked, but never evaluated.
+ */
+#define lxc_log_compiled_in(PRIORITY)					\
+	(LXC_LOG_PRIORITY_##PRIORITY >= LXC_LOG_MIN_PRIORITY)
+
 /*
  * Helper macro to define log functions.
  */
@@ -186,7 +211,8 @@ static inline void LXC_##PRIORITY(struct lxc_log_locinfo *,		\
 static inline void LXC_##PRIORITY(struct lxc_log_locinfo* locinfo,	\
 				  const char* format, ...)		\
 {									\
-	if (lxc_log_priority_is_enabled(acategory, 			\
+	if (lxc_log_compiled_in(PRIORITY) &&				\
+	    lxc_log_priority_is_enabled(acategory,			\
 					LXC_LOG_PRIORITY_##PRIORITY)) {	\
 		struct lxc_log_event evt = {				\
 			.category	= (acategory)->name,		\
@@ -237,48 +263,66 @@ static inline void LXC_##PRIORITY(struct lxc_log_locinfo* locinfo,	\
  * top categories
  */
 #define TRACE(format, ...) do {						\
-	struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;		\
-	LXC_TRACE(&locinfo, format, ##__VA_ARGS__);			\
+	if (lxc_log_compiled_in(TRACE)) {				\
+		struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;	\
+		LXC_TRACE(&locinfo, format, ##__VA_ARGS__);		\
+	}								\
 } while (0)
 
 #define DEBUG(format, ...) do {						\
-	struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;		\
-	LXC_DEBUG(&locinfo, format, ##__VA_ARGS__);			\
+	if (lxc_log_compiled_in(DEBUG)) {				\
+		struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;	\
+		LXC_DEBUG(&locinfo, format, ##__VA_ARGS__);		\
+	}								\
 } while (0)
 
 #define INFO(format, ...) do {						\
-	struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;		\
-	LXC_INFO(&locinfo, format, ##__VA_ARGS__);			\
+	if (lxc_log_compiled_in(INFO)) {				\
+		struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;	\
+		LXC_INFO(&locinfo, format, ##__VA_ARGS__);		\
+	}								\
 } while (0)
 
 #define NOTICE(format, ...) do {					\
-	struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;		\
-	LXC_NOTICE(&locinfo, format, ##__VA_ARGS__);			\
+	if (lxc_log_compiled_in(NOTICE)) {				\
+		struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;	\
+		LXC_NOTICE(&locinfo, format, ##__VA_ARGS__);		\
+	}								\
 } while (0)
 
 #define WARN(format, ...) do {						\
-	struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;		\
-	LXC_WARN(&locinfo, format, ##__VA_ARGS__);			\
+	if (lxc_log_compiled_in(WARN)) {				\
+		struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;	\
+		LXC_WARN(&locinfo, format, ##__VA_ARGS__);		\
+	}								\
 } while (0)
 
 #define ERROR(format, ...) do {						\
-	struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;		\
-	LXC_ERROR(&locinfo, format, ##__VA_ARGS__);			\
+	if (lxc_log_compiled_in(ERROR)) {				\
+		struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;	\
+		LXC_ERROR(&locinfo, format, ##__VA_ARGS__);		\
+	}								\
 } while (0)
 
 #define CRIT(format, ...) do {						\
-	struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;		\
-	LXC_CRIT(&locinfo, format, ##__VA_ARGS__);			\
+	if (lxc_log_compiled_in(CRIT)) {				\
+		struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;	\
+		LXC_CRIT(&locinfo, format, ##__VA_ARGS__);		\
+	}								\
 } while (0)
 
 #define ALERT(format, ...) do {						\
-	struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;		\
-	LXC_ALERT(&locinfo, format, ##__VA_ARGS__);			\
+	if (lxc_log_compiled_in(ALERT)) {				\
+		struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;	\
+		LXC_ALERT(&locinfo, format, ##__VA_ARGS__);		\
+	}								\
 } while (0)
 
 #define FATAL(format, ...) do {						\
-	struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;		\
-	LXC_FATAL(&locinfo, format, ##__VA_ARGS__);			\
+	if (lxc_log_compiled_in(FATAL)) {				\
+		struct lxc_log_locinfo locinfo = LXC_LOG_LOCINFO_INIT;	\
+		LXC_FATAL(&locinfo, format, ##__VA_ARGS__);		\
+	}								\
 } while (0)
 
 
@@ -300,6 +344,9 @@ extern int lxc_log_init(const char *name, const char *file,
 extern int lxc_log_set_file(const char *fname);
 extern int lxc_log_set_level(int level);
 extern void lxc_log_set_prefix(const char *prefix);
+extern int lxc_log_set_buffer(size_t size);
+extern void lxc_log_set_max_size(size_t size);
+extern void lxc_log_flush(void);
 extern const char *lxc_log_get_file(void);
 extern int lxc_log_get_level(void);
 extern bool lxc_log_has_valid_level(void);
@@ -27,6 +27,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <sys/select.h>
 #include <sys/types.h>
@@ -101,6 +102,35 @@ extern int lxc_monitor_read_timeout(int fd, struct lxc_msg *msg, int timeout);
  */
 extern int lxc_monitor_read_fdset(fd_set *rfds, int nfds, struct lxc_msg *msg, int timeout);
 
+/*
+ * Create an epoll fd to watch the monitors of several lxcpaths at once
+ * Returns the epoll file descriptor on success, < 0 otherwise
+ */
+extern int lxc_monitor_epoll_create(void);
+
+/*
+ * Watch the monitor of an lxcpath, starting lxc-monitord if needed
+ * @epfd    : the file descriptor provided by lxc_monitor_epoll_create
+ * @lxcpath : the lxcpath to watch
+ * Returns the monitor file descriptor on success, < 0 otherwise
+ */
+extern int lxc_monitor_epoll_add(int epfd, const char *lxcpath);
+
+/*
+ * Blocking read of all the pending container state changes from
+ * multiple monitors, with timeout
+ * @epfd    : the file descriptor provided by lxc_monitor_epoll_create
+ * @msgs    : array of @nmsgs messages which will be filled with the states
+ * @fds     : if not NULL, array of @nmsgs entries which will be filled
+ *            with the monitor fd each message was read from
+ * @nmsgs   : the number of entries of @msgs and @fds
+ * @timeout : the timeout in milliseconds to wait for a state change,
+ *            -1 to wait forever
+ * Returns the number of messages read, -2 on timeout, -1 on error
+ */
+extern int lxc_monitor_read_epoll(int epfd, struct lxc_msg *msgs, int *fds,
+				  int nmsgs, int timeout);
+
 /*
  * Close the fd associated with the monitoring
  * @fd : the file descriptor provided by lxc_monitor_open
@@ -122,6 +152,26 @@ extern int lxc_freeze(const char *name, const char *lxcpath);
  */
 extern int lxc_unfreeze(const char *name, const char *lxcpath);
 
+/*
+ * Freeze several containers in parallel: all of them are asked to
+ * freeze before waiting for any.
+ * @names    : the names of the containers
+ * @lxcpaths : the lxc config paths of the containers
+ * @count    : the number of containers
+ * @timeout  : seconds to wait for the containers, < 0 to wait forever
+ * @frozen   : if not NULL, set to whether each container got frozen
+ * Returns the number of frozen containers, < 0 on error
+ */
+extern int lxc_freeze_many(const char **names, const char **lxcpaths,
+			   int count, int timeout, bool *frozen);
+
+/*
+ * Unfreeze several containers in parallel, see lxc_freeze_many.
+ * Returns the number of thawed containers, < 0 on error
+ */
+extern int lxc_unfreeze_many(const char **names, const char **lxcpaths,
+			     int count, int timeout, bool *thawed);
+
 /*
  * Retrieve the container state
  * @name : the name of the container
@@ -152,6 +202,18 @@ extern int lxc_cgroup_set(const char *filename, const char *value, const char *n
  */
 extern int lxc_cgroup_get(const char *filename, char *value, size_t len, const char *name, const char *lxcpath);
 
+/*
+ * Get the full values of several subsystem files at once, resolving
+ * the container's cgroups only once.
+ * @filenames : NULL terminated array of cgroup attribute filenames
+ * @values    : array receiving one newly allocated value per filename,
+ *              or NULL for the ones which could not be read
+ * @name      : the name of the container
+ * @lxcpath   : lxc config path for container
+ * Returns the number of values read, < 0 on error
+ */
+extern int lxc_cgroup_get_items(const char **filenames, char **values, const char *name, const char *lxcpath);
+
 /*
  * Retrieve the error string associated with the error returned by
  * the function.
@@ -19,7 +19,10 @@
  */
 
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include <lxc/lxccontainer.h>
 
@@ -40,6 +43,7 @@ static int my_parser(struct lxc_arguments* args, int c, char* arg)
 	case 'A': args->ignore_auto = 1; break;
 	case 'g': args->groups = arg; break;
 	case 't': args->timeout = atoi(arg); break;
+	case 'j': args->jobs = atoi(arg); break;
 	}
 	return 0;
 }
@@ -53,6 +57,7 @@ static const struct option my_longopts[] = {
 	{"ignore-auto", no_argument, 0, 'A'},
 	{"groups", required_argument, 0, 'g'},
 	{"timeout", required_argument, 0, 't'},
+	{"jobs", required_argument, 0, 'j'},
 	{"help", no_argument, 0, 'h'},
 	LXC_COMMON_OPTIONS
 };
@@ -72,11 +77,13 @@ Options:\n\
   -a, --all         list all auto-started containers (ignore groups)\n\
   -A, --ignore-auto ignore lxc.start.auto and select all matching containers\n\
   -g, --groups      list of groups (comma separated) to select\n\
-  -t, --timeout=T   wait T seconds before hard-stopping\n",
+  -t, --timeout=T   wait T seconds before hard-stopping\n\
+  -j, --jobs=N      act on up to N containers at once (default 1)\n",
 	.options  = my_longopts,
 	.parser   = my_parser,
 	.checker  = NULL,
 	.timeout = 60,
+	.jobs = 1,
 };
 
 int lists_contain_common_entry(struct lxc_list *p1, struct lxc_list *p2) {
@@ -196,32 +203,222 @@ static int get_config_integer(struct lxc_container *c, char *key) {
 	return ret;
 }
 
-static int cmporder(const void *p1, const void *p2) {
-	struct lxc_container *c1 = *(struct lxc_container **)p1;
-	struct lxc_container *c2 = *(struct lxc_container **)p2;
+struct autostart_job {
+	struct lxc_container *c;
+	int order;
+	int delay;
+	pid_t pid;
+	struct timespec begin;
+};
 
-	int c1_order = get_config_integer(c1, "lxc.start.order");
-	int c2_order = get_config_integer(c2, "lxc.start.order");
+static int cmporder(const void *p1, const void *p2) {
+	const struct autostart_job *j1 = p1;
+	const struct autostart_job *j2 = p2;
 
-	if (c1_order == c2_order)
-		return strcmp(c1->name, c2->name);
+	if (j1->order == j2->order)
+		return strcmp(j1->c->name, j2->c->name);
 	else
-		return (c1_order - c2_order) * -1;
+		return (j1->order - j2->order) * -1;
+}
+
+static struct timespec run_start;
+
+static double elapsed_since(struct timespec *begin)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - begin->tv_sec) +
+	       (now.tv_nsec - begin->tv_nsec) / 1000000000.0;
+}
+
+static char *const default_start_args[] = {
+	"/sbin/init",
+	'\0',
+};
+
+/*
+ * Runs in a worker process, returns the worker's exit status.  Shutdowns
+ * are not done here but by autostart_shutdown_wave().
+ */
+static int autostart_action(struct lxc_container *c)
+{
+	if (my_args.hardstop) {
+		/* Kill the container */
+		if (!c->stop(c)) {
+			fprintf(stderr, "Error killing container: %s\n", c->name);
+			return 1;
+		}
+	}
+	else if (my_args.reboot) {
+		/* Reboot the container */
+		if (!c->reboot(c)) {
+			fprintf(stderr, "Error rebooting container: %s\n", c->name);
+			return 1;
+		}
+	}
+	else {
+		/* Start the container */
+		if (!c->start(c, 0, default_start_args)) {
+			fprintf(stderr, "Error starting container: %s\n", c->name);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Whether the action applies to a container in its current state. */
+static bool autostart_wanted(struct lxc_container *c)
+{
+	if (my_args.shutdown || my_args.hardstop || my_args.reboot)
+		return c->is_running(c);
+	return !c->is_running(c);
+}
+
+static struct autostart_job *find_job(struct autostart_job *jobs, int count,
+				      pid_t pid)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (jobs[i].pid == pid)
+			return &jobs[i];
+	return NULL;
+}
+
+/* Reap one worker, returns false once none is left. */
+static bool autostart_reap(struct autostart_job *jobs, int count)
+{
+	struct autostart_job *job;
+	int status;
+	pid_t pid;
+
+	for (;;) {
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0)
+			return false;
+		job = find_job(jobs, count, pid);
+		if (job)
+			break;
+	}
+
+	job->pid = 0;
+	if (!my_args.quiet)
+		printf("%s %s in %.2fs\n", job->c->name,
+		       WIFEXITED(status) && WEXITSTATUS(status) == 0 ?
+		       "done" : "failed",
+		       elapsed_since(&job->begin));
+	return true;
+}
+
+/*
+ * Shut down the containers of one wave at once, giving them whatever is
+ * left of my_args.timeout since @begin, so that the timeout bounds the
+ * whole run rather than each wave.
+ */
+static void autostart_shutdown_wave(struct autostart_job *jobs, int count,
+				    struct timespec *begin)
+{
+	struct lxc_container **containers;
+	struct timespec now;
+	int i, n = 0, timeout = -1, nclean;
+
+	containers = malloc(count * sizeof(*containers));
+	if (!containers) {
+		fprintf(stderr, "Out of memory\n");
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+		if (autostart_wanted(jobs[i].c))
+			containers[n++] = jobs[i].c;
+
+	if (n == 0) {
+		free(containers);
+		return;
+	}
+
+	if (my_args.timeout >= 0) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		timeout = my_args.timeout - (now.tv_sec - begin->tv_sec);
+		if (timeout < 0)
+			timeout = 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	nclean = lxc_shutdown_containers(containers, n, timeout);
+	if (nclean < 0)
+		fprintf(stderr, "Error shutting down containers\n");
+	else if (!my_args.quiet)
+		printf("%d containers shut down, %d stopped in %.2fs\n",
+		       nclean, n - nclean, elapsed_since(&now));
+
+	free(containers);
+}
+
+/*
+ * Act on the containers of one lxc.start.order wave, with up to
+ * my_args.jobs of them at once.  Returns the largest lxc.start.delay of
+ * the containers acted on.
+ */
+static int autostart_wave(struct autostart_job *jobs, int count)
+{
+	int i, running = 0, delay = 0;
+
+	if (my_args.shutdown && !my_args.list) {
+		autostart_shutdown_wave(jobs, count, &run_start);
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct autostart_job *job = &jobs[i];
+
+		if (!autostart_wanted(job->c))
+			continue;
+
+		if (my_args.list) {
+			if (my_args.shutdown || my_args.hardstop)
+				printf("%s\n", job->c->name);
+			else
+				printf("%s %d\n", job->c->name, job->delay);
+			continue;
+		}
+
+		if (running >= my_args.jobs && autostart_reap(jobs, count))
+			running--;
+
+		clock_gettime(CLOCK_MONOTONIC, &job->begin);
+		fflush(stdout);
+		job->pid = fork();
+		if (job->pid < 0) {
+			fprintf(stderr, "Error forking for container: %s\n", job->c->name);
+			job->pid = 0;
+			continue;
+		}
+		if (job->pid == 0)
+			exit(autostart_action(job->c));
+		running++;
+
+		if (job->delay > delay)
+			delay = job->delay;
+	}
+
+	while (running > 0 && autostart_reap(jobs, count))
+		running--;
+
+	return delay;
 }
 
 int main(int argc, char *argv[])
 {
-	int count = 0;
-	int i = 0;
+	int count = 0, njobs = 0;
+	int i = 0, first, last, step, delay;
 	int ret = 0;
 	struct lxc_container **containers = NULL;
+	struct autostart_job *jobs = NULL;
 	struct lxc_list *cmd_groups_list = NULL;
 	struct lxc_list *c_groups_list = NULL;
 	struct lxc_list *it, *next;
-	char *const default_start_args[] = {
-		"/sbin/init",
-		'\0',
-	};
 
 	if (lxc_arguments_parse(&my_args, argc, argv))
 		return 1;
@@ -231,12 +428,23 @@ int main(int argc, char *argv[])
 		return 1;
 	lxc_log_options_no_override();
 
+	if (my_args.jobs < 1) {
+		fprintf(stderr, "Invalid number of jobs: %d\n", my_args.jobs);
+		return 1;
+	}
+
 	count = list_defined_containers(NULL, NULL, &containers);
 
 	if (count < 0)
 		return 1;
 
-	qsort(&containers[0], count, sizeof(struct lxc_container *), cmporder);
+	jobs = calloc(count ? count : 1, sizeof(*jobs));
+	if (!jobs) {
+		for (i = 0; i < count; i++)
+			lxc_container_put(containers[i]);
+		free(containers);
+		return 1;
+	}
 
 	if (my_args.groups && !my_args.all)
 		cmd_groups_list = get_list((char*)my_args.groups, ",");
@@ -278,64 +486,48 @@ int main(int argc, char *argv[])
 
 		c->want_daemonize(c, 1);
 
-		if (my_args.shutdown) {
-			/* Shutdown the container */
-			if (c->is_running(c)) {
-				if (my_args.list)
-					printf("%s\n", c->name);
-				else {
-					if (!c->shutdown(c, my_args.timeout)) {
-						if (!c->stop(c)) {
-							fprintf(stderr, "Error shutting down container: %s\n", c->name);
-						}
-					}
-				}
-			}
-		}
-		else if (my_args.hardstop) {
-			/* Kill the container */
-			if (c->is_running(c)) {
-				if (my_args.list)
-					printf("%s\n", c->name);
-				else {
-					if (!c->stop(c))
-						fprintf(stderr, "Error killing container: %s\n", c->name);
-				}
-			}
-		}
-		else if (my_args.reboot) {
-			/* Reboot the container */
-			if (c->is_running(c)) {
-				if (my_args.list)
-					printf("%s %d\n", c->name,
-					       get_config_integer(c, "lxc.start.delay"));
-				else {
-					if (!c->reboot(c))
-						fprintf(stderr, "Error rebooting container: %s\n", c->name);
-					else
-						sleep(get_config_integer(c, "lxc.start.delay"));
-				}
-			}
-		}
-		else {
-			/* Start the container */
-			if (!c->is_running(c)) {
-				if (my_args.list)
-					printf("%s %d\n", c->name,
-					       get_config_integer(c, "lxc.start.delay"));
-				else {
-					if (!c->start(c, 0, default_start_args))
-						fprintf(stderr, "Error starting container: %s\n", c->name);
-					else
-						sleep(get_config_integer(c, "lxc.start.delay"));
-				}
-			}
-		}
+		jobs[njobs].c = c;
+		jobs[njobs].order = get_config_integer(c, "lxc.start.order");
+		jobs[njobs].delay = get_config_integer(c, "lxc.start.delay");
+		njobs++;
+	}
 
+	qsort(jobs, njobs, sizeof(*jobs), cmporder);
+	clock_gettime(CLOCK_MONOTONIC, &run_start);
+
+	/*
+	 * Containers sharing a lxc.start.order form a wave, acted on
+	 * concurrently.  Waves start by decreasing order, each waiting for
+	 * the previous one and its lxc.start.delay, and stop the other way
+	 * round so that dependencies go last.
+	 */
+	if (my_args.shutdown || my_args.hardstop) {
+		first = njobs - 1;
+		step = -1;
+	} else {
+		first = 0;
+		step = 1;
+	}
+
+	for (i = first; i >= 0 && i < njobs; i = last + step) {
+		int lo, n;
+
+		for (last = i; last + step >= 0 && last + step < njobs &&
+		     jobs[last + step].order == jobs[i].order; last += step)
+			;
 
-		lxc_container_put(c);
+		lo = step > 0 ? i : last;
+		n = (step > 0 ? last - i : i - last) + 1;
+		delay = autostart_wave(&jobs[lo], n);
+
+		if (delay > 0 && !my_args.list &&
+		    last + step >= 0 && last + step < njobs)
+			sleep(delay);
 	}
 
+	for (i = 0; i < njobs; i++)
+		lxc_container_put(jobs[i].c);
+
 	if (cmd_groups_list) {
 		lxc_list_for_each_safe(it, cmd_groups_list, next) {
 			lxc_list_del(it);
@@ -345,6 +537,7 @@ int main(int argc, char *argv[])
 		free(cmd_groups_list);
 	}
 
+	free(jobs);
 	free(containers);
 
 	return 0;
@@ -36,6 +36,7 @@
 #include "utils.h"
 #include "commands.h"
 #include "arguments.h"
+#include "trace.h"
 
 lxc_log_define(lxc_info_ui, lxc);
 
@@ -43,6 +44,7 @@ static bool ips;
 static bool state;
 static bool pid;
 static bool stats;
+static bool trace;
 static bool humanize = true;
 static char **key = NULL;
 static int keys = 0;
@@ -61,6 +63,7 @@ static int my_parser(struct lxc_arguments* args, int c, char* arg)
 	case 'p': pid = true; filter_count += 1; break;
 	case 'S': stats = true; filter_count += 5; break;
 	case 'H': humanize = false; break;
+	case 'T': trace = true; filter_count += 1; break;
 	}
 	return 0;
 }
@@ -72,6 +75,7 @@ static const struct option my_longopts[] = {
 	{"pid", no_argument, 0, 'p'},
 	{"stats", no_argument, 0, 'S'},
 	{"no-humanize", no_argument, 0, 'H'},
+	{"trace", no_argument, 0, 'T'},
 	LXC_COMMON_OPTIONS,
 };
 
@@ -89,7 +93,8 @@ Options :\n\
   -p, --pid             shows the process id of the init container\n\
   -S, --stats           shows usage stats\n\
   -H, --no-humanize     shows stats as raw numbers, not humanized\n\
-  -s, --state           shows the state of the container\n",
+  -s, --state           shows the state of the container\n\
+  -T, --trace           shows the timings of the container start, as JSON\n",
 	.name     = NULL,
 	.options  = my_longopts,
 	.parser   = my_parser,
@@ -294,7 +299,7 @@ static int print_info(const char *name, const char *lxcpath)
 		return -1;
 	}
 
-	if (!state && !pid && !ips && !stats && keys <= 0) {
+	if (!state && !pid && !ips && !stats && !trace && keys <= 0) {
 		state = pid = ips = stats = true;
 		print_info_msg_str("Name:", c->name);
 	}
@@ -324,6 +329,19 @@ static int print_info(const char *name, const char *lxcpath)
 				}
 			}
 		}
+
+		if (trace) {
+			struct lxc_trace_span *spans;
+			int count;
+
+			count = lxc_cmd_get_trace(c->name, c->config_path, &spans);
+			if (count < 0) {
+				fprintf(stderr, "unable to get the start trace of %s\n", c->name);
+			} else {
+				lxc_trace_print(stdout, c->name, spans, count);
+				free(spans);
+			}
+		}
 	}
 
 	if (stats) {
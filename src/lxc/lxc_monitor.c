@@ -72,10 +72,9 @@ Options :\n\
 int main(int argc, char *argv[])
 {
 	char *regexp;
-	struct lxc_msg msg;
+	struct lxc_msg msgs[32];
 	regex_t preg;
-	fd_set rfds, rfds_save;
-	int len, rc, i, nfds = -1;
+	int len, rc, i, n, epfd;
 
 	if (lxc_arguments_parse(&my_args, argc, argv))
 		return -1;
@@ -130,51 +129,46 @@ int main(int argc, char *argv[])
 	}
 	free(regexp);
 
-	if (my_args.lxcpath_cnt > FD_SETSIZE) {
-		ERROR("too many paths requested, only the first %d will be monitored", FD_SETSIZE);
-		my_args.lxcpath_cnt = FD_SETSIZE;
+	epfd = lxc_monitor_epoll_create();
+	if (epfd < 0) {
+		SYSERROR("failed to create epoll fd");
+		regfree(&preg);
+		return -1;
 	}
 
-	FD_ZERO(&rfds);
 	for (i = 0; i < my_args.lxcpath_cnt; i++) {
-		int fd;
-
-		lxc_monitord_spawn(my_args.lxcpath[i]);
-
-		fd = lxc_monitor_open(my_args.lxcpath[i]);
-		if (fd < 0) {
+		if (lxc_monitor_epoll_add(epfd, my_args.lxcpath[i]) < 0) {
 			regfree(&preg);
 			return -1;
 		}
-		FD_SET(fd, &rfds);
-		if (fd > nfds)
-			nfds = fd;
 	}
-	memcpy(&rfds_save, &rfds, sizeof(rfds_save));
-	nfds++;
 
 	setlinebuf(stdout);
 
 	for (;;) {
-		memcpy(&rfds, &rfds_save, sizeof(rfds));
-
-		if (lxc_monitor_read_fdset(&rfds, nfds, &msg, -1) < 0) {
+		n = lxc_monitor_read_epoll(epfd, msgs, NULL,
+					   sizeof(msgs) / sizeof(msgs[0]), -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
 			regfree(&preg);
 			return -1;
 		}
 
-		msg.name[sizeof(msg.name)-1] = '\0';
-		if (regexec(&preg, msg.name, 0, NULL, 0))
-			continue;
-
-		switch (msg.type) {
-		case lxc_msg_state:
-			printf("'%s' changed state to [%s]\n",
-			       msg.name, lxc_state2str(msg.value));
-			break;
-		default:
-			/* ignore garbage */
-			break;
+		for (i = 0; i < n; i++) {
+			msgs[i].name[sizeof(msgs[i].name)-1] = '\0';
+			if (regexec(&preg, msgs[i].name, 0, NULL, 0))
+				continue;
+
+			switch (msgs[i].type) {
+			case lxc_msg_state:
+				printf("'%s' changed state to [%s]\n",
+				       msgs[i].name, lxc_state2str(msgs[i].value));
+				break;
+			default:
+				/* ignore garbage */
+				break;
+			}
 		}
 	}
 
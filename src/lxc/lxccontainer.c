@@ -55,6 +55,7 @@
 #include "monitor.h"
 #include "namespace.h"
 #include "lxclock.h"
+#include "network.h"
 
 #if HAVE_IFADDRS_H
 #include <ifaddrs.h>
@@ -199,6 +200,8 @@ static void remove_partial(struct lxc_container *c, int fd)
  * 2. container_disk_lock(c) protects the on-disk container data - in particular the
  *    container configuration file.
  *    The container_disk_lock also takes the container_mem_lock.
+ *    Both have a _shared() variant for callers which only read, which lets
+ *    other readers in but keeps out writers.  Unlocking is the same for both.
  * 3. thread_mutex protects process data (ex: fd table) from multiple threads.
  * NOTHING mutexes two independent programs with their own struct
  * lxc_container for the same c->name, between API calls.  For instance,
@@ -249,6 +252,14 @@ static void lxc_container_free(struct lxc_container *c)
 		free(c->config_path);
 		c->config_path = NULL;
 	}
+	if (c->cmd_conn) {
+		lxc_cmd_conn_free(c->cmd_conn);
+		c->cmd_conn = NULL;
+	}
+	if (c->netns_info) {
+		lxc_netns_info_free(c->netns_info);
+		c->netns_info = NULL;
+	}
 
 	free(c);
 }
@@ -322,7 +333,7 @@ static bool lxcapi_is_defined(struct lxc_container *c)
 	if (!c)
 		return false;
 
-	if (container_mem_lock(c))
+	if (container_mem_lock_shared(c))
 		return false;
 	if (!c->configfile)
 		goto out;
@@ -342,14 +353,14 @@ static const char *lxcapi_state(struct lxc_container *c)
 
 	if (!c)
 		return NULL;
-	s = lxc_getstate(c->name, c->config_path);
+	s = lxc_getstate_cached(c->cmd_conn, c->name, c->config_path);
 	return lxc_state2str(s);
 }
 
 static bool is_stopped(struct lxc_container *c)
 {
 	lxc_state_t s;
-	s = lxc_getstate(c->name, c->config_path);
+	s = lxc_getstate_cached(c->cmd_conn, c->name, c->config_path);
 	return (s == STOPPED);
 }
 
@@ -372,6 +383,7 @@ static bool lxcapi_freeze(struct lxc_container *c)
 		return false;
 
 	ret = lxc_freeze(c->name, c->config_path);
+	lxc_state_cache_invalidate(c->name, c->config_path);
 	if (ret)
 		return false;
 	return true;
@@ -384,11 +396,344 @@ static bool lxcapi_unfreeze(struct lxc_container *c)
 		return false;
 
 	ret = lxc_unfreeze(c->name, c->config_path);
+	lxc_state_cache_invalidate(c->name, c->config_path);
 	if (ret)
 		return false;
 	return true;
 }
 
+static int freeze_thaw_containers(bool freeze, struct lxc_container **containers, int count, int timeout)
+{
+	const char **names, **lxcpaths;
+	int i, ret;
+
+	if (!containers || count < 0)
+		return -1;
+	if (!count)
+		return 0;
+	for (i = 0; i < count; i++)
+		if (!containers[i])
+			return -1;
+
+	names = malloc(count * sizeof(*names));
+	lxcpaths = malloc(count * sizeof(*lxcpaths));
+	if (!names || !lxcpaths) {
+		free(names);
+		free(lxcpaths);
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		names[i] = containers[i]->name;
+		lxcpaths[i] = containers[i]->config_path;
+	}
+
+	if (freeze)
+		ret = lxc_freeze_many(names, lxcpaths, count, timeout, NULL);
+	else
+		ret = lxc_unfreeze_many(names, lxcpaths, count, timeout, NULL);
+
+	free(names);
+	free(lxcpaths);
+	return ret;
+}
+
+int lxc_freeze_containers(struct lxc_container **containers, int count, int timeout)
+{
+	return freeze_thaw_containers(true, containers, count, timeout);
+}
+
+int lxc_unfreeze_containers(struct lxc_container **containers, int count, int timeout)
+{
+	return freeze_thaw_containers(false, containers, count, timeout);
+}
+
+#define SHUTDOWN_MSGS		32
+#define SHUTDOWN_RECHECK_MS	1000	/* recheck states this often */
+#define SHUTDOWN_POLL_MS	100	/* or this often, without monitor */
+
+static int shutdown_remaining_ms(const struct timespec *deadline)
+{
+	struct timespec now;
+	long ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (deadline->tv_sec - now.tv_sec) * 1000 +
+	     (deadline->tv_nsec - now.tv_nsec) / 1000000;
+	return ms < 0 ? 0 : ms;
+}
+
+/*
+ * Watch the monitor of every lxcpath found in @containers through a
+ * single epoll set, and record which lxcpath each monitor fd is for.
+ * Returns the epoll fd, < 0 if the states have to be polled instead.
+ */
+static int shutdown_watch(struct lxc_container **containers, int count,
+			  int *monfds, const char **monpaths, int *nmon)
+{
+	int epfd, i, j;
+
+	epfd = lxc_monitor_epoll_create();
+	if (epfd < 0)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < *nmon; j++)
+			if (strcmp(monpaths[j], containers[i]->config_path) == 0)
+				break;
+		if (j < *nmon)
+			continue;
+
+		monfds[j] = lxc_monitor_epoll_add(epfd, containers[i]->config_path);
+		if (monfds[j] < 0) {
+			INFO("No monitor for %s, polling container states",
+			     containers[i]->config_path);
+			for (j = 0; j < *nmon; j++)
+				lxc_monitor_close(monfds[j]);
+			*nmon = 0;
+			close(epfd);
+			return -1;
+		}
+		monpaths[j] = containers[i]->config_path;
+		(*nmon)++;
+	}
+
+	return epfd;
+}
+
+int lxc_shutdown_containers(struct lxc_container **containers, int count, int timeout)
+{
+	struct lxc_msg msgs[SHUTDOWN_MSGS];
+	int fds[SHUTDOWN_MSGS];
+	struct timespec deadline;
+	const char **monpaths = NULL;
+	int *monfds = NULL, *pending = NULL;
+	int npending = 0, nclean = 0, nmon = 0, epfd = -1;
+	int i, j, k, n, wait, ret = -1;
+
+	if (!containers || count < 0)
+		return -1;
+	if (!count)
+		return 0;
+
+	monfds = malloc(count * sizeof(*monfds));
+	monpaths = malloc(count * sizeof(*monpaths));
+	pending = malloc(count * sizeof(*pending));
+	if (!monfds || !monpaths || !pending)
+		goto out;
+
+	for (i = 0; i < count; i++)
+		if (containers[i]->is_running(containers[i]))
+			break;
+	if (i == count) {
+		ret = count;
+		goto out;
+	}
+
+	/* subscribe before signaling, so that no STOPPED can be missed */
+	epfd = shutdown_watch(containers, count, monfds, monpaths, &nmon);
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout;
+
+	for (i = 0; i < count; i++) {
+		struct lxc_container *c = containers[i];
+		int haltsignal = SIGPWR;
+		pid_t pid;
+
+		if (!c->is_running(c)) {
+			nclean++;
+			continue;
+		}
+		pid = c->init_pid(c);
+		if (pid <= 0) {
+			nclean++;
+			continue;
+		}
+		if (c->lxc_conf && c->lxc_conf->haltsignal)
+			haltsignal = c->lxc_conf->haltsignal;
+		if (kill(pid, haltsignal) < 0 && errno == ESRCH) {
+			nclean++;
+			continue;
+		}
+		pending[npending++] = i;
+	}
+
+	while (npending) {
+		wait = epfd >= 0 ? SHUTDOWN_RECHECK_MS : SHUTDOWN_POLL_MS;
+		if (timeout >= 0) {
+			n = shutdown_remaining_ms(&deadline);
+			if (n == 0)
+				break;
+			if (n < wait)
+				wait = n;
+		}
+
+		if (epfd >= 0) {
+			n = lxc_monitor_read_epoll(epfd, msgs, fds, SHUTDOWN_MSGS, wait);
+			if (n == -1 && errno != EINTR) {
+				WARN("Lost the monitor, polling container states");
+				for (k = 0; k < nmon; k++)
+					lxc_monitor_close(monfds[k]);
+				nmon = 0;
+				close(epfd);
+				epfd = -1;
+			}
+		} else {
+			usleep(wait * 1000);
+			n = -2;
+		}
+
+		for (i = 0, j = 0; i < npending; i++) {
+			struct lxc_container *c = containers[pending[i]];
+			bool stopped = false;
+
+			if (n < 0) {
+				stopped = !c->is_running(c);
+			} else {
+				for (k = 0; k < n && !stopped; k++) {
+					int m;
+
+					if (msgs[k].type != lxc_msg_state ||
+					    msgs[k].value != STOPPED ||
+					    strcmp(msgs[k].name, c->name))
+						continue;
+					for (m = 0; m < nmon; m++)
+						if (monfds[m] == fds[k])
+							break;
+					stopped = m < nmon &&
+						  strcmp(monpaths[m], c->config_path) == 0;
+				}
+			}
+
+			if (stopped) {
+				lxc_state_cache_invalidate(c->name, c->config_path);
+				nclean++;
+			} else {
+				pending[j++] = pending[i];
+			}
+		}
+		npending = j;
+	}
+
+	/* the deadline passed, stop the stragglers the hard way */
+	for (i = 0; i < npending; i++) {
+		struct lxc_container *c = containers[pending[i]];
+
+		INFO("Container %s:%s did not shut down in time, stopping it",
+		     c->config_path, c->name);
+		if (lxc_cmd_stop(c->name, c->config_path) < 0 && c->is_running(c))
+			ERROR("Failed to stop %s:%s", c->config_path, c->name);
+		lxc_state_cache_invalidate(c->name, c->config_path);
+	}
+
+	ret = nclean;
+
+out:
+	for (k = 0; k < nmon; k++)
+		lxc_monitor_close(monfds[k]);
+	if (epfd >= 0)
+		close(epfd);
+	free(monfds);
+	free(monpaths);
+	free(pending);
+	return ret;
+}
+
+/*
+ * Pool members of a template are named <template>-pool-<n>, with no gap
+ * in the numbers.
+ */
+static struct lxc_container *pool_member(struct lxc_container *tmpl, int n)
+{
+	char name[NAME_MAX + 1];
+	int ret;
+
+	ret = snprintf(name, sizeof(name), "%s-pool-%d", tmpl->name, n);
+	if (ret < 0 || ret >= sizeof(name))
+		return NULL;
+	return lxc_container_new(name, tmpl->config_path);
+}
+
+int lxc_pool_fill(struct lxc_container *tmpl, int count, int flags)
+{
+	struct lxc_container *c;
+	int i, nparked = 0;
+
+	if (!tmpl || count < 0)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		c = pool_member(tmpl, i);
+		if (!c)
+			return -1;
+
+		if (!c->is_defined(c)) {
+			struct lxc_container *clone;
+
+			clone = tmpl->clone(tmpl, c->name, tmpl->config_path,
+					    flags, NULL, NULL, 0, NULL);
+			lxc_container_put(c);
+			if (!clone) {
+				ERROR("failed to add %s-pool-%d to the pool",
+				      tmpl->name, i);
+				return -1;
+			}
+			c = clone;
+		}
+
+		if (c->is_running(c)) {
+			if (strcmp(c->state(c), "PARKED") == 0)
+				nparked++;
+		} else if (c->park(c)) {
+			nparked++;
+		} else {
+			ERROR("failed to park %s", c->name);
+		}
+		lxc_container_put(c);
+	}
+
+	return nparked;
+}
+
+struct lxc_container *lxc_pool_claim(struct lxc_container *tmpl,
+				     char *const argv[])
+{
+	struct lxc_container *c;
+	int i;
+
+	if (!tmpl || !argv || !argv[0])
+		return NULL;
+
+	for (i = 0; (c = pool_member(tmpl, i)); i++) {
+		if (!c->is_defined(c)) {
+			lxc_container_put(c);
+			break;
+		}
+
+		/* unparking fails if someone claimed it first */
+		if (c->unpark(c, argv))
+			return c;
+		lxc_container_put(c);
+	}
+
+	return NULL;
+}
+
+bool lxc_state_cache_enable(const char *lxcpath, int max_age)
+{
+	if (!lxcpath)
+		lxcpath = lxc_global_config_value("lxc.lxcpath");
+	return lxc_state_cache_start(lxcpath, max_age) == 0;
+}
+
+void lxc_state_cache_disable(const char *lxcpath)
+{
+	if (!lxcpath)
+		lxcpath = lxc_global_config_value("lxc.lxcpath");
+	lxc_state_cache_stop(lxcpath);
+}
+
 static int lxcapi_console_getfd(struct lxc_container *c, int *ttynum, int *masterfd)
 {
 	int ttyfd;
@@ -405,21 +750,45 @@ static int lxcapi_console(struct lxc_container *c, int ttynum, int stdinfd,
 	return lxc_console(c, ttynum, stdinfd, stdoutfd, stderrfd, escape);
 }
 
+static int lxcapi_console_log(struct lxc_container *c, bool clear, char **buf)
+{
+	int ret;
+
+	if (!c || !buf)
+		return -1;
+
+	ret = lxc_cmd_console_log(c->name, c->config_path, clear, buf);
+	if (ret < 0) {
+		if (ret == -ENODATA)
+			ERROR("%s has no console buffer", c->name);
+		return -1;
+	}
+	return ret;
+}
+
 static pid_t lxcapi_init_pid(struct lxc_container *c)
 {
 	if (!c)
 		return -1;
 
-	return lxc_cmd_get_init_pid(c->name, c->config_path);
+	return lxc_cmd_conn_get_init_pid(c->cmd_conn, c->name, c->config_path);
 }
 
 static bool load_config_locked(struct lxc_container *c, const char *fname)
 {
+	int ret;
+
 	if (!c->lxc_conf)
 		c->lxc_conf = lxc_conf_init();
-	if (c->lxc_conf && !lxc_config_read(fname, c->lxc_conf))
-		return true;
-	return false;
+	if (!c->lxc_conf)
+		return false;
+
+	/* only the container's own config gets a config.cache */
+	if (strcmp(fname, c->configfile) == 0)
+		ret = lxc_config_read_cached(fname, c->lxc_conf);
+	else
+		ret = lxc_config_read(fname, c->lxc_conf);
+	return ret == 0;
 }
 
 static bool lxcapi_load_config(struct lxc_container *c, const char *alt_file)
@@ -438,15 +807,15 @@ static bool lxcapi_load_config(struct lxc_container *c, const char *alt_file)
 	/*
 	 * If we're reading something other than the container's config,
 	 * we only need to lock the in-memory container.  If loading the
-	 * container's config file, take the disk lock.
+	 * container's config file, also take the disk lock - shared, as
+	 * the file is only read.
 	 */
 	if (strcmp(fname, c->configfile) == 0)
 		need_disklock = true;
 
-	if (need_disklock)
-		lret = container_disk_lock(c);
-	else
-		lret = container_mem_lock(c);
+	lret = container_mem_lock(c);
+	if (!lret && need_disklock && (lret = lxclock_shared(c->slock, 0)))
+		container_mem_unlock(c);
 	if (lret)
 		return false;
 
@@ -496,11 +865,14 @@ static bool lxcapi_wait(struct lxc_container *c, const char *state, int timeout)
 		return false;
 
 	ret = lxc_wait(c->name, state, timeout, c->config_path);
+	/* the caller will expect state() to agree with what we waited for */
+	lxc_state_cache_invalidate(c->name, c->config_path);
 	return ret == 0;
 }
 
 
-static bool wait_on_daemonized_start(struct lxc_container *c, int pid)
+static bool wait_on_daemonized_start(struct lxc_container *c, int pid,
+				     const char *state)
 {
 	/* we'll probably want to make this timeout configurable? */
 	int timeout = 5, ret, status;
@@ -512,7 +884,7 @@ static bool wait_on_daemonized_start(struct lxc_container *c, int pid)
 	ret = waitpid(pid, &status, 0);
 	if (ret == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
 		DEBUG("failed waiting for first dual-fork child");
-	return lxcapi_wait(c, "RUNNING", timeout);
+	return lxcapi_wait(c, state, timeout);
 }
 
 static bool am_single_threaded(void)
@@ -547,7 +919,8 @@ static bool am_single_threaded(void)
  * I can't decide if it'd be more convenient for callers if we accept '...',
  * or a null-terminated array (i.e. execl vs execv)
  */
-static bool lxcapi_start(struct lxc_container *c, int useinit, char * const argv[])
+static bool do_lxcapi_start(struct lxc_container *c, int useinit,
+			     char * const argv[], bool park)
 {
 	int ret;
 	struct lxc_conf *conf;
@@ -579,13 +952,14 @@ static bool lxcapi_start(struct lxc_container *c, int useinit, char * const argv
 	}
 
 	/* is this app meant to be run through lxcinit, as in lxc-execute? */
-	if (useinit && !argv)
+	if (useinit && (!argv || park))
 		return false;
 
 	if (container_mem_lock(c))
 		return false;
 	conf = c->lxc_conf;
-	daemonize = c->daemonize;
+	/* a parked container has to be handed over to its monitor */
+	daemonize = c->daemonize || park;
 	container_mem_unlock(c);
 
 	if (useinit) {
@@ -614,7 +988,8 @@ static bool lxcapi_start(struct lxc_container *c, int useinit, char * const argv
 			 * the PID file, child will do the free and unlink.
 			 */
 			c->pidfile = NULL;
-			return wait_on_daemonized_start(c, pid);
+			return wait_on_daemonized_start(c, pid,
+					park ? "PARKED" : "RUNNING");
 		}
 
 		/* second fork to be reparented by init */
@@ -666,6 +1041,7 @@ static bool lxcapi_start(struct lxc_container *c, int useinit, char * const argv
 		pid_fp = NULL;
 	}
 
+	conf->park = park;
 reboot:
 	conf->reboot = 0;
 	ret = lxc_start(c->name, argv, conf, c->config_path);
@@ -673,6 +1049,8 @@ reboot:
 	if (conf->reboot) {
 		INFO("container requested reboot");
 		conf->reboot = 0;
+		/* it was unparked with its command already */
+		conf->park = 0;
 		goto reboot;
 	}
 
@@ -688,6 +1066,30 @@ reboot:
 		return (ret == 0 ? true : false);
 }
 
+static bool lxcapi_start(struct lxc_container *c, int useinit, char * const argv[])
+{
+	return do_lxcapi_start(c, useinit, argv, false);
+}
+
+static bool lxcapi_park(struct lxc_container *c)
+{
+	return do_lxcapi_start(c, 0, NULL, true);
+}
+
+static bool lxcapi_unpark(struct lxc_container *c, char * const argv[])
+{
+	int ret;
+
+	if (!c)
+		return false;
+
+	ret = lxc_cmd_unpark(c->name, c->config_path, argv);
+	lxc_state_cache_invalidate(c->name, c->config_path);
+	if (ret < 0)
+		INFO("failed to unpark %s: %s", c->name, strerror(-ret));
+	return ret == 0;
+}
+
 /*
  * note there MUST be an ending NULL
  */
@@ -731,7 +1133,10 @@ static bool lxcapi_stop(struct lxc_container *c)
 	if (!c)
 		return false;
 
+	/* don't keep the network namespace alive */
+	lxc_netns_info_release(c->netns_info);
 	ret = lxc_cmd_stop(c->name, c->config_path);
+	lxc_state_cache_invalidate(c->name, c->config_path);
 
 	return ret == 0;
 }
@@ -1094,6 +1499,7 @@ static bool create_run_template(struct lxc_container *c, char *tpath, bool quiet
 			newargv = n2;
 		}
 		/* execute */
+		lxc_log_flush();
 		execvp(tpath, newargv);
 		SYSERROR("failed to execute template %s", tpath);
 		exit(1);
@@ -1384,6 +1790,7 @@ static bool lxcapi_shutdown(struct lxc_container *c, int timeout)
 	if (!c)
 		return false;
 
+	lxc_netns_info_release(c->netns_info);
 	if (!c->is_running(c))
 		return true;
 	pid = c->init_pid(c);
@@ -1496,12 +1903,6 @@ static inline int string_cmp(char **first, char **second)
 	return strcmp(*first, *second);
 }
 
-// used by qsort and bsearch functions for comparing container names
-static inline int container_cmp(struct lxc_container **first, struct lxc_container **second)
-{
-	return strcmp((*first)->name, (*second)->name);
-}
-
 static bool add_to_array(char ***names, char *cname, int pos)
 {
 	char **newnames = realloc(*names, (pos+1) * sizeof(char *));
@@ -1521,24 +1922,6 @@ static bool add_to_array(char ***names, char *cname, int pos)
 	return true;
 }
 
-static bool add_to_clist(struct lxc_container ***list, struct lxc_container *c, int pos, bool sort)
-{
-	struct lxc_container **newlist = realloc(*list, (pos+1) * sizeof(struct lxc_container *));
-	if (!newlist) {
-		ERROR("Out of memory");
-		return false;
-	}
-
-	*list = newlist;
-	newlist[pos] = c;
-
-	// sort the arrray as we will use binary search on it
-	if (sort)
-		qsort(newlist, pos + 1, sizeof(struct lxc_container *), (int (*)(const void *,const void *))container_cmp);
-
-	return true;
-}
-
 static char** get_from_array(char ***names, char *cname, int size)
 {
 	return (char **)bsearch(&cname, *names, size, sizeof(char *), (int (*)(const void *, const void *))string_cmp);
@@ -1551,17 +1934,7 @@ static bool array_contains(char ***names, char *cname, int size) {
 	return false;
 }
 
-static bool remove_from_array(char ***names, char *cname, int size)
-{
-	char **result = get_from_array(names, cname, size);
-	if (result != NULL) {
-		free(result);
-		return true;
-	}
-	return false;
-}
-
-static char** lxcapi_get_interfaces(struct lxc_container *c)
+static char** get_interfaces_forked(struct lxc_container *c)
 {
 	pid_t pid;
 	int i, count = 0, pipefd[2];
@@ -1648,7 +2021,7 @@ static char** lxcapi_get_interfaces(struct lxc_container *c)
 	return interfaces;
 }
 
-static char** lxcapi_get_ips(struct lxc_container *c, const char* interface, const char* family, int scope)
+static char** get_ips_forked(struct lxc_container *c, const char* interface, const char* family, int scope)
 {
 	pid_t pid;
 	int i, count = 0, pipefd[2];
@@ -1765,13 +2138,132 @@ static char** lxcapi_get_ips(struct lxc_container *c, const char* interface, con
 	return addresses;
 }
 
+struct netns_query {
+	char **result;
+	int count;
+	const char *interface;
+	const char *family;
+	int scope;
+};
+
+static int netns_query_add(struct netns_query *q, const char *s)
+{
+	if (!add_to_array(&q->result, (char *)s, q->count))
+		return -ENOMEM;
+	q->count++;
+	return 0;
+}
+
+static char **netns_query_result(struct netns_query *q, int err)
+{
+	int i;
+
+	if (err) {
+		for (i = 0; i < q->count; i++)
+			free(q->result[i]);
+		free(q->result);
+		return NULL;
+	}
+	if (!q->result)
+		return NULL;
+	return (char **)lxc_append_null_to_array((void **)q->result, q->count);
+}
+
+static int netns_add_interface(const char *ifname, void *data)
+{
+	struct netns_query *q = data;
+
+	if (array_contains(&q->result, (char *)ifname, q->count))
+		return 0;
+	return netns_query_add(q, ifname);
+}
+
+/* same filters as get_ips_forked applies to getifaddrs */
+static int netns_add_ip(const char *ifname, int family, int scope_id,
+			const char *address, void *data)
+{
+	struct netns_query *q = data;
+
+	if (family == AF_INET) {
+		if (q->family && strcmp(q->family, "inet"))
+			return 0;
+	} else {
+		if (q->family && strcmp(q->family, "inet6"))
+			return 0;
+		if (scope_id != q->scope)
+			return 0;
+	}
+
+	if (q->interface && strcmp(q->interface, ifname))
+		return 0;
+	else if (!q->interface && strcmp("lo", ifname) == 0)
+		return 0;
+
+	return netns_query_add(q, address);
+}
+
+/*
+ * get_interfaces and get_ips read the container network namespace over
+ * netlink from this process and cache the answer (see network.h), which
+ * keeps lxc-ls --fancy from forking once per container. They fall back
+ * to a forked child which enters the namespaces when we are not allowed
+ * to, e.g. when unprivileged.
+ */
+static char** lxcapi_get_interfaces(struct lxc_container *c)
+{
+	struct netns_query q = { 0 };
+	pid_t init_pid;
+	int err;
+
+	init_pid = c->init_pid(c);
+	if (init_pid <= 0) {
+		lxc_netns_info_release(c->netns_info);
+		return NULL;
+	}
+
+	err = lxc_netns_foreach_link(c->netns_info, init_pid,
+				     netns_add_interface, &q);
+	if (!err)
+		return netns_query_result(&q, 0);
+
+	netns_query_result(&q, err);
+	DEBUG("netlink query of %s failed: %s, forking", c->name, strerror(-err));
+	return get_interfaces_forked(c);
+}
+
+static char** lxcapi_get_ips(struct lxc_container *c, const char* interface, const char* family, int scope)
+{
+	struct netns_query q = {
+		.interface = interface,
+		.family = family,
+		.scope = scope,
+	};
+	pid_t init_pid;
+	int err;
+
+	init_pid = c->init_pid(c);
+	if (init_pid <= 0) {
+		lxc_netns_info_release(c->netns_info);
+		return NULL;
+	}
+
+	err = lxc_netns_foreach_addr(c->netns_info, init_pid,
+				     netns_add_ip, &q);
+	if (!err)
+		return netns_query_result(&q, 0);
+
+	netns_query_result(&q, err);
+	DEBUG("netlink query of %s failed: %s, forking", c->name, strerror(-err));
+	return get_ips_forked(c, interface, family, scope);
+}
+
 static int lxcapi_get_config_item(struct lxc_container *c, const char *key, char *retv, int inlen)
 {
 	int ret;
 
 	if (!c || !c->lxc_conf)
 		return -1;
-	if (container_mem_lock(c))
+	if (container_mem_lock_shared(c))
 		return -1;
 	ret = lxc_get_config_item(c->lxc_conf, key, retv, inlen);
 	container_mem_unlock(c);
@@ -1786,7 +2278,7 @@ static char* lxcapi_get_running_config_item(struct lxc_container *c, const char
 		return NULL;
 	if (container_mem_lock(c))
 		return NULL;
-	ret = lxc_cmd_get_config_item(c->name, key, c->get_config_path(c));
+	ret = lxc_cmd_conn_get_config_item(c->cmd_conn, c->name, key, c->get_config_path(c));
 	container_mem_unlock(c);
 	return ret;
 }
@@ -1802,7 +2294,7 @@ static int lxcapi_get_keys(struct lxc_container *c, const char *key, char *retv,
 	 */
 	if (!c || !c->lxc_conf)
 		return -1;
-	if (container_mem_lock(c))
+	if (container_mem_lock_shared(c))
 		return -1;
 	int ret = -1;
 	if (strncmp(key, "lxc.network.", 12) == 0)
@@ -1997,6 +2489,7 @@ static bool lxcapi_destroy(struct lxc_container *c)
 	if (!c || !lxcapi_is_defined(c))
 		return false;
 
+	lxc_netns_info_release(c->netns_info);
 	if (container_disk_lock(c))
 		return false;
 
@@ -2190,7 +2683,7 @@ static int lxcapi_get_cgroup_item(struct lxc_container *c, const char *subsys, c
 	if (is_stopped(c))
 		return -1;
 
-	if (container_disk_lock(c))
+	if (container_disk_lock_shared(c))
 		return -1;
 
 	ret = lxc_cgroup_get(subsys, retv, inlen, c->name, c->config_path);
@@ -2199,6 +2692,75 @@ static int lxcapi_get_cgroup_item(struct lxc_container *c, const char *subsys, c
 	return ret;
 }
 
+static void lxc_cgroup_item_free(struct lxc_cgroup_item *item)
+{
+	if (item->key)
+		free(item->key);
+	if (item->value)
+		free(item->value);
+}
+
+static int lxcapi_get_cgroup_items(struct lxc_container *c, const char **keys, struct lxc_cgroup_item **items)
+{
+	struct lxc_cgroup_item *result;
+	char **values;
+	int i, j, count;
+
+	if (!c || !keys || !items)
+		return -1;
+
+	if (is_stopped(c))
+		return -1;
+
+	for (count = 0; keys[count]; count++)
+		;
+
+	values = calloc(count + 1, sizeof(*values));
+	result = calloc(count + 1, sizeof(*result));
+	if (!values || !result) {
+		free(values);
+		free(result);
+		return -1;
+	}
+
+	if (container_disk_lock_shared(c)) {
+		free(values);
+		free(result);
+		return -1;
+	}
+
+	if (lxc_cgroup_get_items(keys, values, c->name, c->config_path) < 0) {
+		container_disk_unlock(c);
+		free(values);
+		free(result);
+		return -1;
+	}
+
+	container_disk_unlock(c);
+
+	for (i = 0; i < count; i++) {
+		result[i].free = lxc_cgroup_item_free;
+		result[i].value = values[i];
+		result[i].key = strdup(keys[i]);
+		if (!result[i].key) {
+			for (j = i; j < count; j++)
+				free(values[j]);
+			goto out_free;
+		}
+	}
+
+	free(values);
+	*items = result;
+	return count;
+
+out_free:
+	while (--i >= 0)
+		result[i].free(&result[i]);
+	free(values);
+	free(result);
+	return -1;
+}
+
 const char *lxc_get_global_config_item(const char *key)
 {
 	return lxc_global_config_value(key);
@@ -2734,7 +3296,10 @@ static struct lxc_container *lxcapi_clone(struct lxc_container *c, const char *n
 	if (ret < 0)
 		exit(1);
 
-	container_mem_unlock(c);
+	/*
+	 * Don't unlock: the lock is held by the parent's thread, which
+	 * releases it, and unlocking an rwlock we don't own is undefined.
+	 */
 	exit(0);
 
 out:
@@ -3315,11 +3880,21 @@ struct lxc_container *lxc_container_new(const char *name, const char *configpath
 		goto err;
 	}
 
-	if (!(c->privlock = lxc_newlock(NULL, NULL))) {
+	if (!(c->privlock = lxc_newrwlock())) {
 		fprintf(stderr, "failed to alloc privlock\n");
 		goto err;
 	}
 
+	if (!(c->cmd_conn = lxc_cmd_conn_new())) {
+		fprintf(stderr, "failed to alloc command connection\n");
+		goto err;
+	}
+
+	if (!(c->netns_info = lxc_netns_info_new())) {
+		fprintf(stderr, "failed to alloc network namespace info\n");
+		goto err;
+	}
+
 	if (!set_config_filename(c)) {
 		fprintf(stderr, "Error allocating config file pathname\n");
 		goto err;
@@ -3344,6 +3919,7 @@ struct lxc_container *lxc_container_new(const char *name, const char *configpath
 	c->unfreeze = lxcapi_unfreeze;
 	c->console = lxcapi_console;
 	c->console_getfd = lxcapi_console_getfd;
+	c->console_log = lxcapi_console_log;
 	c->init_pid = lxcapi_init_pid;
 	c->load_config = lxcapi_load_config;
 	c->want_daemonize = lxcapi_want_daemonize;
@@ -3383,6 +3959,9 @@ struct lxc_container *lxc_container_new(const char *name, const char *configpath
 	c->may_control = lxcapi_may_control;
 	c->add_device_node = lxcapi_add_device_node;
 	c->remove_device_node = lxcapi_remove_device_node;
+	c->get_cgroup_items = lxcapi_get_cgroup_items;
+	c->park = lxcapi_park;
+	c->unpark = lxcapi_unpark;
 
 	/* we'll allow the caller to update these later */
 	if (lxc_log_init(NULL, "none", NULL, "lxc_container", 0, c->config_path)) {
@@ -3408,18 +3987,79 @@ int lxc_get_wait_states(const char **states)
 }
 
 /*
- * These next two could probably be done smarter with reusing a common function
- * with different iterators and tests...
+ * Container names found while listing a lxcpath.  Names are appended in
+ * amortized constant time and sorted once when collection is done, so
+ * listing a lxcpath with thousands of containers stays cheap.
  */
-int list_defined_containers(const char *lxcpath, char ***names, struct lxc_container ***cret)
+struct lxc_name_array {
+	char **names;
+	int count;
+	int capacity;
+};
+
+static bool name_array_append(struct lxc_name_array *a, const char *name)
+{
+	if (a->count == a->capacity) {
+		int capacity = a->capacity ? a->capacity * 2 : 32;
+		char **names = realloc(a->names, capacity * sizeof(char *));
+
+		if (!names) {
+			ERROR("Out of memory");
+			return false;
+		}
+		a->names = names;
+		a->capacity = capacity;
+	}
+
+	a->names[a->count] = strdup(name);
+	if (!a->names[a->count]) {
+		ERROR("Out of memory");
+		return false;
+	}
+	a->count++;
+	return true;
+}
+
+static void name_array_free(struct lxc_name_array *a)
+{
+	int i;
+
+	for (i = 0; i < a->count; i++)
+		free(a->names[i]);
+	free(a->names);
+	a->names = NULL;
+	a->count = a->capacity = 0;
+}
+
+// sort the names and drop duplicates
+static void name_array_sort(struct lxc_name_array *a)
+{
+	int i, j;
+
+	if (a->count < 2)
+		return;
+
+	qsort(a->names, a->count, sizeof(char *), (int (*)(const void *,const void *))string_cmp);
+
+	for (i = 1, j = 0; i < a->count; i++) {
+		if (strcmp(a->names[i], a->names[j]) == 0)
+			free(a->names[i]);
+		else
+			a->names[++j] = a->names[i];
+	}
+	a->count = j + 1;
+}
+
+/*
+ * Add every container under @lxcpath which has a config file.  This is
+ * the same stat() which is_defined() does, so no container has to be
+ * instantiated to find out.
+ */
+static int collect_defined_names(const char *lxcpath, struct lxc_name_array *a)
 {
 	DIR *dir;
-	int i, cfound = 0, nfound = 0;
 	struct dirent dirent, *direntp;
-	struct lxc_container *c;
-
-	if (!lxcpath)
-		lxcpath = lxc_global_config_value("lxc.lxcpath");
+	int ret = 0;
 
 	dir = opendir(lxcpath);
 	if (!dir) {
@@ -3427,11 +4067,6 @@ int list_defined_containers(const char *lxcpath, char ***names, struct lxc_conta
 		return -1;
 	}
 
-	if (cret)
-		*cret = NULL;
-	if (names)
-		*names = NULL;
-
 	while (!readdir_r(dir, &dirent, &direntp)) {
 		if (!direntp)
 			break;
@@ -3443,83 +4078,45 @@ int list_defined_containers(const char *lxcpath, char ***names, struct lxc_conta
 		if (!config_file_exists(lxcpath, direntp->d_name))
 			continue;
 
-		if (names) {
-			if (!add_to_array(names, direntp->d_name, cfound))
-				goto free_bad;
-		}
-		cfound++;
-
-		if (!cret) {
-			nfound++;
-			continue;
-		}
-
-		c = lxc_container_new(direntp->d_name, lxcpath);
-		if (!c) {
-			INFO("Container %s:%s has a config but could not be loaded",
-				lxcpath, direntp->d_name);
-			if (names)
-				if(!remove_from_array(names, direntp->d_name, cfound--))
-					goto free_bad;
-			continue;
-		}
-		if (!lxcapi_is_defined(c)) {
-			INFO("Container %s:%s has a config but is not defined",
-				lxcpath, direntp->d_name);
-			if (names)
-				if(!remove_from_array(names, direntp->d_name, cfound--))
-					goto free_bad;
-			lxc_container_put(c);
-			continue;
-		}
-
-		if (!add_to_clist(cret, c, nfound, true)) {
-			lxc_container_put(c);
-			goto free_bad;
+		if (!name_array_append(a, direntp->d_name)) {
+			ret = -1;
+			break;
 		}
-		nfound++;
 	}
 
 	closedir(dir);
-	return nfound;
+	return ret;
+}
 
-free_bad:
-	if (names && *names) {
-		for (i=0; i<cfound; i++)
-			free((*names)[i]);
-		free(*names);
-	}
-	if (cret && *cret) {
-		for (i=0; i<nfound; i++)
-			lxc_container_put((*cret)[i]);
-		free(*cret);
-	}
-	closedir(dir);
-	return -1;
+static bool collect_running_name(const char *name, void *data)
+{
+	return name_array_append(data, name);
 }
 
-int list_active_containers(const char *lxcpath, char ***nret,
-			   struct lxc_container ***cret)
+/*
+ * Add every container under @lxcpath which has a command socket.  The
+ * registry of running containers kept by lxc_init() is read when there is
+ * one, and all unix sockets are scanned for container command sockets, as
+ * containers which could not register, or were started by a liblxc without
+ * the registry, are only found there.  Duplicates are dropped on sorting.
+ */
+static int collect_active_names(const char *lxcpath, struct lxc_name_array *a)
 {
-	int i, ret = -1, cret_cnt = 0, ct_name_cnt = 0;
-	int lxcpath_len;
+	int ret = 0, lxcpath_len = strlen(lxcpath), count = a->count, listed;
 	char *line = NULL;
-	char **ct_name = NULL;
 	size_t len = 0;
-	struct lxc_container *c;
-
-	if (!lxcpath)
-		lxcpath = lxc_global_config_value("lxc.lxcpath");
-	lxcpath_len = strlen(lxcpath);
+	FILE *f;
 
-	if (cret)
-		*cret = NULL;
-	if (nret)
-		*nret = NULL;
+	listed = lxc_running_list(lxcpath, collect_running_name, a);
+	if (listed < 0) {
+		// drop whatever a failed registry read added
+		while (a->count > count)
+			free(a->names[--a->count]);
+	}
 
-	FILE *f = fopen("/proc/net/unix", "r");
+	f = fopen("/proc/net/unix", "r");
 	if (!f)
-		return -1;
+		return listed < 0 ? -1 : 0;
 
 	while (getline(&line, &len, f) != -1) {
 		char *p = strrchr(line, ' '), *p2;
@@ -3541,149 +4138,235 @@ int list_active_containers(const char *lxcpath, char ***nret,
 			continue;
 		*p2 = '\0';
 
-		if (array_contains(&ct_name, p, ct_name_cnt))
-			continue;
+		if (!name_array_append(a, p)) {
+			ret = -1;
+			break;
+		}
+	}
+
+	if (line)
+		free(line);
+	fclose(f);
+	return ret;
+}
+
+/*
+ * Instantiate a container for each (sorted) name.  Names whose container
+ * cannot be loaded are dropped from @a, so @a and *@cret stay in step.
+ */
+static int load_containers(const char *lxcpath, struct lxc_name_array *a,
+			   struct lxc_container ***cret)
+{
+	struct lxc_container **list;
+	int i, n = 0;
 
-		if (!add_to_array(&ct_name, p, ct_name_cnt))
-			goto free_cret_list;
+	*cret = NULL;
+	if (!a->count)
+		return 0;
 
-		ct_name_cnt++;
+	list = malloc(a->count * sizeof(struct lxc_container *));
+	if (!list) {
+		ERROR("Out of memory");
+		return -1;
+	}
 
-		if (!cret)
-			continue;
+	for (i = 0; i < a->count; i++) {
+		struct lxc_container *c = lxc_container_new(a->names[i], lxcpath);
 
-		c = lxc_container_new(p, lxcpath);
 		if (!c) {
-			INFO("Container %s:%s is running but could not be loaded",
-				lxcpath, p);
-			remove_from_array(&ct_name, p, ct_name_cnt--);
+			INFO("Container %s:%s could not be loaded",
+				lxcpath, a->names[i]);
+			free(a->names[i]);
 			continue;
 		}
+		list[n] = c;
+		a->names[n++] = a->names[i];
+	}
+	a->count = n;
 
-		/*
-		 * If this is an anonymous container, then is_defined *can*
-		 * return false.  So we don't do that check.  Count on the
-		 * fact that the command socket exists.
-		 */
-
-		if (!add_to_clist(cret, c, cret_cnt, true)) {
-			lxc_container_put(c);
-			goto free_cret_list;
-		}
-		cret_cnt++;
+	if (!n) {
+		free(list);
+		list = NULL;
 	}
+	*cret = list;
+	return n;
+}
 
-	assert(!nret || !cret || cret_cnt == ct_name_cnt);
-	ret = ct_name_cnt;
-	if (nret)
-		*nret = ct_name;
-	else
-		goto free_ct_name;
-	goto out;
+static int finish_list(const char *lxcpath, struct lxc_name_array *a,
+		       char ***names, struct lxc_container ***cret)
+{
+	int ret;
 
-free_cret_list:
-	if (cret && *cret) {
-		for (i = 0; i < cret_cnt; i++)
-			lxc_container_put((*cret)[i]);
-		free(*cret);
-	}
+	name_array_sort(a);
 
-free_ct_name:
-	if (ct_name) {
-		for (i = 0; i < ct_name_cnt; i++)
-			free(ct_name[i]);
-		free(ct_name);
+	if (cret && load_containers(lxcpath, a, cret) < 0) {
+		name_array_free(a);
+		return -1;
 	}
 
-out:
-	if (line)
-		free(line);
-
-	fclose(f);
+	ret = a->count;
+	if (names && a->count) {
+		*names = a->names;
+		a->names = NULL;
+		a->count = 0;
+	}
+	name_array_free(a);
 	return ret;
 }
 
-int list_all_containers(const char *lxcpath, char ***nret,
-			struct lxc_container ***cret)
+int list_defined_containers(const char *lxcpath, char ***names, struct lxc_container ***cret)
 {
-	int i, ret, active_cnt, ct_cnt, ct_list_cnt;
-	char **active_name;
-	char **ct_name;
-	struct lxc_container **ct_list = NULL;
+	struct lxc_name_array a = { NULL, 0, 0 };
 
-	ct_cnt = list_defined_containers(lxcpath, &ct_name, NULL);
-	if (ct_cnt < 0)
-		return ct_cnt;
+	if (!lxcpath)
+		lxcpath = lxc_global_config_value("lxc.lxcpath");
 
-	active_cnt = list_active_containers(lxcpath, &active_name, NULL);
-	if (active_cnt < 0) {
-		ret = active_cnt;
-		goto free_ct_name;
-	}
+	if (cret)
+		*cret = NULL;
+	if (names)
+		*names = NULL;
 
-	for (i = 0; i < active_cnt; i++) {
-		if (!array_contains(&ct_name, active_name[i], ct_cnt)) {
-			if (!add_to_array(&ct_name, active_name[i], ct_cnt)) {
-				ret = -1;
-				goto free_active_name;
-			}
-			ct_cnt++;
-		}
-		free(active_name[i]);
-		active_name[i] = NULL;
+	if (collect_defined_names(lxcpath, &a) < 0) {
+		name_array_free(&a);
+		return -1;
 	}
-	free(active_name);
-	active_name = NULL;
-	active_cnt = 0;
 
-	for (i = 0, ct_list_cnt = 0; i < ct_cnt && cret; i++) {
-		struct lxc_container *c;
+	return finish_list(lxcpath, &a, names, cret);
+}
 
-		c = lxc_container_new(ct_name[i], lxcpath);
-		if (!c) {
-			WARN("Container %s:%s could not be loaded", lxcpath, ct_name[i]);
-			remove_from_array(&ct_name, ct_name[i], ct_cnt--);
-			continue;
-		}
+int list_active_containers(const char *lxcpath, char ***nret,
+			   struct lxc_container ***cret)
+{
+	struct lxc_name_array a = { NULL, 0, 0 };
 
-		if (!add_to_clist(&ct_list, c, ct_list_cnt, false)) {
-			lxc_container_put(c);
-			ret = -1;
-			goto free_ct_list;
-		}
-		ct_list_cnt++;
-	}
+	if (!lxcpath)
+		lxcpath = lxc_global_config_value("lxc.lxcpath");
 
 	if (cret)
-		*cret = ct_list;
+		*cret = NULL;
+	if (nret)
+		*nret = NULL;
+
+	if (collect_active_names(lxcpath, &a) < 0) {
+		name_array_free(&a);
+		return -1;
+	}
+
+	/*
+	 * If this is an anonymous container, then is_defined *can*
+	 * return false.  So we don't do that check.  Count on the
+	 * fact that the command socket exists.
+	 */
+	return finish_list(lxcpath, &a, nret, cret);
+}
+
+int list_all_containers(const char *lxcpath, char ***nret,
+			struct lxc_container ***cret)
+{
+	struct lxc_name_array a = { NULL, 0, 0 };
+
+	if (!lxcpath)
+		lxcpath = lxc_global_config_value("lxc.lxcpath");
 
+	if (cret)
+		*cret = NULL;
 	if (nret)
-		*nret = ct_name;
-	else {
-		ret = ct_cnt;
-		goto free_ct_name;
+		*nret = NULL;
+
+	if (collect_defined_names(lxcpath, &a) < 0 ||
+	    collect_active_names(lxcpath, &a) < 0) {
+		name_array_free(&a);
+		return -1;
 	}
-	return ct_cnt;
 
-free_ct_list:
-	for (i = 0; i < ct_list_cnt; i++) {
-		lxc_container_put(ct_list[i]);
+	return finish_list(lxcpath, &a, nret, cret);
+}
+
+struct lxc_container_list {
+	char *lxcpath;
+	char **names;
+	struct lxc_container **containers;
+	int count;
+};
+
+struct lxc_container_list *lxc_container_list_new(const char *lxcpath, int flags)
+{
+	struct lxc_name_array a = { NULL, 0, 0 };
+	struct lxc_container_list *list;
+
+	if (!(flags & LXC_LIST_ALL))
+		return NULL;
+
+	if (!lxcpath)
+		lxcpath = lxc_global_config_value("lxc.lxcpath");
+
+	if ((flags & LXC_LIST_DEFINED) && collect_defined_names(lxcpath, &a) < 0)
+		goto err;
+	if ((flags & LXC_LIST_ACTIVE) && collect_active_names(lxcpath, &a) < 0)
+		goto err;
+	name_array_sort(&a);
+
+	list = malloc(sizeof(*list));
+	if (!list)
+		goto err;
+	list->lxcpath = strdup(lxcpath);
+	list->containers = calloc(a.count ? a.count : 1, sizeof(struct lxc_container *));
+	if (!list->lxcpath || !list->containers) {
+		free(list->lxcpath);
+		free(list->containers);
+		free(list);
+		goto err;
 	}
-	if (ct_list)
-		free(ct_list);
+	list->names = a.names;
+	list->count = a.count;
+	return list;
+
+err:
+	ERROR("Failed to list containers in %s", lxcpath);
+	name_array_free(&a);
+	return NULL;
+}
 
-free_active_name:
-	for (i = 0; i < active_cnt; i++) {
-		if (active_name[i])
-			free(active_name[i]);
+int lxc_container_list_count(struct lxc_container_list *list)
+{
+	return list ? list->count : -1;
+}
+
+const char *lxc_container_list_name(struct lxc_container_list *list, int idx)
+{
+	if (!list || idx < 0 || idx >= list->count)
+		return NULL;
+	return list->names[idx];
+}
+
+struct lxc_container *lxc_container_list_get(struct lxc_container_list *list, int idx)
+{
+	if (!list || idx < 0 || idx >= list->count)
+		return NULL;
+
+	if (!list->containers[idx]) {
+		list->containers[idx] = lxc_container_new(list->names[idx], list->lxcpath);
+		if (!list->containers[idx])
+			INFO("Container %s:%s could not be loaded",
+				list->lxcpath, list->names[idx]);
 	}
-	if (active_name)
-		free(active_name);
+	return list->containers[idx];
+}
+
+void lxc_container_list_free(struct lxc_container_list *list)
+{
+	int i;
 
-free_ct_name:
-	for (i = 0; i < ct_cnt; i++) {
-		free(ct_name[i]);
+	if (!list)
+		return;
+
+	for (i = 0; i < list->count; i++) {
+		if (list->containers[i])
+			lxc_container_put(list->containers[i]);
+		free(list->names[i]);
 	}
-	free(ct_name);
-	return ret;
+	free(list->names);
+	free(list->containers);
+	free(list->lxcpath);
+	free(list);
 }
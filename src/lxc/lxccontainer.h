@@ -47,8 +47,14 @@ struct bdev_specs;
 
 struct lxc_snapshot;
 
+struct lxc_cgroup_item;
+
 struct lxc_lock;
 
+struct lxc_cmd_conn;
+
+struct lxc_netns_info;
+
 /*!
  * An LXC container.
  */
@@ -740,6 +746,98 @@ struct lxc_container {
 	 * \return \c true on success, else \c false.
 	 */
 	bool (*remove_device_node)(struct lxc_container *c, const char *src_path, const char *dest_path);
+
+	/*!
+	 * \brief Retrieve the values of several cgroup subsystem files
+	 *  of the container at once.
+	 *
+	 * The container's cgroups are only looked up once for all
+	 * \p keys, which makes this much cheaper than calling
+	 * \ref get_cgroup_item for each of them.
+	 *
+	 * \param c Container.
+	 * \param keys \c NULL-terminated array of cgroup subsystem files
+	 *  (for example \c "memory.usage_in_bytes").
+	 * \param[out] items Dynamically-allocated array of items, one per
+	 *  key and in the same order as \p keys.
+	 *
+	 * \return Number of items in \p items, or \c -1 on error.
+	 *
+	 * \note The caller must call the \c free function of each
+	 *  item, and then free \p items itself.
+	 */
+	int (*get_cgroup_items)(struct lxc_container *c, const char **keys, struct lxc_cgroup_item **items);
+
+	/*!
+	 * \brief Start the container in the background, but stop just
+	 *  before exec'ing its init.
+	 *
+	 * The container is fully set up (namespaces, cgroups, network,
+	 * mounts, hooks) and stays in the \c PARKED state until
+	 * \ref unpark is called, which makes starting it mostly an exec.
+	 *
+	 * \param c Container.
+	 *
+	 * \return \c true once the container is parked, else \c false.
+	 */
+	bool (*park)(struct lxc_container *c);
+
+	/*!
+	 * \brief Run a command as the init of a parked container.
+	 *
+	 * \param c Container.
+	 * \param argv Command to run, \c NULL terminated.
+	 *
+	 * \return \c true on success, \c false on error or if the container
+	 *  is not parked.
+	 *
+	 * \note Should the container reboot, it runs \c /sbin/init.
+	 */
+	bool (*unpark)(struct lxc_container *c, char * const argv[]);
+
+	/*!
+	 * \brief Retrieve the last output of the container console.
+	 *
+	 * The output is kept in memory by the running container when
+	 * \c lxc.console.buffer.size is set, up to that many bytes.
+	 *
+	 * \param c Container.
+	 * \param clear Whether to empty the buffer once read.
+	 * \param[out] buf Dynamically-allocated console output, or \c NULL
+	 *  if there was none.
+	 *
+	 * \return Length of \p buf, or \c -1 on error.
+	 *
+	 * \note The caller must free \p buf.
+	 */
+	int (*console_log)(struct lxc_container *c, bool clear, char **buf);
+
+	/*!
+	 * \private
+	 * Connection to the command socket of the running container,
+	 * kept open across state queries.
+	 */
+	struct lxc_cmd_conn *cmd_conn;
+
+	/*!
+	 * \private
+	 * Cached links and addresses of the container network namespace.
+	 */
+	struct lxc_netns_info *netns_info;
+};
+
+/*!
+ * \brief A cgroup value as returned by \ref get_cgroup_items.
+ */
+struct lxc_cgroup_item {
+	char *key; /*!< cgroup subsystem file */
+	char *value; /*!< Full contents of the file (\c NULL if it could not be read) */
+
+	/*!
+	 * \brief De-allocate the item.
+	 * \param item cgroup item.
+	 */
+	void (*free)(struct lxc_cgroup_item *item);
 };
 
 /*!
@@ -865,6 +963,175 @@ int list_active_containers(const char *lxcpath, char ***names, struct lxc_contai
  */
 int list_all_containers(const char *lxcpath, char ***names, struct lxc_container ***cret);
 
+#define LXC_LIST_DEFINED 0x01 /*!< List containers which have a config file */
+#define LXC_LIST_ACTIVE  0x02 /*!< List containers which are running */
+#define LXC_LIST_ALL     (LXC_LIST_DEFINED|LXC_LIST_ACTIVE) /*!< List both */
+
+/*!
+ * \brief A sorted list of container names whose containers are loaded
+ *  on demand.
+ */
+struct lxc_container_list;
+
+/*!
+ * \brief List the containers in a lxcpath without loading them.
+ *
+ * \param lxcpath Full \c LXCPATH path to consider, or \c NULL for the default.
+ * \param flags Bitwise-OR of \c LXC_LIST_* flags.
+ *
+ * \return Newly-allocated list, or \c NULL on error.
+ *
+ * \note Only the container names are read; each container's configuration
+ *  is loaded the first time it is requested with \ref lxc_container_list_get.
+ * \note A list must not be used by several threads at once.
+ */
+struct lxc_container_list *lxc_container_list_new(const char *lxcpath, int flags);
+
+/*!
+ * \brief Number of containers in a list.
+ *
+ * \param list Container list.
+ *
+ * \return Number of containers, or \c -1 on error.
+ */
+int lxc_container_list_count(struct lxc_container_list *list);
+
+/*!
+ * \brief Name of a container in a list.
+ *
+ * \param list Container list.
+ * \param idx Index of the container, the list being sorted by name.
+ *
+ * \return Container name, or \c NULL if \p idx is out of range.
+ *
+ * \note The returned string must not be freed.
+ */
+const char *lxc_container_list_name(struct lxc_container_list *list, int idx);
+
+/*!
+ * \brief Get a container from a list, loading it on first access.
+ *
+ * \param list Container list.
+ * \param idx Index of the container.
+ *
+ * \return Container, or \c NULL if it could not be loaded.
+ *
+ * \note The reference belongs to the list; call \ref lxc_container_get to
+ *  keep the container after \ref lxc_container_list_free.
+ */
+struct lxc_container *lxc_container_list_get(struct lxc_container_list *list, int idx);
+
+/*!
+ * \brief Free a container list and drop its container references.
+ *
+ * \param list Container list.
+ */
+void lxc_container_list_free(struct lxc_container_list *list);
+
+/*!
+ * \brief Freeze several containers in parallel.
+ *
+ * All containers are asked to freeze before waiting for any of them,
+ * so the total time is that of the slowest container rather than the
+ * sum over all containers.
+ *
+ * \param containers Array of containers.
+ * \param count Number of containers in \p containers.
+ * \param timeout Seconds to wait for the containers to freeze, or
+ *  \c -1 to wait forever.
+ *
+ * \return Number of containers which were frozen, or \c -1 on error.
+ */
+int lxc_freeze_containers(struct lxc_container **containers, int count, int timeout);
+
+/*!
+ * \brief Unfreeze several containers in parallel.
+ *
+ * \param containers Array of containers.
+ * \param count Number of containers in \p containers.
+ * \param timeout Seconds to wait for the containers to thaw, or
+ *  \c -1 to wait forever.
+ *
+ * \return Number of containers which were thawed, or \c -1 on error.
+ */
+int lxc_unfreeze_containers(struct lxc_container **containers, int count, int timeout);
+
+/*!
+ * \brief Shut down several containers in parallel.
+ *
+ * The halt signal of every container is sent at once, then their
+ * \c STOPPED states are awaited together until a single deadline, after
+ * which the containers still running are stopped as with \c stop().
+ * The total time is thus bounded by \p timeout whatever the number of
+ * containers.
+ *
+ * \param containers Array of containers.
+ * \param count Number of containers in \p containers.
+ * \param timeout Seconds to wait for the containers to shut down
+ *  before stopping them, or \c -1 to wait forever.
+ *
+ * \return Number of containers which shut down cleanly, or \c -1 on
+ *  error.
+ */
+int lxc_shutdown_containers(struct lxc_container **containers, int count, int timeout);
+
+/*!
+ * \brief Keep a pool of parked copies of a container.
+ *
+ * Makes sure the clones \c <name>-pool-0 to \c <name>-pool-<count - 1>
+ * of \p tmpl exist, cloning them with \p flags if needed, and parks
+ * those which are not running.
+ *
+ * \param tmpl Template container.
+ * \param count Size of the pool.
+ * \param flags \c LXC_CLONE_* flags used to create missing clones.
+ *
+ * \return Number of parked containers in the pool, or \c -1 on error.
+ */
+int lxc_pool_fill(struct lxc_container *tmpl, int count, int flags);
+
+/*!
+ * \brief Start a command in a parked container of a pool.
+ *
+ * \param tmpl Template container given to \ref lxc_pool_fill.
+ * \param argv Command to run as the container's init, \c NULL
+ *  terminated.
+ *
+ * \return The container running \p argv, or \c NULL if none of the
+ *  pool is parked.
+ *
+ * \note The caller must call \ref lxc_container_put on the returned
+ *  container.  It leaves the pool until the next \ref lxc_pool_fill
+ *  after it has stopped.
+ */
+struct lxc_container *lxc_pool_claim(struct lxc_container *tmpl, char *const argv[]);
+
+/*!
+ * \brief Serve container states for a lxcpath from memory.
+ *
+ * Starts a thread which follows the state changes reported by the
+ * monitor for \p lxcpath, so that \c state(), \c is_running() and
+ * related calls on its containers need no round trip to the containers.
+ *
+ * \param lxcpath lxcpath to cache states for, or \c NULL for the default.
+ * \param max_age Milliseconds a state is trusted after the last message
+ *  about it, after which it is queried again; \c -1 trusts the monitor
+ *  forever.
+ *
+ * \return \c true on success, else \c false.
+ *
+ * \note States changed without going through liblxc, such as a freezer
+ *  cgroup written by hand, are only seen once \p max_age has passed.
+ */
+bool lxc_state_cache_enable(const char *lxcpath, int max_age);
+
+/*!
+ * \brief Stop serving container states for a lxcpath from memory.
+ *
+ * \param lxcpath lxcpath passed to \ref lxc_state_cache_enable.
+ */
+void lxc_state_cache_disable(const char *lxcpath);
+
 /*!
  * \brief Close log file.
  */
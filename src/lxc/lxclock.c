@@ -27,6 +27,8 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
 
 #include <lxc/lxccontainer.h>
 
@@ -42,6 +44,10 @@
 #define SEMVALUE 1
 #define SEMVALUE_LOCKED 0
 
+/* interval between two tries to take a flock lock with a timeout */
+#define FLOCK_RETRY_MIN_MS 1
+#define FLOCK_RETRY_MAX_MS 100
+
 lxc_log_define(lxc_lock, lxc);
 
 #ifdef MUTEX_DEBUGGING
@@ -174,6 +180,48 @@ static sem_t *lxc_new_unnamed_sem(void)
 	return s;
 }
 
+static pthread_rwlock_t *lxc_new_rwlock(void)
+{
+	pthread_rwlockattr_t attr;
+	pthread_rwlock_t *rw;
+	int ret;
+
+	rw = malloc(sizeof(*rw));
+	if (!rw)
+		return NULL;
+	if (pthread_rwlockattr_init(&attr)) {
+		free(rw);
+		return NULL;
+	}
+	/* don't let a steady stream of readers starve the writers */
+	pthread_rwlockattr_setkind_np(&attr,
+			PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	ret = pthread_rwlock_init(rw, &attr);
+	pthread_rwlockattr_destroy(&attr);
+	if (ret) {
+		free(rw);
+		return NULL;
+	}
+	return rw;
+}
+
+struct lxc_lock *lxc_newrwlock(void)
+{
+	struct lxc_lock *l;
+
+	l = malloc(sizeof(*l));
+	if (!l)
+		return NULL;
+
+	l->type = LXC_LOCK_RWLOCK;
+	l->u.rw = lxc_new_rwlock();
+	if (!l->u.rw) {
+		free(l);
+		return NULL;
+	}
+	return l;
+}
+
 struct lxc_lock *lxc_newlock(const char *lxcpath, const char *name)
 {
 	struct lxc_lock *l;
@@ -200,16 +248,76 @@ struct lxc_lock *lxc_newlock(const char *lxcpath, const char *name)
 		goto out;
 	}
 	l->u.f.fd = -1;
+	l->u.f.readers = 0;
 
 out:
 	return l;
 }
 
-int lxclock(struct lxc_lock *l, int timeout)
+static int lxc_rwlock_lock(pthread_rwlock_t *rw, bool shared, int timeout)
 {
-	int ret = -1, saved_errno = errno;
+	struct timespec ts;
+	int ret;
+
+	if (!timeout) {
+		ret = shared ? pthread_rwlock_rdlock(rw) : pthread_rwlock_wrlock(rw);
+	} else {
+		if (clock_gettime(CLOCK_REALTIME, &ts) == -1)
+			return -2;
+		ts.tv_sec += timeout;
+		ret = shared ? pthread_rwlock_timedrdlock(rw, &ts) :
+			       pthread_rwlock_timedwrlock(rw, &ts);
+	}
+	if (ret) {
+		errno = ret;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Take a fcntl lock of the given type on the whole of fd.  F_SETLKW can't
+ * be given a timeout, so with one we retry F_SETLK, backing off from
+ * FLOCK_RETRY_MIN_MS to FLOCK_RETRY_MAX_MS between tries.
+ */
+static int lxc_fcntl_lock(int fd, short type, int timeout)
+{
+	struct timespec now, deadline;
+	long left, delay = FLOCK_RETRY_MIN_MS;
 	struct flock lk;
 
+	lk.l_type = type;
+	lk.l_whence = SEEK_SET;
+	lk.l_start = 0;
+	lk.l_len = 0;
+	if (!timeout)
+		return fcntl(fd, F_SETLKW, &lk);
+
+	if (clock_gettime(CLOCK_MONOTONIC, &deadline) == -1)
+		return -2;
+	deadline.tv_sec += timeout;
+	for (;;) {
+		if (fcntl(fd, F_SETLK, &lk) == 0)
+			return 0;
+		if (errno != EACCES && errno != EAGAIN)
+			return -1;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		left = (deadline.tv_sec - now.tv_sec) * 1000 +
+		       (deadline.tv_nsec - now.tv_nsec) / 1000000;
+		if (left <= 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		usleep((delay < left ? delay : left) * 1000);
+		if (delay < FLOCK_RETRY_MAX_MS)
+			delay *= 2;
+	}
+}
+
+static int lxclock_take(struct lxc_lock *l, int timeout, bool shared)
+{
+	int ret = -1, saved_errno = errno;
+
 	switch(l->type) {
 	case LXC_LOCK_ANON_SEM:
 		if (!timeout) {
@@ -228,33 +336,46 @@ int lxclock(struct lxc_lock *l, int timeout)
 				saved_errno = errno;
 		}
 		break;
+	case LXC_LOCK_RWLOCK:
+		ret = lxc_rwlock_lock(l->u.rw, shared, timeout);
+		if (ret == -1)
+			saved_errno = errno;
+		break;
 	case LXC_LOCK_FLOCK:
-		ret = -2;
-		if (timeout) {
-			ERROR("Error: timeout not supported with flock");
-			ret = -2;
-			goto out;
-		}
 		if (!l->u.f.fname) {
 			ERROR("Error: filename not set for flock");
 			ret = -2;
 			goto out;
 		}
+		/*
+		 * Threads sharing a read lock share its fd, which has to stay
+		 * open until the last of them is done, as closing any fd on
+		 * the file drops the locks of the whole process.
+		 */
+		if (shared) {
+			process_lock();
+			l->u.f.readers++;
+		}
 		if (l->u.f.fd == -1) {
 			l->u.f.fd = open(l->u.f.fname, O_RDWR|O_CREAT,
 					S_IWUSR | S_IRUSR);
 			if (l->u.f.fd == -1) {
 				ERROR("Error opening %s", l->u.f.fname);
+				if (shared) {
+					l->u.f.readers--;
+					process_unlock();
+				}
 				goto out;
 			}
 		}
-		lk.l_type = F_WRLCK;
-		lk.l_whence = SEEK_SET;
-		lk.l_start = 0;
-		lk.l_len = 0;
-		ret = fcntl(l->u.f.fd, F_SETLKW, &lk);
+		if (shared)
+			process_unlock();
+		ret = lxc_fcntl_lock(l->u.f.fd, shared ? F_RDLCK : F_WRLCK,
+				     timeout);
 		if (ret == -1)
 			saved_errno = errno;
+		if (ret && shared)
+			lxcunlock(l);
 		break;
 	}
 
@@ -263,6 +384,16 @@ out:
 	return ret;
 }
 
+int lxclock(struct lxc_lock *l, int timeout)
+{
+	return lxclock_take(l, timeout, false);
+}
+
+int lxclock_shared(struct lxc_lock *l, int timeout)
+{
+	return lxclock_take(l, timeout, true);
+}
+
 int lxcunlock(struct lxc_lock *l)
 {
 	int ret = 0, saved_errno = errno;
@@ -277,8 +408,18 @@ int lxcunlock(struct lxc_lock *l)
 			saved_errno = errno;
 		}
 		break;
+	case LXC_LOCK_RWLOCK:
+		ret = pthread_rwlock_unlock(l->u.rw);
+		if (ret) {
+			saved_errno = ret;
+			ret = -1;
+		}
+		break;
 	case LXC_LOCK_FLOCK:
-		if (l->u.f.fd != -1) {
+		process_lock();
+		if (l->u.f.readers > 0 && --l->u.f.readers > 0) {
+			/* other threads still hold the read lock */
+		} else if (l->u.f.fd != -1) {
 			lk.l_type = F_UNLCK;
 			lk.l_whence = SEEK_SET;
 			lk.l_start = 0;
@@ -290,6 +431,7 @@ int lxcunlock(struct lxc_lock *l)
 			l->u.f.fd = -1;
 		} else
 			ret = -2;
+		process_unlock();
 		break;
 	}
 
@@ -316,6 +458,13 @@ void lxc_putlock(struct lxc_lock *l)
 			l->u.sem = NULL;
 		}
 		break;
+	case LXC_LOCK_RWLOCK:
+		if (l->u.rw) {
+			pthread_rwlock_destroy(l->u.rw);
+			free(l->u.rw);
+			l->u.rw = NULL;
+		}
+		break;
 	case LXC_LOCK_FLOCK:
 		if (l->u.f.fd != -1) {
 			close(l->u.f.fd);
@@ -362,6 +511,11 @@ int container_mem_lock(struct lxc_container *c)
 	return lxclock(c->privlock, 0);
 }
 
+int container_mem_lock_shared(struct lxc_container *c)
+{
+	return lxclock_shared(c->privlock, 0);
+}
+
 void container_mem_unlock(struct lxc_container *c)
 {
 	lxcunlock(c->privlock);
@@ -380,6 +534,19 @@ int container_disk_lock(struct lxc_container *c)
 	return 0;
 }
 
+int container_disk_lock_shared(struct lxc_container *c)
+{
+	int ret;
+
+	if ((ret = lxclock_shared(c->privlock, 0)))
+		return ret;
+	if ((ret = lxclock_shared(c->slock, 0))) {
+		lxcunlock(c->privlock);
+		return ret;
+	}
+	return 0;
+}
+
 void container_disk_unlock(struct lxc_container *c)
 {
 	lxcunlock(c->slock);
@@ -27,11 +27,13 @@
 #include <sys/stat.h>        /* For mode constants */
 #include <sys/file.h>
 #include <semaphore.h>
+#include <pthread.h>
 #include <string.h>
 #include <time.h>
 
 #define LXC_LOCK_ANON_SEM 1 /*!< Anonymous semaphore lock */
 #define LXC_LOCK_FLOCK    2 /*!< flock(2) lock */
+#define LXC_LOCK_RWLOCK   3 /*!< Anonymous reader/writer lock */
 
 // private
 /*!
@@ -42,10 +44,12 @@ struct lxc_lock {
 
 	union {
 		sem_t *sem; //!< Anonymous semaphore (LXC_LOCK_ANON_SEM)
+		pthread_rwlock_t *rw; //!< Reader/writer lock (LXC_LOCK_RWLOCK)
 		/*! LXC_LOCK_FLOCK details */
 		struct {
 			int   fd; //!< fd on which a lock is held (if not -1)
 			char *fname; //!< Name of lock
+			int   readers; //!< Threads holding or waiting for a shared lock
 		} f;
 	} u; //!< Container for lock type elements
 };
@@ -79,6 +83,17 @@ struct lxc_lock {
  */
 extern struct lxc_lock *lxc_newlock(const char *lxcpath, const char *name);
 
+/*!
+ * \brief Create a new (unlocked) reader/writer lock.
+ *
+ * \return Newly-allocated lxclock on success, \c NULL on failure.
+ *
+ * \note Like an unnamed semaphore, it protects against racing threads,
+ *  but it can be held by several readers at once, see \ref lxclock_shared().
+ *  Waiting writers are served before new readers.
+ */
+extern struct lxc_lock *lxc_newrwlock(void);
+
 /*!
  * \brief Take an existing lock.
  *
@@ -87,15 +102,29 @@ extern struct lxc_lock *lxc_newlock(const char *lxcpath, const char *name);
  * indefinite wait).
  *
  * \return \c 0 if lock obtained, \c -2 on failure to set timeout,
- *  or \c -1 on any other error (\c errno will be set by \c sem_wait(3)).
+ *  or \c -1 on any other error (\c errno will be set by \c sem_wait(3),
+ *  \c fcntl(2) or the pthread rwlock functions, and is \c ETIMEDOUT if
+ *  \p timeout expired).
  *
- * \note \p timeout is (currently?) only supported for privlock, not
- * for slock.  Since currently there is not a single use of the timeout
- * (except in the test case) I may remove the support for it in sem as
- * well.
+ * \note A flock lock with a \p timeout is polled for, so it may be
+ *  taken up to a few tenths of a second after it was released.
  */
 extern int lxclock(struct lxc_lock *lock, int timeout);
 
+/*!
+ * \brief Take an existing lock, shared with other readers.
+ *
+ * \param lock Lock to operate on.
+ * \param timeout As for \ref lxclock().
+ *
+ * \return As for \ref lxclock().
+ *
+ * \note A flock lock is taken as a \c F_RDLCK, which excludes only
+ *  \ref lxclock() holders.  An unnamed semaphore cannot be shared, it
+ *  is taken as by \ref lxclock().
+ */
+extern int lxclock_shared(struct lxc_lock *lock, int timeout);
+
 /*!
  * \brief Unlock specified lock previously locked using \ref lxclock().
  *
@@ -134,10 +163,21 @@ struct lxc_container;
  */
 extern int container_mem_lock(struct lxc_container *c);
 
+/*!
+ * \brief Lock the containers memory for reading only.
+ *
+ * \param c Container.
+ *
+ * \return As for \ref lxclock().
+ */
+extern int container_mem_lock_shared(struct lxc_container *c);
+
 /*!
  * \brief Unlock the containers memory.
  *
  * \param c Container.
+ *
+ * \note Releases both exclusive and shared locks.
  */
 extern void container_mem_unlock(struct lxc_container *c);
 
@@ -151,8 +191,22 @@ extern void container_mem_unlock(struct lxc_container *c);
  */
 extern int container_disk_lock(struct lxc_container *c);
 
+/*!
+ * \brief Lock the containers disk data for reading only.
+ *
+ * \param c Container.
+ *
+ * \return \c 0 on success, or an \ref lxclock() error return
+ * values on error.
+ *
+ * \note Readers in other processes are let in, writers are kept out.
+ */
+extern int container_disk_lock_shared(struct lxc_container *c);
+
 /*!
  * \brief Unlock the containers disk data.
+ *
+ * \note Releases both exclusive and shared locks.
  */
 extern void container_disk_unlock(struct lxc_container *c);
 
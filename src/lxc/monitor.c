@@ -31,8 +31,12 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdint.h>
+#include <dirent.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/file.h>
 #include <sys/param.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
@@ -84,6 +88,158 @@ int lxc_monitor_fifo_name(const char *lxcpath, char *fifo_path, size_t fifo_path
 	return 0;
 }
 
+/*
+ * Registry of running containers: every container started under @lxcpath
+ * owns an entry named after it in $rundir/lxc/$lxcpath/running, holding an
+ * exclusive flock on it for as long as it runs.  Listing the running
+ * containers is then a single readdir() rather than a scan of every unix
+ * socket on the host.  An entry whose lock can be taken belongs to a
+ * container which died without cleaning up, and is removed by the reader.
+ */
+int lxc_running_dir(const char *lxcpath, char *path, size_t path_sz,
+		    int do_mkdirp)
+{
+	int ret;
+	char *rundir;
+
+	rundir = get_rundir();
+	if (!rundir)
+		return -1;
+
+	ret = snprintf(path, path_sz, "%s/lxc/%s/running", rundir, lxcpath);
+	free(rundir);
+	if (ret < 0 || ret >= path_sz) {
+		ERROR("rundir/lxcpath (%s) too long for running registry", lxcpath);
+		return -1;
+	}
+
+	if (do_mkdirp) {
+		ret = mkdir_p(path, 0755);
+		if (ret < 0) {
+			ERROR("unable to create running registry dir %s", path);
+			return ret;
+		}
+	}
+	return 0;
+}
+
+int lxc_running_register(const char *name, const char *lxcpath)
+{
+	char dir[PATH_MAX], tmp[PATH_MAX], path[PATH_MAX];
+	int fd, ret;
+
+	if (lxc_running_dir(lxcpath, dir, sizeof(dir), 1) < 0)
+		return -1;
+
+	ret = snprintf(path, sizeof(path), "%s/%s", dir, name);
+	if (ret < 0 || ret >= sizeof(path))
+		return -1;
+	ret = snprintf(tmp, sizeof(tmp), "%s/.%s.%d", dir, name, getpid());
+	if (ret < 0 || ret >= sizeof(tmp))
+		return -1;
+
+	/*
+	 * Lock the entry before it becomes visible, otherwise a reader
+	 * could find it unlocked and remove it as stale.
+	 */
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		SYSERROR("failed to create %s", tmp);
+		return -1;
+	}
+	if (flock(fd, LOCK_EX) < 0 || rename(tmp, path) < 0) {
+		SYSERROR("failed to register %s as running", name);
+		unlink(tmp);
+		close(fd);
+		return -1;
+	}
+
+	dprintf(fd, "%d\n", getpid());
+	return fd;
+}
+
+void lxc_running_unregister(const char *name, const char *lxcpath, int fd)
+{
+	char dir[PATH_MAX], path[PATH_MAX];
+	int ret;
+
+	if (fd < 0)
+		return;
+
+	/* unlink before dropping the lock so no reader sees a stale entry */
+	if (lxc_running_dir(lxcpath, dir, sizeof(dir), 0) == 0) {
+		ret = snprintf(path, sizeof(path), "%s/%s", dir, name);
+		if (ret > 0 && ret < sizeof(path))
+			unlink(path);
+	}
+	close(fd);
+}
+
+/* Returns true if the registry entry @name in @dfd is held by a container. */
+static bool lxc_running_check(int dfd, const char *name)
+{
+	struct stat st1, st2;
+	int fd;
+
+	fd = openat(dfd, name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	if (flock(fd, LOCK_SH | LOCK_NB) < 0) {
+		close(fd);
+		return errno == EWOULDBLOCK;
+	}
+
+	/*
+	 * Nobody holds the entry, its container went away.  Only remove
+	 * it if it was not replaced by a container starting meanwhile.
+	 */
+	if (fstat(fd, &st1) == 0 && fstatat(dfd, name, &st2, 0) == 0 &&
+	    st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino) {
+		INFO("removing stale running entry for %s", name);
+		unlinkat(dfd, name, 0);
+	}
+	close(fd);
+	return false;
+}
+
+int lxc_running_list(const char *lxcpath,
+		     bool (*cb)(const char *name, void *data), void *data)
+{
+	char path[PATH_MAX];
+	struct dirent dirent, *direntp;
+	DIR *dir;
+	int count = 0;
+
+	if (lxc_running_dir(lxcpath, path, sizeof(path), 0) < 0)
+		return -1;
+
+	dir = opendir(path);
+	if (!dir)
+		return -1;
+
+	while (!readdir_r(dir, &dirent, &direntp)) {
+		if (!direntp)
+			break;
+
+		/* skips ".", ".." and entries still being registered */
+		if (direntp->d_name[0] == '.')
+			continue;
+
+		if (!lxc_running_check(dirfd(dir), direntp->d_name))
+			continue;
+
+		if (!cb(direntp->d_name, data)) {
+			count = -1;
+			break;
+		}
+		count++;
+	}
+
+	closedir(dir);
+	return count;
+}
+
 static void lxc_monitor_fifo_send(struct lxc_msg *msg, const char *lxcpath)
 {
 	int fd,ret;
@@ -237,12 +393,118 @@ int lxc_monitor_read_fdset(fd_set *rfds, int nfds, struct lxc_msg *msg,
 
 int lxc_monitor_read_timeout(int fd, struct lxc_msg *msg, int timeout)
 {
-	fd_set rfds;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int ret;
+
+	/* poll() rather than select(), fd may be above FD_SETSIZE */
+	ret = poll(&pfd, 1, timeout == -1 ? -1 : timeout * 1000);
+	if (ret == -1)
+		return -1;
+	else if (ret == 0)
+		return -2;  // timed out
+
+	ret = recv(fd, msg, sizeof(*msg), 0);
+	if (ret <= 0) {
+		SYSERROR("client failed to recv (monitord died?) %s",
+			 strerror(errno));
+		return -1;
+	}
+	return ret;
+}
+
+int lxc_monitor_epoll_create(void)
+{
+	return epoll_create1(EPOLL_CLOEXEC);
+}
+
+int lxc_monitor_epoll_add(int epfd, const char *lxcpath)
+{
+	struct epoll_event ev;
+	int fd;
+
+	if (lxc_monitord_spawn(lxcpath))
+		return -1;
 
-	FD_ZERO(&rfds);
-	FD_SET(fd, &rfds);
+	fd = lxc_monitor_open(lxcpath);
+	if (fd < 0)
+		return -1;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		SYSERROR("failed to watch the monitor for %s", lxcpath);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Read as many whole messages as are queued on @fd, up to @nmsgs, with a
+ * single recv() in the common case.
+ */
+static int lxc_monitor_drain(int fd, struct lxc_msg *msgs, int nmsgs)
+{
+	ssize_t ret, rest;
+
+	ret = recv(fd, msgs, nmsgs * sizeof(*msgs), MSG_DONTWAIT);
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return 0;
+	if (ret <= 0)
+		return -1;
+
+	/* the end of the last message is on its way */
+	rest = ret % sizeof(*msgs);
+	if (rest) {
+		rest = sizeof(*msgs) - rest;
+		if (recv(fd, (char *)msgs + ret, rest, MSG_WAITALL) != rest)
+			return -1;
+		ret += rest;
+	}
+	return ret / sizeof(*msgs);
+}
+
+#define MONITOR_EPOLL_EVENTS 32
+
+int lxc_monitor_read_epoll(int epfd, struct lxc_msg *msgs, int *fds,
+			   int nmsgs, int timeout)
+{
+	struct epoll_event events[MONITOR_EPOLL_EVENTS];
+	int i, j, n, ret, count = 0;
+
+	if (nmsgs <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	n = epoll_wait(epfd, events,
+		       nmsgs < MONITOR_EPOLL_EVENTS ? nmsgs : MONITOR_EPOLL_EVENTS,
+		       timeout);
+	if (n == -1)
+		return -1;
+	else if (n == 0)
+		return -2;  // timed out
+
+	/* monitors we could not drain fully stay ready for the next call */
+	for (i = 0; i < n && count < nmsgs; i++) {
+		ret = lxc_monitor_drain(events[i].data.fd, msgs + count,
+					nmsgs - count);
+		if (ret < 0) {
+			/* report it on the next call, with nothing else to return */
+			if (count)
+				break;
+			SYSERROR("client failed to recv (monitord died?) %s",
+				 strerror(errno));
+			return -1;
+		}
+		if (fds)
+			for (j = 0; j < ret; j++)
+				fds[count + j] = events[i].data.fd;
+		count += ret;
+	}
 
-	return lxc_monitor_read_fdset(&rfds, fd+1, msg, timeout);
+	return count;
 }
 
 int lxc_monitor_read(int fd, struct lxc_msg *msg)
@@ -24,6 +24,7 @@
 #define __monitor_h
 
 #include <limits.h>
+#include <stdbool.h>
 #include <sys/param.h>
 #include <sys/un.h>
 
@@ -48,4 +49,17 @@ extern void lxc_monitor_send_state(const char *name, lxc_state_t state,
 			    const char *lxcpath);
 extern int lxc_monitord_spawn(const char *lxcpath);
 
+/*
+ * Registry of running containers under the rundir.  lxc_running_register
+ * returns a locked fd which must be kept open while the container runs,
+ * lxc_running_list calls @cb for each running container and returns their
+ * number, or -1 if there is no registry for @lxcpath.
+ */
+extern int lxc_running_dir(const char *lxcpath, char *path, size_t path_sz,
+			   int do_mkdirp);
+extern int lxc_running_register(const char *name, const char *lxcpath);
+extern void lxc_running_unregister(const char *name, const char *lxcpath, int fd);
+extern int lxc_running_list(const char *lxcpath,
+			    bool (*cb)(const char *name, void *data), void *data);
+
 #endif
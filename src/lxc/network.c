@@ -31,6 +31,10 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <time.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
@@ -48,6 +52,7 @@
 #include "nl.h"
 #include "network.h"
 #include "conf.h"
+#include "utils.h"
 
 #if HAVE_IFADDRS_H
 #include <ifaddrs.h>
@@ -87,6 +92,21 @@
 # define IFLA_MACVLAN_MODE 1
 #endif
 
+#ifndef IFLA_IPVLAN_MODE
+# define IFLA_IPVLAN_MODE 1
+#endif
+
+#ifndef IFLA_NUM_TX_QUEUES
+# define IFLA_NUM_TX_QUEUES 31
+#endif
+
+#ifndef IFLA_NUM_RX_QUEUES
+# define IFLA_NUM_RX_QUEUES 32
+#endif
+
+/* enough for the cpu masks of sysfs on any machine we run on */
+#define CPUMASK_WORDS 128
+
 struct link_req {
 	struct nlmsg nlmsg;
 	struct ifinfomsg ifinfomsg;
@@ -128,7 +148,7 @@ int lxc_netdev_move_by_index(int ifindex, pid_t pid)
 	if (nla_put_u32(nlmsg, IFLA_NET_NS_PID, pid))
 		goto out;
 
-	err = netlink_transaction(&nlh, nlmsg, nlmsg);
+	err = netlink_queue(&nlh, nlmsg, nlmsg);
 out:
 	netlink_close(&nlh);
 	nlmsg_free(nlmsg);
@@ -289,7 +309,7 @@ int netdev_set_flag(const char *name, int flag)
 	nlmsg->nlmsghdr.nlmsg_flags = NLM_F_REQUEST|NLM_F_ACK;
 	nlmsg->nlmsghdr.nlmsg_type = RTM_NEWLINK;
 
-	err = netlink_transaction(&nlh, nlmsg, answer);
+	err = netlink_queue(&nlh, nlmsg, answer);
 out:
 	netlink_close(&nlh);
 	nlmsg_free(nlmsg);
@@ -447,7 +467,7 @@ int lxc_netdev_set_mtu(const char *name, int mtu)
 	if (nla_put_u32(nlmsg, IFLA_MTU, mtu))
 		goto out;
 
-	err = netlink_transaction(&nlh, nlmsg, answer);
+	err = netlink_queue(&nlh, nlmsg, answer);
 out:
 	netlink_close(&nlh);
 	nlmsg_free(nlmsg);
@@ -466,6 +486,21 @@ int lxc_netdev_down(const char *name)
 }
 
 int lxc_veth_create(const char *name1, const char *name2)
+{
+	return lxc_veth_create_mq(name1, name2, 0, 0);
+}
+
+static int put_queues(struct nlmsg *nlmsg, int txqueues, int rxqueues)
+{
+	if (txqueues && nla_put_u32(nlmsg, IFLA_NUM_TX_QUEUES, txqueues))
+		return -1;
+	if (rxqueues && nla_put_u32(nlmsg, IFLA_NUM_RX_QUEUES, rxqueues))
+		return -1;
+	return 0;
+}
+
+int lxc_veth_create_mq(const char *name1, const char *name2,
+		       int txqueues, int rxqueues)
 {
 	struct nl_handler nlh;
 	struct nlmsg *nlmsg = NULL, *answer = NULL;
@@ -523,6 +558,10 @@ int lxc_veth_create(const char *name1, const char *name2)
 	if (nla_put_string(nlmsg, IFLA_IFNAME, name2))
 		goto out;
 
+	/* both ends get the same queues */
+	if (put_queues(nlmsg, txqueues, rxqueues))
+		goto out;
+
 	nla_end_nested(nlmsg, nest3);
 
 	nla_end_nested(nlmsg, nest2);
@@ -532,6 +571,9 @@ int lxc_veth_create(const char *name1, const char *name2)
 	if (nla_put_string(nlmsg, IFLA_IFNAME, name1))
 		goto out;
 
+	if (put_queues(nlmsg, txqueues, rxqueues))
+		goto out;
+
 	err = netlink_transaction(&nlh, nlmsg, answer);
 out:
 	netlink_close(&nlh);
@@ -693,6 +735,81 @@ out:
 	return err;
 }
 
+int lxc_ipvlan_create(const char *master, const char *name, int mode)
+{
+	struct nl_handler nlh;
+	struct nlmsg *nlmsg = NULL, *answer = NULL;
+	struct link_req *link_req;
+	struct rtattr *nest, *nest2;
+	int index, len, err;
+
+	err = netlink_open(&nlh, NETLINK_ROUTE);
+	if (err)
+		return err;
+
+	err = -EINVAL;
+	len = strlen(master);
+	if (len == 1 || len >= IFNAMSIZ)
+		goto out;
+
+	len = strlen(name);
+	if (len == 1 || len >= IFNAMSIZ)
+		goto out;
+
+	err = -ENOMEM;
+	nlmsg = nlmsg_alloc(NLMSG_GOOD_SIZE);
+	if (!nlmsg)
+		goto out;
+
+	answer = nlmsg_alloc(NLMSG_GOOD_SIZE);
+	if (!answer)
+		goto out;
+
+	err = -EINVAL;
+	index = if_nametoindex(master);
+	if (!index)
+		goto out;
+
+	link_req = (struct link_req *)nlmsg;
+	link_req->ifinfomsg.ifi_family = AF_UNSPEC;
+	nlmsg->nlmsghdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	nlmsg->nlmsghdr.nlmsg_flags =
+		NLM_F_REQUEST|NLM_F_CREATE|NLM_F_EXCL|NLM_F_ACK;
+	nlmsg->nlmsghdr.nlmsg_type = RTM_NEWLINK;
+
+	nest = nla_begin_nested(nlmsg, IFLA_LINKINFO);
+	if (!nest)
+		goto out;
+
+	if (nla_put_string(nlmsg, IFLA_INFO_KIND, "ipvlan"))
+		goto out;
+
+	/* unlike the macvlan modes, l2 is 0 and has to be sent */
+	nest2 = nla_begin_nested(nlmsg, IFLA_INFO_DATA);
+	if (!nest2)
+		goto out;
+
+	if (nla_put_u16(nlmsg, IFLA_IPVLAN_MODE, mode))
+		goto out;
+
+	nla_end_nested(nlmsg, nest2);
+
+	nla_end_nested(nlmsg, nest);
+
+	if (nla_put_u32(nlmsg, IFLA_LINK, index))
+		goto out;
+
+	if (nla_put_string(nlmsg, IFLA_IFNAME, name))
+		goto out;
+
+	err = netlink_transaction(&nlh, nlmsg, answer);
+out:
+	netlink_close(&nlh);
+	nlmsg_free(answer);
+	nlmsg_free(nlmsg);
+	return err;
+}
+
 static int proc_sys_net_write(const char *path, const char *value)
 {
 	int fd, err = 0;
@@ -761,6 +878,123 @@ int lxc_neigh_proxy_off(const char *name, int family)
 	return neigh_proxy_set(name, family, 0);
 }
 
+/*
+ * Parse a cpu list, as found in cpuset.cpus, into @mask.  Returns the
+ * number of cpus in the list, < 0 if it is invalid
+ */
+static int cpulist_parse(const char *list, uint32_t *mask)
+{
+	const char *p = list;
+	char *endp;
+	long first, last, cpu;
+	int count = 0;
+
+	memset(mask, 0, CPUMASK_WORDS * sizeof(*mask));
+	while (*p) {
+		first = strtol(p, &endp, 10);
+		if (endp == p || first < 0)
+			return -EINVAL;
+		last = first;
+		p = endp;
+		if (*p == '-') {
+			last = strtol(++p, &endp, 10);
+			if (endp == p || last < first)
+				return -EINVAL;
+			p = endp;
+		}
+		if (last >= CPUMASK_WORDS * 32)
+			return -E2BIG;
+		for (cpu = first; cpu <= last; cpu++) {
+			if (!(mask[cpu / 32] & (1U << (cpu % 32))))
+				count++;
+			mask[cpu / 32] |= 1U << (cpu % 32);
+		}
+		if (*p == '\n')
+			break;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -EINVAL;
+	}
+	return count;
+}
+
+/* print @mask the way the sysfs cpu masks expect it, "ff,00000001" */
+static void cpumask_print(const uint32_t *mask, char *buf)
+{
+	int i, top = 0;
+
+	for (i = 0; i < CPUMASK_WORDS; i++)
+		if (mask[i])
+			top = i;
+
+	buf += sprintf(buf, "%x", mask[top]);
+	for (i = top - 1; i >= 0; i--)
+		buf += sprintf(buf, ",%08x", mask[i]);
+}
+
+static int count_queues(const char *ifname, const char *prefix)
+{
+	char path[MAXPATHLEN];
+	struct dirent *d;
+	DIR *dir;
+	int count = 0;
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/queues", ifname);
+	dir = opendir(path);
+	if (!dir)
+		return -errno;
+	while ((d = readdir(dir)))
+		if (!strncmp(d->d_name, prefix, strlen(prefix)))
+			count++;
+	closedir(dir);
+	return count;
+}
+
+int lxc_netdev_steer_queues(const char *ifname, const char *cpulist)
+{
+	uint32_t cpus[CPUMASK_WORDS], queue[CPUMASK_WORDS];
+	char path[MAXPATHLEN], buf[CPUMASK_WORDS * 9 + 1];
+	int ntx, nrx, i, n, cpu, err;
+
+	if (cpulist_parse(cpulist, cpus) <= 0)
+		return -EINVAL;
+
+	nrx = count_queues(ifname, "rx-");
+	ntx = count_queues(ifname, "tx-");
+	if (nrx < 0 || ntx < 0)
+		return nrx < 0 ? nrx : ntx;
+
+	/* RPS: any cpu of the set may process what any queue receives */
+	cpumask_print(cpus, buf);
+	for (i = 0; i < nrx; i++) {
+		snprintf(path, sizeof(path),
+			 "/sys/class/net/%s/queues/rx-%d/rps_cpus", ifname, i);
+		err = proc_sys_net_write(path, buf);
+		if (err)
+			return err;
+	}
+
+	/* XPS: each cpu of the set sends through one queue, round robin */
+	for (i = 0; i < ntx; i++) {
+		memset(queue, 0, sizeof(queue));
+		for (cpu = 0, n = 0; cpu < CPUMASK_WORDS * 32; cpu++) {
+			if (!(cpus[cpu / 32] & (1U << (cpu % 32))))
+				continue;
+			if (n++ % ntx == i)
+				queue[cpu / 32] |= 1U << (cpu % 32);
+		}
+		cpumask_print(queue, buf);
+		snprintf(path, sizeof(path),
+			 "/sys/class/net/%s/queues/tx-%d/xps_cpus", ifname, i);
+		err = proc_sys_net_write(path, buf);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
 int lxc_convert_mac(char *macaddr, struct sockaddr *sockaddr)
 {
 	unsigned char *data;
@@ -861,7 +1095,7 @@ static int ip_addr_add(int family, int ifindex,
 	     memcmp(acast, &in6addr_any, sizeof(in6addr_any))))
 		goto out;
 
-	err = netlink_transaction(&nlh, nlmsg, answer);
+	err = netlink_queue(&nlh, nlmsg, answer);
 out:
 	netlink_close(&nlh);
 	nlmsg_free(answer);
@@ -1207,6 +1441,7 @@ static const char* const lxc_network_types[LXC_NET_MAXCONFTYPE + 1] = {
 	[LXC_NET_VLAN]    = "vlan",
 	[LXC_NET_PHYS]    = "phys",
 	[LXC_NET_EMPTY]   = "empty",
+	[LXC_NET_IPVLAN]  = "ipvlan",
 };
 
 const char *lxc_net_type_to_str(int type)
@@ -1305,3 +1540,402 @@ int setup_private_host_hw_addr(char *veth1)
 
 	return 0;
 }
+
+/*
+ * lxc_netns_info: the links and addresses of the network namespace of a
+ * running container. They are read with netlink dumps over a socket
+ * created in that namespace, and kept until a second socket, subscribed
+ * to the link and address notifications of the namespace, reports a
+ * change. Until then a query only costs a non-blocking read.
+ *
+ * The sockets pin the namespace: as long as they are open, it outlives
+ * the container along with its veth, macvlan and ipvlan devices. So they
+ * are closed once the container is seen stopped, when its namespace
+ * changes, and on stop, shutdown and destroy.
+ */
+struct netns_link {
+	int index;
+	char name[IFNAMSIZ];
+};
+
+struct netns_addr {
+	int index;
+	int family;
+	int scope_id;	/* as getifaddrs reports it, for link-local ipv6 */
+	char addr[INET6_ADDRSTRLEN];
+};
+
+struct lxc_netns_info {
+	pthread_mutex_t lock;
+	pid_t pid;		/* process owning the sockets */
+	dev_t dev;		/* namespace the sockets live in */
+	ino_t ino;
+	struct nl_handler nlh;	/* dump requests */
+	int notify;		/* link and address notifications */
+	int valid;
+	struct netns_link *links;
+	int nr_links;
+	struct netns_addr *addrs;
+	int nr_addrs;
+};
+
+struct lxc_netns_info *lxc_netns_info_new(void)
+{
+	struct lxc_netns_info *info;
+
+	info = calloc(1, sizeof(*info));
+	if (!info)
+		return NULL;
+	if (pthread_mutex_init(&info->lock, NULL)) {
+		free(info);
+		return NULL;
+	}
+	info->nlh.fd = -1;
+	info->notify = -1;
+	return info;
+}
+
+static void netns_info_close(struct lxc_netns_info *info)
+{
+	if (info->nlh.fd >= 0)
+		close(info->nlh.fd);
+	info->nlh.fd = -1;
+	if (info->notify >= 0)
+		close(info->notify);
+	info->notify = -1;
+	info->valid = 0;
+}
+
+void lxc_netns_info_release(struct lxc_netns_info *info)
+{
+	if (!info)
+		return;
+	pthread_mutex_lock(&info->lock);
+	netns_info_close(info);
+	pthread_mutex_unlock(&info->lock);
+}
+
+void lxc_netns_info_free(struct lxc_netns_info *info)
+{
+	if (!info)
+		return;
+	netns_info_close(info);
+	free(info->links);
+	free(info->addrs);
+	pthread_mutex_destroy(&info->lock);
+	free(info);
+}
+
+/*
+ * Make sure the sockets of info live in the network namespace of pid,
+ * they are created there by the calling thread, which then returns to
+ * its own namespace.
+ */
+static int netns_info_bind(struct lxc_netns_info *info, pid_t pid)
+{
+	char path[MAXPATHLEN];
+	struct sockaddr_nl local = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR |
+			     RTMGRP_IPV6_IFADDR,
+	};
+	struct stat st;
+	int netns, self = -1, err = 0;
+
+	snprintf(path, MAXPATHLEN, "/proc/%d/ns/net", pid);
+	netns = open(path, O_RDONLY | O_CLOEXEC);
+	if (netns < 0)
+		return -errno;
+	if (fstat(netns, &st)) {
+		err = -errno;
+		goto out;
+	}
+
+	if (info->nlh.fd >= 0 && info->pid == getpid() &&
+	    info->dev == st.st_dev && info->ino == st.st_ino)
+		goto out;
+
+	netns_info_close(info);
+
+	snprintf(path, MAXPATHLEN, "/proc/self/task/%ld/ns/net",
+		 (long)syscall(SYS_gettid));
+	self = open(path, O_RDONLY | O_CLOEXEC);
+	if (self < 0) {
+		err = -errno;
+		goto out;
+	}
+
+	if (setns(netns, CLONE_NEWNET)) {
+		err = -errno;
+		goto out;
+	}
+	info->nlh.fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC,
+			      NETLINK_ROUTE);
+	if (info->nlh.fd < 0)
+		err = -errno;
+	info->notify = socket(AF_NETLINK,
+			      SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK,
+			      NETLINK_ROUTE);
+	if (info->notify < 0 && !err)
+		err = -errno;
+	if (setns(self, CLONE_NEWNET) && !err)
+		err = -errno;
+	if (err)
+		goto out_close;
+
+	if (bind(info->notify, (struct sockaddr *)&local, sizeof(local))) {
+		err = -errno;
+		goto out_close;
+	}
+
+	info->nlh.seq = time(NULL);
+	info->pid = getpid();
+	info->dev = st.st_dev;
+	info->ino = st.st_ino;
+	goto out;
+
+out_close:
+	netns_info_close(info);
+out:
+	if (self >= 0)
+		close(self);
+	close(netns);
+	return err;
+}
+
+/*
+ * Read the pending notifications, any of them (or an overrun of the
+ * socket buffer) means the cached links and addresses are outdated.
+ */
+static void netns_info_drain(struct lxc_netns_info *info)
+{
+	char buf[NLMSG_GOOD_SIZE];
+	ssize_t ret;
+
+	for (;;) {
+		ret = recv(info->notify, buf, sizeof(buf), MSG_DONTWAIT);
+		if (ret > 0 || (ret < 0 && errno == ENOBUFS)) {
+			info->valid = 0;
+			continue;
+		}
+		if (ret < 0 && errno == EINTR)
+			continue;
+		break;
+	}
+}
+
+static int netns_add_link(struct lxc_netns_info *info, struct nlmsghdr *msg)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(msg);
+	struct rtattr *rta = IFLA_RTA(ifi);
+	int attr_len = msg->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+	struct netns_link *links, *link;
+
+	if (msg->nlmsg_type != RTM_NEWLINK)
+		return 0;
+
+	links = realloc(info->links, (info->nr_links + 1) * sizeof(*links));
+	if (!links)
+		return -ENOMEM;
+	info->links = links;
+	link = &links[info->nr_links];
+	memset(link, 0, sizeof(*link));
+	link->index = ifi->ifi_index;
+
+	while (RTA_OK(rta, attr_len)) {
+		if (rta->rta_type == IFLA_IFNAME) {
+			snprintf(link->name, IFNAMSIZ, "%s",
+				 (char *)RTA_DATA(rta));
+			info->nr_links++;
+			break;
+		}
+		rta = RTA_NEXT(rta, attr_len);
+	}
+	return 0;
+}
+
+static int netns_add_addr(struct lxc_netns_info *info, struct nlmsghdr *msg)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(msg);
+	struct rtattr *rta = IFA_RTA(ifa);
+	int attr_len = msg->nlmsg_len - NLMSG_LENGTH(sizeof(*ifa));
+	struct netns_addr *addrs, *addr;
+	void *data = NULL;
+
+	if (msg->nlmsg_type != RTM_NEWADDR ||
+	    (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6))
+		return 0;
+
+	/* the local address of point to point links, as getifaddrs */
+	while (RTA_OK(rta, attr_len)) {
+		if (rta->rta_type == IFA_LOCAL)
+			data = RTA_DATA(rta);
+		else if (rta->rta_type == IFA_ADDRESS && !data)
+			data = RTA_DATA(rta);
+		rta = RTA_NEXT(rta, attr_len);
+	}
+	if (!data)
+		return 0;
+
+	addrs = realloc(info->addrs, (info->nr_addrs + 1) * sizeof(*addrs));
+	if (!addrs)
+		return -ENOMEM;
+	info->addrs = addrs;
+	addr = &addrs[info->nr_addrs];
+	addr->index = ifa->ifa_index;
+	addr->family = ifa->ifa_family;
+	addr->scope_id = 0;
+	if (ifa->ifa_family == AF_INET6 &&
+	    (IN6_IS_ADDR_LINKLOCAL(data) || IN6_IS_ADDR_MC_LINKLOCAL(data)))
+		addr->scope_id = ifa->ifa_index;
+	if (!inet_ntop(ifa->ifa_family, data, addr->addr, sizeof(addr->addr)))
+		return 0;
+	info->nr_addrs++;
+	return 0;
+}
+
+static int netns_dump(struct lxc_netns_info *info, int type,
+		      int (*add)(struct lxc_netns_info *, struct nlmsghdr *))
+{
+	struct nlmsg *nlmsg = NULL, *answer = NULL;
+	struct ip_req *ip_req;
+	struct nlmsghdr *msg;
+	int err, recv_len, answer_len, done = 0;
+
+	err = -ENOMEM;
+	nlmsg = nlmsg_alloc(NLMSG_GOOD_SIZE);
+	if (!nlmsg)
+		goto out;
+
+	answer = nlmsg_alloc(NLMSG_GOOD_SIZE);
+	if (!answer)
+		goto out;
+	answer_len = answer->nlmsghdr.nlmsg_len;
+
+	/* ifaddrmsg and ifinfomsg both start with the family */
+	ip_req = (struct ip_req *)nlmsg;
+	ip_req->nlmsg.nlmsghdr.nlmsg_len =
+		NLMSG_LENGTH(sizeof(struct ifinfomsg));
+	ip_req->nlmsg.nlmsghdr.nlmsg_flags = NLM_F_REQUEST|NLM_F_DUMP;
+	ip_req->nlmsg.nlmsghdr.nlmsg_type = type;
+	ip_req->nlmsg.nlmsghdr.nlmsg_seq = ++info->nlh.seq;
+	ip_req->ifa.ifa_family = AF_UNSPEC;
+
+	err = netlink_send(&info->nlh, nlmsg);
+	if (err < 0)
+		goto out;
+
+	while (!done) {
+		answer->nlmsghdr.nlmsg_len = answer_len;
+		err = netlink_rcv(&info->nlh, answer);
+		if (err < 0)
+			goto out;
+		if (!err) {
+			err = -EIO;
+			goto out;
+		}
+
+		recv_len = err;
+		err = 0;
+		msg = &answer->nlmsghdr;
+
+		for (; NLMSG_OK(msg, recv_len); msg = NLMSG_NEXT(msg, recv_len)) {
+			/* left over from an interrupted dump */
+			if (msg->nlmsg_seq != info->nlh.seq)
+				continue;
+
+			if (msg->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *errmsg = NLMSG_DATA(msg);
+				err = errmsg->error;
+				goto out;
+			}
+
+			if (msg->nlmsg_type == NLMSG_DONE) {
+				done = 1;
+				break;
+			}
+
+			err = add(info, msg);
+			if (err)
+				goto out;
+		}
+	}
+
+out:
+	nlmsg_free(answer);
+	nlmsg_free(nlmsg);
+	return err;
+}
+
+static int netns_info_update(struct lxc_netns_info *info, pid_t pid)
+{
+	int err;
+
+	err = netns_info_bind(info, pid);
+	if (err)
+		return err;
+
+	netns_info_drain(info);
+	if (info->valid)
+		return 0;
+
+	/*
+	 * The notifications are drained before the dumps, a change racing
+	 * with them is seen by the next query.
+	 */
+	info->valid = 1;
+	info->nr_links = 0;
+	info->nr_addrs = 0;
+	err = netns_dump(info, RTM_GETLINK, netns_add_link);
+	if (!err)
+		err = netns_dump(info, RTM_GETADDR, netns_add_addr);
+	if (err)
+		netns_info_close(info);
+	return err;
+}
+
+static const char *netns_link_name(struct lxc_netns_info *info, int index)
+{
+	int i;
+
+	for (i = 0; i < info->nr_links; i++)
+		if (info->links[i].index == index)
+			return info->links[i].name;
+	return NULL;
+}
+
+int lxc_netns_foreach_link(struct lxc_netns_info *info, pid_t pid,
+			   int (*cb)(const char *, void *), void *data)
+{
+	int i, err;
+
+	pthread_mutex_lock(&info->lock);
+	err = netns_info_update(info, pid);
+	for (i = 0; !err && i < info->nr_links; i++)
+		err = cb(info->links[i].name, data);
+	pthread_mutex_unlock(&info->lock);
+	return err;
+}
+
+int lxc_netns_foreach_addr(struct lxc_netns_info *info, pid_t pid,
+			   int (*cb)(const char *, int, int, const char *,
+				     void *),
+			   void *data)
+{
+	struct netns_addr *addr;
+	const char *ifname;
+	int i, err;
+
+	pthread_mutex_lock(&info->lock);
+	err = netns_info_update(info, pid);
+	for (i = 0; !err && i < info->nr_addrs; i++) {
+		addr = &info->addrs[i];
+		ifname = netns_link_name(info, addr->index);
+		if (!ifname)
+			continue;
+		err = cb(ifname, addr->family, addr->scope_id, addr->addr,
+			 data);
+	}
+	pthread_mutex_unlock(&info->lock);
+	return err;
+}
@@ -23,6 +23,12 @@
 #ifndef _network_h
 #define _network_h
 
+/*
+ * Inside a netlink session (see nl.h), moving a device, setting it up
+ * or down, changing its mtu and adding addresses are only queued: they
+ * succeed when called and their errors are reported by the flush.
+ */
+
 /*
  * Convert a string mac address to a socket structure
  */
@@ -63,9 +69,19 @@ extern int lxc_netdev_set_mtu(const char *name, int mtu);
  * Create a virtual network devices
  */
 extern int lxc_veth_create(const char *name1, const char *name2);
+extern int lxc_veth_create_mq(const char *name1, const char *name2,
+			      int txqueues, int rxqueues);
 extern int lxc_macvlan_create(const char *master, const char *name, int mode);
+extern int lxc_ipvlan_create(const char *master, const char *name, int mode);
 extern int lxc_vlan_create(const char *master, const char *name, unsigned short vid);
 
+/*
+ * Spread the packet processing of a device over a cpu list, such as
+ * "0-3,8": receive packet steering over all of them for each receive
+ * queue, and transmit packet steering of each cpu to one transmit queue
+ */
+extern int lxc_netdev_steer_queues(const char *ifname, const char *cpulist);
+
 /*
  * Activate forwarding
  */
@@ -139,4 +155,30 @@ extern char *lxc_mkifname(char *template);
 extern const char *lxc_net_type_to_str(int type);
 extern int setup_private_host_hw_addr(char *veth1);
 extern int netdev_get_mtu(int ifindex);
+
+/*
+ * Links and addresses of the network namespace of a running container,
+ * read over netlink sockets opened in it once and cached until the
+ * namespace notifies a change. The calling thread briefly enters the
+ * namespace, which requires CAP_SYS_ADMIN over it.
+ *
+ * The callbacks are given the interface name, and for addresses the
+ * family, the ipv6 scope id and the printable address. They are called
+ * with the info locked, a non-zero return stops the walk and is returned.
+ * The walks return 0 or -errno.
+ *
+ * The open sockets keep the namespace, and so the container interfaces,
+ * alive once the container is gone: lxc_netns_info_release() closes them
+ * and must be called when the container stops.
+ */
+struct lxc_netns_info;
+extern struct lxc_netns_info *lxc_netns_info_new(void);
+extern void lxc_netns_info_release(struct lxc_netns_info *info);
+extern void lxc_netns_info_free(struct lxc_netns_info *info);
+extern int lxc_netns_foreach_link(struct lxc_netns_info *info, pid_t pid,
+				  int (*cb)(const char *, void *), void *data);
+extern int lxc_netns_foreach_addr(struct lxc_netns_info *info, pid_t pid,
+				  int (*cb)(const char *, int, int,
+					    const char *, void *),
+				  void *data);
 #endif
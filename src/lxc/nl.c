@@ -35,6 +35,20 @@
 #define NLMSG_TAIL(nmsg) \
         ((struct rtattr *) (((void *) (nmsg)) + NLMSG_ALIGN((nmsg)->nlmsg_len)))
 
+/*
+ * Keep a batch, and the error acknowledgments which echo its requests,
+ * well within the socket buffers set up by netlink_open
+ */
+#define NL_BATCH_SIZE (4*PAGE_SIZE)
+
+/* per thread, as other threads must not send over an open session */
+static __thread struct nl_session *session;
+
+static int in_session(struct nl_handler *handler)
+{
+	return session && handler->fd == session->nlh.fd;
+}
+
 extern size_t nlmsg_len(const struct nlmsg *nlmsg)
 {
 	return nlmsg->nlmsghdr.nlmsg_len - NLMSG_HDRLEN;
@@ -177,6 +191,13 @@ extern int netlink_send(struct nl_handler *handler, struct nlmsg *nlmsg)
                 .msg_iovlen = 1,
         };
 	int ret;
+
+	/* the queued requests are answered first */
+	if (in_session(handler) && session->pending) {
+		ret = netlink_session_flush(session);
+		if (ret < 0)
+			return ret;
+	}
 	
         memset(&nladdr, 0, sizeof(nladdr));
         nladdr.nl_family = AF_NETLINK;
@@ -214,12 +235,137 @@ extern int netlink_transaction(struct nl_handler *handler,
 	return 0;
 }
 
+extern int netlink_queue(struct nl_handler *handler,
+			 struct nlmsg *request, struct nlmsg *answer)
+{
+	size_t len = NLMSG_ALIGN(request->nlmsghdr.nlmsg_len);
+	int ret;
+
+	if (!in_session(handler))
+		return netlink_transaction(handler, request, answer);
+
+	if (session->len + len > NL_BATCH_SIZE) {
+		ret = netlink_session_flush(session);
+		if (ret < 0)
+			return ret;
+	}
+
+	request->nlmsghdr.nlmsg_flags |= NLM_F_ACK;
+	request->nlmsghdr.nlmsg_seq = ++session->nlh.seq;
+	memcpy(session->batch + session->len, request, len);
+	session->len += len;
+	session->pending++;
+
+	return 0;
+}
+
+extern int netlink_session_flush(struct nl_session *s)
+{
+	char buf[NLMSG_GOOD_SIZE];
+	struct nlmsghdr *hdr;
+        struct sockaddr_nl nladdr;
+	int ret, err = 0;
+
+	if (!s)
+		s = session;
+	if (!s || !s->pending)
+		return 0;
+
+        memset(&nladdr, 0, sizeof(nladdr));
+        nladdr.nl_family = AF_NETLINK;
+
+again:
+	ret = sendto(s->nlh.fd, s->batch, s->len, 0,
+		     (struct sockaddr *)&nladdr, sizeof(nladdr));
+	if (ret < 0) {
+		if (errno == EINTR)
+			goto again;
+		err = -errno;
+		goto out;
+	}
+
+	/* one acknowledgment per request, in the order of the requests */
+	while (s->pending) {
+		ret = recv(s->nlh.fd, buf, sizeof(buf), 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (!err)
+				err = -errno;
+			break;
+		}
+		if (!ret)
+			break;
+
+		for (hdr = (struct nlmsghdr *)buf; NLMSG_OK(hdr, ret);
+		     hdr = NLMSG_NEXT(hdr, ret)) {
+			struct nlmsgerr *nlerr = NLMSG_DATA(hdr);
+
+			if (hdr->nlmsg_type != NLMSG_ERROR)
+				continue;
+			if (nlerr->error && !err)
+				err = nlerr->error;
+			s->pending--;
+		}
+	}
+
+out:
+	s->len = 0;
+	s->pending = 0;
+	if (err && !s->error)
+		s->error = err;
+	return err;
+}
+
+extern int netlink_session_begin(struct nl_session *s, int protocol)
+{
+	int err;
+
+	if (session)
+		return -EBUSY;
+
+	memset(s, 0, sizeof(*s));
+	s->batch = malloc(NL_BATCH_SIZE);
+	if (!s->batch)
+		return -ENOMEM;
+
+	err = netlink_open(&s->nlh, protocol);
+	if (err) {
+		if (s->nlh.fd >= 0)
+			close(s->nlh.fd);
+		free(s->batch);
+		return err;
+	}
+
+	s->protocol = protocol;
+	session = s;
+	return 0;
+}
+
+extern int netlink_session_end(struct nl_session *s)
+{
+	int err;
+
+	netlink_session_flush(s);
+	err = s->error;
+	session = NULL;
+	netlink_close(&s->nlh);
+	free(s->batch);
+	s->batch = NULL;
+	return err;
+}
+
 extern int netlink_open(struct nl_handler *handler, int protocol)
 {
 	socklen_t socklen;
         int sndbuf = 32768;
         int rcvbuf = 32768;
 
+	if (session && session->protocol == protocol) {
+		*handler = session->nlh;
+		return 0;
+	}
+
         memset(handler, 0, sizeof(*handler));
 
         handler->fd = socket(AF_NETLINK, SOCK_RAW, protocol);
@@ -260,6 +406,12 @@ extern int netlink_open(struct nl_handler *handler, int protocol)
 
 extern int netlink_close(struct nl_handler *handler)
 {
+	/* the session socket is closed by netlink_session_end */
+	if (in_session(handler)) {
+		handler->fd = -1;
+		return 0;
+	}
+
 	close(handler->fd);
 	handler->fd = -1;
 	return 0;
@@ -123,6 +123,79 @@ int netlink_send(struct nl_handler *handler, struct nlmsg *nlmsg);
 int netlink_transaction(struct nl_handler *handler,
 			struct nlmsg *request, struct nlmsg *anwser);
 
+/*
+ * struct nl_session : while a session is active, the netlink sockets
+ *  opened with its protocol are all the session socket, and the
+ *  requests given to netlink_queue are sent in batches, one sendmsg
+ *  per batch, their acknowledgments being collected together.
+ *  There can be only one active session at a time.
+ *
+ * @nlh: the handler of the shared socket
+ * @protocol: the protocol of the shared socket
+ * @batch: the queued requests
+ * @len: the length of the queued requests
+ * @pending: the number of queued requests
+ * @error: the error of the first failed request of the session
+ */
+struct nl_session {
+	struct nl_handler nlh;
+	int protocol;
+	char *batch;
+	size_t len;
+	int pending;
+	int error;
+};
+
+/*
+ * netlink_session_begin : open a netlink socket and make it the
+ *  socket of the netlink_open calls for @protocol, until
+ *  netlink_session_end is called
+ *
+ * @session: the session to start
+ * @protocol: the netlink protocol of the session
+ *
+ * Returns 0 on success, < 0 otherwise
+ */
+int netlink_session_begin(struct nl_session *session, int protocol);
+
+/*
+ * netlink_session_flush : send the queued requests and wait for
+ *  their acknowledgments. The requests are all processed, even if
+ *  some of them fail.
+ *
+ * @session: an active session, or NULL for the active one if any
+ *
+ * Returns 0 on success, the error of the first failed request otherwise
+ */
+int netlink_session_flush(struct nl_session *session);
+
+/*
+ * netlink_session_end : flush the queued requests, end the session
+ *  and close its socket
+ *
+ * @session: the active session
+ *
+ * Returns 0 if all the queued requests succeeded, the error of the
+ * first failed one otherwise, even if it was reported by an earlier flush
+ */
+int netlink_session_end(struct nl_session *session);
+
+/*
+ * netlink_queue: send a request which is only expected to be
+ *  acknowledged. Inside a session, the request is queued and
+ *  its result only known when the session is flushed. Otherwise,
+ *  this is netlink_transaction.
+ *
+ * @handler: a handler to a opened netlink socket
+ * @request: a netlink message pointer containing the request
+ * @answer: a netlink message pointer to receive the result, outside
+ *  of a session
+ *
+ * Returns 0 on success or when queued, < 0 otherwise
+ */
+int netlink_queue(struct nl_handler *handler,
+		  struct nlmsg *request, struct nlmsg *answer);
+
 /*
  * nla_put_string: copy a null terminated string to a netlink message
  *  attribute
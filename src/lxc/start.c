@@ -70,6 +70,7 @@
 #include "namespace.h"
 #include "lxcseccomp.h"
 #include "caps.h"
+#include "trace.h"
 #include "lsm/lsm.h"
 
 lxc_log_define(lxc_start, lxc);
@@ -344,6 +345,9 @@ static int lxc_poll(const char *name, struct lxc_handler *handler)
 		#endif
 	}
 
+	/* the container is up, the start log has no reason to wait */
+	lxc_log_flush();
+
 	return lxc_mainloop(&descr, -1);
 
 out_mainloop_open:
@@ -353,9 +357,31 @@ out_sigfd:
 	return -1;
 }
 
+/*
+ * Release what a warm reboot kept for a boot which is not going to
+ * happen, or which did not get to use it
+ */
+static void lxc_drop_warm_state(struct lxc_handler *handler)
+{
+	struct lxc_conf *conf = handler->conf;
+
+	if (conf->warm_netns_fd >= 0) {
+		close(conf->warm_netns_fd);
+		conf->warm_netns_fd = -1;
+	}
+	if (conf->tty_info.nbtty)
+		lxc_delete_tty(&conf->tty_info);
+	if (conf->warm_cgroup_data) {
+		handler->cgroup_data = conf->warm_cgroup_data;
+		conf->warm_cgroup_data = NULL;
+		cgroup_destroy(handler);
+	}
+}
+
 struct lxc_handler *lxc_init(const char *name, struct lxc_conf *conf, const char *lxcpath)
 {
 	struct lxc_handler *handler;
+	int span, hook;
 
 	handler = malloc(sizeof(*handler));
 	if (!handler)
@@ -363,9 +389,18 @@ struct lxc_handler *lxc_init(const char *name, struct lxc_conf *conf, const char
 
 	memset(handler, 0, sizeof(*handler));
 
+	/*
+	 * Tracing is best effort.  The first span covers the whole start
+	 * and is closed by __lxc_start once the container runs.
+	 */
+	handler->trace = lxc_trace_new();
+	lxc_trace_begin(handler->trace, "lxc_start");
+	span = lxc_trace_begin(handler->trace, "lxc_init");
+
 	handler->conf = conf;
 	handler->lxcpath = lxcpath;
 	handler->pinfd = -1;
+	handler->runningfd = -1;
 
 	lsm_init();
 
@@ -378,6 +413,11 @@ struct lxc_handler *lxc_init(const char *name, struct lxc_conf *conf, const char
 	if (lxc_cmd_init(name, handler, lxcpath))
 		goto out_free_name;
 
+	/* the command socket is ours now, so list us as running */
+	handler->runningfd = lxc_running_register(name, lxcpath);
+	if (handler->runningfd < 0)
+		WARN("failed to add '%s' to the running containers", name);
+
 	if (lxc_read_seccomp_config(conf) != 0) {
 		ERROR("failed loading seccomp policy");
 		goto out_close_maincmd_fd;
@@ -410,12 +450,15 @@ struct lxc_handler *lxc_init(const char *name, struct lxc_conf *conf, const char
 	}
 	/* End of environment variable setup for hooks */
 
+	hook = lxc_trace_begin(handler->trace, "hook:pre-start");
 	if (run_lxc_hooks(name, "pre-start", conf, handler->lxcpath, NULL)) {
 		ERROR("failed to run pre-start hooks for container '%s'.", name);
 		goto out_aborting;
 	}
+	lxc_trace_end(handler->trace, hook);
 
-	if (lxc_create_tty(name, conf)) {
+	/* still allocated after a warm reboot */
+	if (!conf->tty_info.nbtty && lxc_create_tty(name, conf)) {
 		ERROR("failed to create the ttys");
 		goto out_aborting;
 	}
@@ -440,6 +483,7 @@ struct lxc_handler *lxc_init(const char *name, struct lxc_conf *conf, const char
 		goto out_restore_sigmask;
 	}
 
+	lxc_trace_end(handler->trace, span);
 	INFO("'%s' is initialized", name);
 	return handler;
 
@@ -450,12 +494,15 @@ out_delete_tty:
 out_aborting:
 	lxc_set_state(name, handler, ABORTING);
 out_close_maincmd_fd:
+	lxc_running_unregister(name, lxcpath, handler->runningfd);
 	close(conf->maincmd_fd);
 	conf->maincmd_fd = -1;
 out_free_name:
 	free(handler->name);
 	handler->name = NULL;
 out_free:
+	lxc_drop_warm_state(handler);
+	lxc_trace_free(handler->trace);
 	free(handler);
 	return NULL;
 }
@@ -476,11 +523,26 @@ static void lxc_fini(const char *name, struct lxc_handler *handler)
 		WARN("failed to restore sigprocmask");
 
 	lxc_console_delete(&handler->conf->console);
-	lxc_delete_tty(&handler->conf->tty_info);
+	if (handler->warm_reboot) {
+		struct lxc_tty_info *tty_info = &handler->conf->tty_info;
+		int i;
+
+		/* handed over to the next boot, see lxc_spawn() */
+		handler->conf->warm_cgroup_data = handler->cgroup_data;
+		handler->cgroup_data = NULL;
+		/* the ttys are kept, not their clients of this boot */
+		for (i = 0; i < tty_info->nbtty; i++)
+			tty_info->pty_info[i].busy = 0;
+	} else {
+		lxc_delete_tty(&handler->conf->tty_info);
+		lxc_drop_warm_state(handler);
+	}
+	lxc_running_unregister(name, handler->lxcpath, handler->runningfd);
 	close(handler->conf->maincmd_fd);
 	handler->conf->maincmd_fd = -1;
 	free(handler->name);
 	cgroup_destroy(handler);
+	lxc_trace_free(handler->trace);
 	free(handler);
 }
 
@@ -607,10 +669,76 @@ static int read_unpriv_netifindex(struct lxc_list *network)
 	return 0;
 }
 
+/*
+ * Split the NUL separated arguments sent by lxc_cmd_unpark() into an
+ * argv array pointing into @args.
+ */
+static char **park_argv_unpack(char *args, int len)
+{
+	char **argv;
+	int argc = 0, i;
+
+	if (len <= 0 || args[len - 1] != '\0')
+		return NULL;
+
+	for (i = 0; i < len; i++)
+		if (args[i] == '\0')
+			argc++;
+
+	argv = malloc((argc + 1) * sizeof(*argv));
+	if (!argv)
+		return NULL;
+
+	for (i = 0; i < argc; i++) {
+		argv[i] = args;
+		args += strlen(args) + 1;
+	}
+	argv[argc] = NULL;
+	return argv;
+}
+
+/*
+ * Wait, fully set up, for lxc_unpark() to send the command to exec.
+ */
+static int do_park(struct lxc_handler *handler)
+{
+	char *args;
+	int len;
+
+	if (lxc_sync_barrier_parent(handler, LXC_SYNC_PARK))
+		return -1;
+
+	if (read(handler->sv[0], &len, sizeof(len)) != sizeof(len) ||
+	    len <= 0 || len > LXC_CMD_DATA_MAX) {
+		ERROR("failed to receive the command to unpark with");
+		return -1;
+	}
+
+	args = malloc(len);
+	if (!args)
+		return -1;
+	if (recv(handler->sv[0], args, len, MSG_WAITALL) != len) {
+		ERROR("failed to receive the command to unpark with");
+		free(args);
+		return -1;
+	}
+
+	handler->park_argv = park_argv_unpack(args, len);
+	if (!handler->park_argv) {
+		ERROR("invalid command to unpark with");
+		free(args);
+		return -1;
+	}
+	return 0;
+}
+
 static int do_start(void *data)
 {
 	struct lxc_handler *handler = data;
 	const char *lsm_label = NULL;
+	int span, phase;
+
+	span = lxc_trace_begin(handler->trace, "do_start");
 
 	if (sigprocmask(SIG_SETMASK, &handler->oldmask, NULL)) {
 		SYSERROR("failed to set sigprocmask");
@@ -630,10 +758,18 @@ static int do_start(void *data)
 
 	lxc_sync_fini_parent(handler);
 
-	/* don't leak the pinfd to the container */
+	/* don't leak the pinfd or the running entry to the container */
 	if (handler->pinfd >= 0) {
 		close(handler->pinfd);
 	}
+	if (handler->runningfd >= 0) {
+		close(handler->runningfd);
+	}
+	/* nor the net namespace kept by a warm reboot, we are in it */
+	if (handler->conf->warm_netns_fd >= 0) {
+		close(handler->conf->warm_netns_fd);
+		handler->conf->warm_netns_fd = -1;
+	}
 
 	/* Tell the parent task it can begin to configure the
 	 * container and wait for it to finish
@@ -680,10 +816,12 @@ static int do_start(void *data)
 	#endif
 
 	/* Setup the container, ip, names, utsname, ... */
+	phase = lxc_trace_begin(handler->trace, "lxc_setup");
 	if (lxc_setup(handler)) {
 		ERROR("failed to setup the container");
 		goto out_warn_father;
 	}
+	lxc_trace_end(handler->trace, phase);
 
 	/* ask father to setup cgroups and wait for him to finish */
 	if (lxc_sync_barrier_parent(handler, LXC_SYNC_CGROUP))
@@ -706,10 +844,12 @@ static int do_start(void *data)
 	if (lxc_seccomp_load(handler->conf) != 0)
 		goto out_warn_father;
 
+	phase = lxc_trace_begin(handler->trace, "hook:start");
 	if (run_lxc_hooks(handler->name, "start", handler->conf, handler->lxcpath, NULL)) {
 		ERROR("failed to run start hooks for container '%s'.", handler->name);
 		goto out_warn_father;
 	}
+	lxc_trace_end(handler->trace, phase);
 
 	/* The clearenv() and putenv() calls have been moved here
 	 * to allow us to use enviroment variables passed to the various
@@ -726,6 +866,11 @@ static int do_start(void *data)
 		goto out_warn_father;
 	}
 
+	lxc_trace_end(handler->trace, span);
+
+	if (handler->conf->park && do_park(handler))
+		goto out_warn_father;
+
 	close(handler->sigfd);
 
 	/* after this call, we are in error because this
@@ -777,6 +922,18 @@ static int lxc_spawn(struct lxc_handler *handler)
 	int saved_ns_fd[LXC_NS_MAX];
 	int preserve_mask = 0, i;
 	int netpipepair[2], nveths;
+	int span, phase;
+	bool warm_cgroup = false;
+	int warm_netns_fd = handler->conf->warm_netns_fd;
+
+	span = lxc_trace_begin(handler->trace, "lxc_spawn");
+
+	/* left by a warm reboot, freed by lxc_fini() should we fail */
+	if (handler->conf->warm_cgroup_data) {
+		handler->cgroup_data = handler->conf->warm_cgroup_data;
+		handler->conf->warm_cgroup_data = NULL;
+		warm_cgroup = true;
+	}
 
 	for (i = 0; i < LXC_NS_MAX; i++)
 		if (handler->conf->inherit_ns_fd[i] != -1)
@@ -791,7 +948,10 @@ static int lxc_spawn(struct lxc_handler *handler)
 		handler->clone_flags |= CLONE_NEWUSER;
 	}
 
-	if (handler->conf->inherit_ns_fd[LXC_NS_NET] == -1) {
+	if (warm_netns_fd >= 0) {
+		INFO("Keeping the net namespace of the previous boot");
+		preserve_mask |= CLONE_NEWNET;
+	} else if (handler->conf->inherit_ns_fd[LXC_NS_NET] == -1) {
 		if (!lxc_requests_empty_network(handler))
 			handler->clone_flags |= CLONE_NEWNET;
 
@@ -810,11 +970,13 @@ static int lxc_spawn(struct lxc_handler *handler)
 			/* that should be done before the clone because we will
 			 * fill the netdev index and use them in the child
 			 */
+			phase = lxc_trace_begin(handler->trace, "lxc_create_network");
 			if (lxc_create_network(handler)) {
 				ERROR("failed to create the network");
 				lxc_sync_fini(handler);
 				return -1;
 			}
+			lxc_trace_end(handler->trace, phase);
 		}
 
 		if (save_phys_nics(handler->conf)) {
@@ -838,17 +1000,21 @@ static int lxc_spawn(struct lxc_handler *handler)
 	}
 
 
-	if (!cgroup_init(handler)) {
+	phase = lxc_trace_begin(handler->trace, "cgroup_create");
+	if (warm_cgroup) {
+		INFO("Reusing the cgroups of the previous boot");
+	} else if (!cgroup_init(handler)) {
 		ERROR("failed initializing cgroup support");
 		goto out_delete_net;
 	}
 
 	cgroups_connected = true;
 
-	if (!cgroup_create(handler)) {
+	if (!warm_cgroup && !cgroup_create(handler)) {
 		ERROR("failed creating cgroups");
 		goto out_delete_net;
 	}
+	lxc_trace_end(handler->trace, phase);
 
 	/*
 	 * if the rootfs is not a blockdev, prevent the container from
@@ -866,8 +1032,13 @@ static int lxc_spawn(struct lxc_handler *handler)
 		goto out_delete_net;
 	if (attach_ns(handler->conf->inherit_ns_fd) < 0)
 		goto out_delete_net;
+	if (warm_netns_fd >= 0 && setns(warm_netns_fd, CLONE_NEWNET)) {
+		SYSERROR("failed to enter the kept net namespace");
+		goto out_delete_net;
+	}
 
-	if (am_unpriv() && (nveths = count_veths(&handler->conf->network))) {
+	if (warm_netns_fd == -1 && am_unpriv() &&
+	    (nveths = count_veths(&handler->conf->network))) {
 		if (pipe(netpipepair) < 0) {
 			SYSERROR("Error creating pipe");
 			goto out_delete_net;
@@ -886,11 +1057,18 @@ static int lxc_spawn(struct lxc_handler *handler)
 	if (attach_ns(saved_ns_fd))
 		WARN("failed to restore saved namespaces");
 
+	/* the container holds on to it now */
+	if (warm_netns_fd >= 0) {
+		close(warm_netns_fd);
+		handler->conf->warm_netns_fd = -1;
+	}
+
 	lxc_sync_fini_child(handler);
 
 	if (lxc_sync_wait_child(handler, LXC_SYNC_CONFIGURE))
 		failed_before_rename = 1;
 
+	phase = lxc_trace_begin(handler->trace, "cgroup_setup");
 	if (!cgroup_create_legacy(handler)) {
 		ERROR("failed to setup the legacy cgroups for %s", name);
 		goto out_delete_net;
@@ -905,16 +1083,19 @@ static int lxc_spawn(struct lxc_handler *handler)
 
 	if (!cgroup_chown(handler))
 		goto out_delete_net;
+	lxc_trace_end(handler->trace, phase);
 
 	if (failed_before_rename)
 		goto out_delete_net;
 
 	/* Create the network configuration */
 	if (handler->clone_flags & CLONE_NEWNET) {
+		phase = lxc_trace_begin(handler->trace, "lxc_assign_network");
 		if (lxc_assign_network(&handler->conf->network, handler->pid)) {
 			ERROR("failed to create the configured network");
 			goto out_delete_net;
 		}
+		lxc_trace_end(handler->trace, phase);
 	}
 
 	if (netpipe != -1) {
@@ -922,6 +1103,7 @@ static int lxc_spawn(struct lxc_handler *handler)
 		struct lxc_netdev *netdev;
 
 		close(netpipe);
+		netpipe = -1;
 		lxc_list_for_each(iterator, &handler->conf->network) {
 			netdev = iterator->elem;
 			if (netdev->type != LXC_NET_VETH)
@@ -965,12 +1147,27 @@ static int lxc_spawn(struct lxc_handler *handler)
 	 * success, or return a different value, causing us to error
 	 * out).
 	 */
-	if (lxc_sync_barrier_child(handler, LXC_SYNC_POST_CGROUP))
+	if (handler->conf->park) {
+		/* the child stops right before exec'ing, see lxc_unpark() */
+		if (lxc_sync_wake_child(handler, LXC_SYNC_POST_CGROUP) ||
+		    lxc_sync_wait_child(handler, LXC_SYNC_PARK))
+			return -1;
+	} else if (lxc_sync_barrier_child(handler, LXC_SYNC_POST_CGROUP))
 		return -1;
 
 	if (detect_shared_rootfs())
 		umount2(handler->conf->rootfs.mount, MNT_DETACH);
 
+	if (handler->conf->park) {
+		if (lxc_set_state(name, handler, PARKED)) {
+			ERROR("failed to set state to %s", lxc_state2str(PARKED));
+			goto out_abort;
+		}
+		/* keep the sync socket, to hand the command to the child */
+		lxc_trace_end(handler->trace, span);
+		return 0;
+	}
+
 	if (handler->ops->post_start(handler, handler->data))
 		goto out_abort;
 
@@ -981,10 +1178,16 @@ static int lxc_spawn(struct lxc_handler *handler)
 	}
 
 	lxc_sync_fini(handler);
+	lxc_trace_end(handler->trace, span);
 
 	return 0;
 
 out_delete_net:
+	if (netpipe != -1) {
+		close(netpipe);
+		close(netpipepair[1]);
+		netpipe = -1;
+	}
 	if (cgroups_connected)
 		cgroup_disconnect();
 	if (handler->clone_flags & CLONE_NEWNET)
@@ -1000,6 +1203,50 @@ out_abort:
 	return -1;
 }
 
+/*
+ * Have a parked container exec @args, a list of @len bytes of NUL
+ * terminated arguments, then finish its start as lxc_spawn() would.
+ * Returns 0 on success, < 0 otherwise
+ */
+int lxc_unpark(struct lxc_handler *handler, const char *args, int len)
+{
+	int ret = -1;
+
+	if (handler->state != PARKED)
+		return -EBUSY;
+
+	handler->park_argv = park_argv_unpack((char *)args, len);
+	if (!handler->park_argv)
+		return -EINVAL;
+
+	if (lxc_sync_wake_child(handler, LXC_SYNC_POST_PARK) ||
+	    write(handler->sv[1], &len, sizeof(len)) != sizeof(len) ||
+	    lxc_write_nointr(handler->sv[1], args, len) != len) {
+		ERROR("failed to send the command to exec to '%s'", handler->name);
+		goto out;
+	}
+
+	/* the sync socket is closed on exec, anything else is an error */
+	if (lxc_sync_wait_child(handler, LXC_SYNC_POST_PARK + 1))
+		goto out;
+
+	if (handler->ops->post_start(handler, handler->data))
+		goto out;
+
+	if (lxc_set_state(handler->name, handler, RUNNING)) {
+		ERROR("failed to set state to %s", lxc_state2str(RUNNING));
+		goto out;
+	}
+	ret = 0;
+
+out:
+	lxc_sync_fini(handler);
+	/* the arguments belong to the command request */
+	free(handler->park_argv);
+	handler->park_argv = NULL;
+	return ret;
+}
+
 int get_netns_fd(int pid)
 {
 	char path[MAXPATHLEN];
@@ -1048,6 +1295,12 @@ int __lxc_start(const char *name, struct lxc_conf *conf,
 	}
 
 	err = lxc_spawn(handler);
+
+	/* close the lxc_start span opened by lxc_init */
+	lxc_trace_end(handler->trace, 0);
+	if (handler->conf->tracefile)
+		lxc_trace_write(handler->trace, name, handler->conf->tracefile);
+
 	if (err) {
 		ERROR("failed to spawn '%s'", name);
 		goto out_fini_nonet;
@@ -1056,6 +1309,9 @@ int __lxc_start(const char *name, struct lxc_conf *conf,
 	netnsfd = get_netns_fd(handler->pid);
 
 	err = lxc_poll(name, handler);
+	/* never unparked */
+	if (handler->conf->park)
+		lxc_sync_fini(handler);
 	if (err) {
 		ERROR("mainloop exited with an error");
 		if (netnsfd >= 0)
@@ -1090,9 +1346,26 @@ int __lxc_start(const char *name, struct lxc_conf *conf,
 		}
         }
 
-	lxc_rename_phys_nics_on_shutdown(netnsfd, handler->conf);
-	if (netnsfd >= 0)
-		close(netnsfd);
+	/*
+	 * A warm reboot keeps the net namespace, with its interfaces and
+	 * conntrack state, the cgroups and the ttys.  Only a private net
+	 * namespace is worth keeping.  Not with a user namespace, as the
+	 * next boot creates a new one which would not own the kept netns.
+	 */
+	if (handler->conf->reboot && handler->conf->warm_reboot &&
+	    !handler->conf->is_execute && netnsfd >= 0 &&
+	    lxc_list_empty(&handler->conf->id_map) && !am_unpriv() &&
+	    !lxc_list_empty(&handler->conf->network) &&
+	    handler->conf->inherit_ns_fd[LXC_NS_NET] == -1) {
+		INFO("Keeping the network, cgroups and ttys of '%s' across the reboot", name);
+		handler->warm_reboot = 1;
+		fcntl(netnsfd, F_SETFD, FD_CLOEXEC);
+		handler->conf->warm_netns_fd = netnsfd;
+	} else {
+		lxc_rename_phys_nics_on_shutdown(netnsfd, handler->conf);
+		if (netnsfd >= 0)
+			close(netnsfd);
+	}
 
 	if (handler->pinfd >= 0) {
 		close(handler->pinfd);
@@ -1101,7 +1374,8 @@ int __lxc_start(const char *name, struct lxc_conf *conf,
 
 	err =  lxc_error_set_and_log(handler->pid, status);
 out_fini:
-	lxc_delete_network(handler);
+	if (!handler->warm_reboot)
+		lxc_delete_network(handler);
 
 out_fini_nonet:
 	lxc_fini(name, handler);
@@ -1119,19 +1393,22 @@ struct start_args {
 static int start(struct lxc_handler *handler, void* data)
 {
 	struct start_args *arg = data;
+	char *const *argv = handler->park_argv ? handler->park_argv : arg->argv;
 
-	NOTICE("exec'ing '%s'", arg->argv[0]);
+	NOTICE("exec'ing '%s'", argv[0]);
+	lxc_log_flush();
 
-	execvp(arg->argv[0], arg->argv);
-	SYSERROR("failed to exec %s", arg->argv[0]);
+	execvp(argv[0], argv);
+	SYSERROR("failed to exec %s", argv[0]);
 	return 0;
 }
 
 static int post_start(struct lxc_handler *handler, void* data)
 {
 	struct start_args *arg = data;
+	char *const *argv = handler->park_argv ? handler->park_argv : arg->argv;
 
-	NOTICE("'%s' started with pid '%d'", arg->argv[0], handler->pid);
+	NOTICE("'%s' started with pid '%d'", argv[0], handler->pid);
 	return 0;
 }
 
@@ -34,6 +34,8 @@ struct lxc_conf;
 
 struct lxc_handler;
 
+struct lxc_trace;
+
 struct lxc_operations {
 	int (*start)(struct lxc_handler *, void *);
 	int (*post_start)(struct lxc_handler *, void *);
@@ -70,13 +72,18 @@ struct lxc_handler {
 	void *data;
 	int sv[2];
 	int pinfd;
+	int runningfd;
 	const char *lxcpath;
 	void *cgroup_data;
+	struct lxc_trace *trace;
+	char **park_argv;	/* command given when unparking */
+	int warm_reboot;	/* keep the netns, cgroups and ttys for the next boot */
 };
 
 extern struct lxc_handler *lxc_init(const char *name, struct lxc_conf *, const char *);
 
 extern int lxc_check_inherited(struct lxc_conf *conf, int fd_to_ignore);
+extern int lxc_unpark(struct lxc_handler *handler, const char *args, int len);
 int __lxc_start(const char *, struct lxc_conf *, struct lxc_operations *,
 		void *, const char *);
 
@@ -25,6 +25,10 @@
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -39,12 +43,14 @@
 #include "monitor.h"
 #include "commands.h"
 #include "config.h"
+#include "lxclock.h"
+#include "utils.h"
 
 lxc_log_define(lxc_state, lxc);
 
 static const char * const strstate[] = {
 	"STOPPED", "STARTING", "RUNNING", "STOPPING",
-	"ABORTING", "FREEZING", "FROZEN", "THAWED",
+	"ABORTING", "FREEZING", "FROZEN", "THAWED", "PARKED",
 };
 
 const char *lxc_state2str(lxc_state_t state)
@@ -67,16 +73,22 @@ lxc_state_t lxc_str2state(const char *state)
 	return -1;
 }
 
-lxc_state_t lxc_getstate(const char *name, const char *lxcpath)
+lxc_state_t lxc_getstate_conn(struct lxc_cmd_conn *conn, const char *name,
+			      const char *lxcpath)
 {
 	extern lxc_state_t freezer_state(const char *name, const char *lxcpath);
 
 	lxc_state_t state = freezer_state(name, lxcpath);
 	if (state != FROZEN && state != FREEZING)
-		state = lxc_cmd_get_state(name, lxcpath);
+		state = lxc_cmd_conn_get_state(conn, name, lxcpath);
 	return state;
 }
 
+lxc_state_t lxc_getstate(const char *name, const char *lxcpath)
+{
+	return lxc_getstate_conn(NULL, name, lxcpath);
+}
+
 static int fillwaitedstates(const char *strstates, int *states)
 {
 	char *token, *saveptr = NULL;
@@ -103,27 +115,42 @@ static int fillwaitedstates(const char *strstates, int *states)
 	return 0;
 }
 
-extern int lxc_wait(const char *lxcname, const char *states, int timeout, const char *lxcpath)
+#define WAIT_MSGS 32
+
+int lxc_wait_ms(const char *lxcname, const char *states, int timeout,
+		const char *lxcpath)
 {
-	struct lxc_msg msg;
-	int state, ret;
-	int s[MAX_STATE] = { }, fd;
+	struct lxc_msg msgs[WAIT_MSGS];
+	struct timespec now, deadline;
+	int state, ret, i, n;
+	int s[MAX_STATE] = { }, epfd, fd;
 
 	if (fillwaitedstates(states, s))
 		return -1;
 
-	if (lxc_monitord_spawn(lxcpath))
+	epfd = lxc_monitor_epoll_create();
+	if (epfd < 0)
 		return -1;
 
-	fd = lxc_monitor_open(lxcpath);
+	ret = -1;
+	fd = lxc_monitor_epoll_add(epfd, lxcpath);
 	if (fd < 0)
-		return -1;
+		goto out_close_epfd;
+
+	if (timeout != -1) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += timeout / 1000;
+		deadline.tv_nsec += (timeout % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
 
 	/*
 	 * if container present,
 	 * then check if already in requested state
 	 */
-	ret = -1;
 	state = lxc_getstate(lxcname, lxcpath);
 	if (state < 0) {
 		goto out_close;
@@ -133,65 +160,404 @@ extern int lxc_wait(const char *lxcname, const char *states, int timeout, const
 	}
 
 	for (;;) {
-		int elapsed_time, curtime = 0;
-		struct timeval tv;
-		int stop = 0;
-		int retval;
-
 		if (timeout != -1) {
-			retval = gettimeofday(&tv, NULL);
-			if (retval)
-				goto out_close;
-			curtime = tv.tv_sec;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			timeout = (deadline.tv_sec - now.tv_sec) * 1000 +
+				  (deadline.tv_nsec - now.tv_nsec) / 1000000;
+			if (timeout < 0)
+				timeout = 0;
+		}
+
+		n = lxc_monitor_read_epoll(epfd, msgs, NULL, WAIT_MSGS, timeout);
+		if (n == -2) {
+			ret = -2;
+			goto out_close;
 		}
-		if (lxc_monitor_read_timeout(fd, &msg, timeout) < 0) {
-			/* try again if select interrupted by signal */
+		if (n < 0) {
+			/* try again if interrupted by signal */
 			if (errno != EINTR)
 				goto out_close;
+			continue;
 		}
 
-		if (timeout != -1) {
-			retval = gettimeofday(&tv, NULL);
-			if (retval)
-				goto out_close;
-			elapsed_time = tv.tv_sec - curtime;
-			if (timeout - elapsed_time <= 0)
-				stop = 1;
-			timeout -= elapsed_time;
-		}
+		for (i = 0; i < n; i++) {
+			if (strncmp(lxcname, msgs[i].name, sizeof(msgs[i].name)))
+				continue;
 
-		if (strcmp(lxcname, msg.name)) {
-			if (stop) {
-				ret = -2;
-				goto out_close;
+			switch (msgs[i].type) {
+			case lxc_msg_state:
+				if (msgs[i].value < 0 || msgs[i].value >= MAX_STATE) {
+					ERROR("Receive an invalid state number '%d'",
+						msgs[i].value);
+					goto out_close;
+				}
+
+				if (s[msgs[i].value]) {
+					ret = 0;
+					goto out_close;
+				}
+				break;
+			default:
+				/* just ignore garbage */
+				break;
 			}
-			continue;
 		}
+	}
 
-		switch (msg.type) {
-		case lxc_msg_state:
-			if (msg.value < 0 || msg.value >= MAX_STATE) {
-				ERROR("Receive an invalid state number '%d'",
-					msg.value);
-				goto out_close;
-			}
+out_close:
+	lxc_monitor_close(fd);
+out_close_epfd:
+	close(epfd);
+	return ret;
+}
 
-			if (s[msg.value]) {
-				ret = 0;
-				goto out_close;
+extern int lxc_wait(const char *lxcname, const char *states, int timeout, const char *lxcpath)
+{
+	return lxc_wait_ms(lxcname, states, timeout == -1 ? -1 : timeout * 1000,
+			   lxcpath);
+}
+
+/*
+ * Opt-in state cache.
+ *
+ * A subscriber thread listens to the monitor socket of an lxcpath and
+ * records each state change it hears of, so state() can be answered from
+ * memory instead of a freezer read plus a command socket round trip.
+ *
+ * Entries are allocated once and never freed, and their state is a single
+ * 64-bit word, (timestamp in ms << 8) | state, or 0 when unknown.  The
+ * slot table pointing to them is only ever replaced, never modified in
+ * place except for filling empty slots, so readers take no lock; only
+ * adding an entry takes the cache mutex.  A cached state is used only
+ * while younger than the cache's max_age, and only while the subscriber
+ * is connected, so states changed behind the monitor's back (freezer
+ * written by hand, lxc-start killed) are picked up within max_age.
+ */
+struct state_cache_entry {
+	char name[NAME_MAX+1];
+	uint64_t value;
+};
+
+struct state_cache_table {
+	struct state_cache_table *prev;	/* retired tables, freed never */
+	unsigned int size;		/* power of two */
+	unsigned int count;
+	struct state_cache_entry *slots[];
+};
+
+struct state_cache {
+	struct state_cache *next;
+	char *lxcpath;
+	struct state_cache_table *table;
+	pthread_mutex_t lock;
+	pthread_t thread;
+	int stop[2];
+	int max_age;
+	pid_t pid;
+	int enabled;
+	int connected;
+};
+
+static struct state_cache *state_caches;
+
+static uint64_t state_cache_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static struct state_cache *state_cache_find(const char *lxcpath)
+{
+	struct state_cache *cache;
+
+	for (cache = __atomic_load_n(&state_caches, __ATOMIC_ACQUIRE); cache;
+	     cache = cache->next)
+		if (strcmp(cache->lxcpath, lxcpath) == 0)
+			return cache;
+	return NULL;
+}
+
+static struct state_cache_entry *state_cache_lookup(struct state_cache *cache,
+						    const char *name)
+{
+	struct state_cache_table *t;
+	struct state_cache_entry *e;
+	unsigned int i;
+
+	t = __atomic_load_n(&cache->table, __ATOMIC_ACQUIRE);
+	i = fnv_64a_buf((void *)name, strlen(name), FNV1A_64_INIT) & (t->size - 1);
+	while ((e = __atomic_load_n(&t->slots[i], __ATOMIC_ACQUIRE))) {
+		if (strcmp(e->name, name) == 0)
+			return e;
+		i = (i + 1) & (t->size - 1);
+	}
+	return NULL;
+}
+
+static void state_cache_slot_add(struct state_cache_table *t,
+				 struct state_cache_entry *e)
+{
+	unsigned int i;
+
+	i = fnv_64a_buf(e->name, strlen(e->name), FNV1A_64_INIT) & (t->size - 1);
+	while (t->slots[i])
+		i = (i + 1) & (t->size - 1);
+	__atomic_store_n(&t->slots[i], e, __ATOMIC_RELEASE);
+	t->count++;
+}
+
+static struct state_cache_table *state_cache_table_new(unsigned int size)
+{
+	struct state_cache_table *t;
+
+	t = calloc(1, sizeof(*t) + size * sizeof(struct state_cache_entry *));
+	if (t)
+		t->size = size;
+	return t;
+}
+
+static struct state_cache_entry *state_cache_add(struct state_cache *cache,
+						 const char *name)
+{
+	struct state_cache_table *t, *nt;
+	struct state_cache_entry *e;
+	unsigned int i;
+
+	if (strlen(name) > NAME_MAX)
+		return NULL;
+
+	pthread_mutex_lock(&cache->lock);
+	e = state_cache_lookup(cache, name);
+	if (e)
+		goto out;
+
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		goto out;
+	strcpy(e->name, name);
+
+	t = cache->table;
+	if ((t->count + 1) * 2 > t->size) {
+		nt = state_cache_table_new(t->size * 2);
+		if (!nt) {
+			free(e);
+			e = NULL;
+			goto out;
+		}
+		for (i = 0; i < t->size; i++)
+			if (t->slots[i])
+				state_cache_slot_add(nt, t->slots[i]);
+		/* readers may still walk the old table */
+		nt->prev = t;
+		t = nt;
+		__atomic_store_n(&cache->table, nt, __ATOMIC_RELEASE);
+	}
+	state_cache_slot_add(t, e);
+
+out:
+	pthread_mutex_unlock(&cache->lock);
+	return e;
+}
+
+static void state_cache_forget_all(struct state_cache *cache)
+{
+	struct state_cache_table *t;
+	unsigned int i;
+
+	pthread_mutex_lock(&cache->lock);
+	t = cache->table;
+	for (i = 0; i < t->size; i++)
+		if (t->slots[i])
+			__atomic_store_n(&t->slots[i]->value, 0, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+static void *state_cache_subscriber(void *arg)
+{
+	struct state_cache *cache = arg;
+	struct state_cache_entry *e;
+	struct pollfd fds[2];
+	struct lxc_msg msg;
+	int fd = -1, ret, retry = 1000;
+
+	fds[1].fd = cache->stop[0];
+	fds[1].events = POLLIN;
+
+	for (;;) {
+		if (fd < 0) {
+			if (lxc_monitord_spawn(cache->lxcpath) == 0)
+				fd = lxc_monitor_open(cache->lxcpath);
+			if (fd >= 0) {
+				/* changes may have been missed while away */
+				state_cache_forget_all(cache);
+				__atomic_store_n(&cache->connected, 1, __ATOMIC_RELEASE);
+				retry = 1000;
 			}
+		}
+
+		fds[0].fd = fd;
+		fds[0].events = POLLIN;
+		ret = poll(fds, 2, fd < 0 ? retry : -1);
+		if (fd < 0 && retry < 60000)
+			retry *= 2;
+		if (ret < 0 && errno != EINTR)
 			break;
-		default:
-			if (stop) {
-				ret = -2;
-				goto out_close;
-			}
-			/* just ignore garbage */
+		if (fds[1].revents)
 			break;
+		if (fd < 0 || ret <= 0 || !fds[0].revents)
+			continue;
+
+		ret = recv(fd, &msg, sizeof(msg), MSG_WAITALL);
+		if (ret != sizeof(msg)) {
+			WARN("lost the monitor for %s, reconnecting", cache->lxcpath);
+			__atomic_store_n(&cache->connected, 0, __ATOMIC_RELEASE);
+			lxc_monitor_close(fd);
+			fd = -1;
+			continue;
+		}
+
+		if (msg.type != lxc_msg_state || msg.value < 0 ||
+		    msg.value >= MAX_STATE)
+			continue;
+		msg.name[sizeof(msg.name) - 1] = '\0';
+
+		/* a thawed container is running, as lxc_getstate() says */
+		if (msg.value == THAWED)
+			msg.value = RUNNING;
+
+		e = state_cache_lookup(cache, msg.name);
+		if (!e)
+			e = state_cache_add(cache, msg.name);
+		if (e)
+			__atomic_store_n(&e->value,
+					 state_cache_now() << 8 | msg.value,
+					 __ATOMIC_RELEASE);
+	}
+
+	__atomic_store_n(&cache->connected, 0, __ATOMIC_RELEASE);
+	if (fd >= 0)
+		lxc_monitor_close(fd);
+	return NULL;
+}
+
+int lxc_state_cache_start(const char *lxcpath, int max_age)
+{
+	struct state_cache *cache;
+	int ret = -1;
+
+	process_lock();
+	cache = state_cache_find(lxcpath);
+	if (!cache) {
+		cache = calloc(1, sizeof(*cache));
+		if (!cache)
+			goto out;
+		cache->lxcpath = strdup(lxcpath);
+		cache->table = state_cache_table_new(64);
+		if (!cache->lxcpath || !cache->table) {
+			free(cache->lxcpath);
+			free(cache->table);
+			free(cache);
+			goto out;
 		}
+		pthread_mutex_init(&cache->lock, NULL);
+		cache->next = state_caches;
+		__atomic_store_n(&state_caches, cache, __ATOMIC_RELEASE);
 	}
 
-out_close:
-	lxc_monitor_close(fd);
+	cache->max_age = max_age;
+	if (cache->enabled && cache->pid == getpid()) {
+		ret = 0;
+		goto out;
+	}
+
+	if (pipe(cache->stop) < 0)
+		goto out;
+	if (fcntl(cache->stop[0], F_SETFD, FD_CLOEXEC) ||
+	    fcntl(cache->stop[1], F_SETFD, FD_CLOEXEC)) {
+		close(cache->stop[0]);
+		close(cache->stop[1]);
+		goto out;
+	}
+	cache->pid = getpid();
+	if (pthread_create(&cache->thread, NULL, state_cache_subscriber, cache)) {
+		close(cache->stop[0]);
+		close(cache->stop[1]);
+		goto out;
+	}
+	__atomic_store_n(&cache->enabled, 1, __ATOMIC_RELEASE);
+	ret = 0;
+
+out:
+	process_unlock();
 	return ret;
 }
+
+void lxc_state_cache_stop(const char *lxcpath)
+{
+	struct state_cache *cache;
+
+	process_lock();
+	cache = state_cache_find(lxcpath);
+	if (!cache || !cache->enabled || cache->pid != getpid()) {
+		process_unlock();
+		return;
+	}
+	__atomic_store_n(&cache->enabled, 0, __ATOMIC_RELEASE);
+	process_unlock();
+
+	if (write(cache->stop[1], "", 1) != 1)
+		WARN("failed to stop the state cache for %s", lxcpath);
+	pthread_join(cache->thread, NULL);
+	close(cache->stop[0]);
+	close(cache->stop[1]);
+	state_cache_forget_all(cache);
+}
+
+void lxc_state_cache_invalidate(const char *name, const char *lxcpath)
+{
+	struct state_cache_entry *e;
+	struct state_cache *cache;
+
+	cache = state_cache_find(lxcpath);
+	if (!cache)
+		return;
+	e = state_cache_lookup(cache, name);
+	if (e)
+		__atomic_store_n(&e->value, 0, __ATOMIC_RELEASE);
+}
+
+lxc_state_t lxc_getstate_cached(struct lxc_cmd_conn *conn, const char *name,
+				const char *lxcpath)
+{
+	struct state_cache_entry *e;
+	struct state_cache *cache;
+	uint64_t now, value;
+	lxc_state_t state;
+
+	cache = state_cache_find(lxcpath);
+	if (!cache || cache->pid != getpid() ||
+	    !__atomic_load_n(&cache->enabled, __ATOMIC_ACQUIRE) ||
+	    !__atomic_load_n(&cache->connected, __ATOMIC_ACQUIRE))
+		return lxc_getstate_conn(conn, name, lxcpath);
+
+	now = state_cache_now();
+	e = state_cache_lookup(cache, name);
+	if (!e)
+		e = state_cache_add(cache, name);
+	if (!e)
+		return lxc_getstate_conn(conn, name, lxcpath);
+
+	value = __atomic_load_n(&e->value, __ATOMIC_ACQUIRE);
+	if (value && (cache->max_age < 0 || now - (value >> 8) <= cache->max_age))
+		return value & 0xff;
+
+	/* don't overwrite a state change the subscriber saw meanwhile */
+	state = lxc_getstate_conn(conn, name, lxcpath);
+	if (state >= 0)
+		__atomic_compare_exchange_n(&e->value, &value, now << 8 | state,
+					    false, __ATOMIC_RELEASE,
+					    __ATOMIC_RELAXED);
+	return state;
+}
@@ -25,14 +25,26 @@
 
 typedef enum {
 	STOPPED, STARTING, RUNNING, STOPPING,
-	ABORTING, FREEZING, FROZEN, THAWED, MAX_STATE,
+	ABORTING, FREEZING, FROZEN, THAWED, PARKED, MAX_STATE,
 } lxc_state_t;
 
+struct lxc_cmd_conn;
+
 extern int lxc_rmstate(const char *name);
 extern lxc_state_t lxc_getstate(const char *name, const char *lxcpath);
+extern lxc_state_t lxc_getstate_conn(struct lxc_cmd_conn *conn,
+				     const char *name, const char *lxcpath);
+
+extern lxc_state_t lxc_getstate_cached(struct lxc_cmd_conn *conn,
+				       const char *name, const char *lxcpath);
+extern int lxc_state_cache_start(const char *lxcpath, int max_age);
+extern void lxc_state_cache_stop(const char *lxcpath);
+extern void lxc_state_cache_invalidate(const char *name, const char *lxcpath);
 
 extern lxc_state_t lxc_str2state(const char *state);
 extern const char *lxc_state2str(lxc_state_t state);
 extern int lxc_wait(const char *lxcname, const char *states, int timeout, const char *lxcpath);
+extern int lxc_wait_ms(const char *lxcname, const char *states, int timeout,
+		       const char *lxcpath);
 
 #endif
@@ -32,6 +32,8 @@ enum {
 	LXC_SYNC_POST_CGROUP,
 	LXC_SYNC_RESTART,
 	LXC_SYNC_POST_RESTART,
+	LXC_SYNC_PARK,
+	LXC_SYNC_POST_PARK,
 };
 
 int lxc_sync_init(struct lxc_handler *handler);
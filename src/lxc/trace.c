@@ -0,0 +1,200 @@
+/*
+ * lxc: linux Container library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "log.h"
+#include "trace.h"
+
+lxc_log_define(lxc_trace, lxc);
+
+static uint64_t trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct lxc_trace *lxc_trace_new(void)
+{
+	struct lxc_trace *trace;
+
+	trace = mmap(NULL, sizeof(*trace), PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (trace == MAP_FAILED) {
+		SYSERROR("failed to allocate the start trace");
+		return NULL;
+	}
+	return trace;
+}
+
+void lxc_trace_free(struct lxc_trace *trace)
+{
+	if (trace)
+		munmap(trace, sizeof(*trace));
+}
+
+int lxc_trace_begin(struct lxc_trace *trace, const char *name)
+{
+	struct lxc_trace_span *span;
+	pid_t pid = getpid();
+	int i, j, parent = -1;
+
+	if (!trace)
+		return -1;
+
+	i = __atomic_fetch_add(&trace->count, 1, __ATOMIC_ACQ_REL);
+	if (i >= LXC_TRACE_SPANS_MAX) {
+		__atomic_store_n(&trace->count, LXC_TRACE_SPANS_MAX, __ATOMIC_RELEASE);
+		return -1;
+	}
+
+	/*
+	 * Nest in our innermost open span, or for the first span of the
+	 * container's init, in the one its parent was in when cloning.
+	 */
+	for (j = i - 1; j >= 0; j--) {
+		if (__atomic_load_n(&trace->spans[j].end, __ATOMIC_ACQUIRE))
+			continue;
+		if (__atomic_load_n(&trace->spans[j].pid, __ATOMIC_ACQUIRE) == pid) {
+			parent = j;
+			break;
+		}
+		if (parent < 0)
+			parent = j;
+	}
+
+	span = &trace->spans[i];
+	strncpy(span->name, name, sizeof(span->name) - 1);
+	span->parent = parent;
+	span->end = 0;
+	span->begin = trace_now();
+	__atomic_store_n(&span->pid, pid, __ATOMIC_RELEASE);
+	return i;
+}
+
+void lxc_trace_end(struct lxc_trace *trace, int span)
+{
+	if (!trace || span < 0 || span >= LXC_TRACE_SPANS_MAX)
+		return;
+	__atomic_store_n(&trace->spans[span].end, trace_now(), __ATOMIC_RELEASE);
+}
+
+int lxc_trace_copy(struct lxc_trace *trace, struct lxc_trace_span *spans)
+{
+	int count, i, n = 0;
+
+	if (!trace)
+		return 0;
+
+	count = __atomic_load_n(&trace->count, __ATOMIC_ACQUIRE);
+	if (count > LXC_TRACE_SPANS_MAX)
+		count = LXC_TRACE_SPANS_MAX;
+
+	/* skip slots taken by a lxc_trace_begin() still filling them */
+	for (i = 0; i < count; i++) {
+		if (!__atomic_load_n(&trace->spans[i].pid, __ATOMIC_ACQUIRE))
+			break;
+		spans[n] = trace->spans[i];
+		spans[n].end = __atomic_load_n(&trace->spans[i].end, __ATOMIC_ACQUIRE);
+		n++;
+	}
+	return n;
+}
+
+/* Print at most max bytes of str as a JSON string */
+static void trace_print_string(FILE *f, const char *str, size_t max)
+{
+	unsigned char c;
+	size_t i;
+
+	fputc('"', f);
+	for (i = 0; i < max && str[i]; i++) {
+		c = str[i];
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+void lxc_trace_print(FILE *f, const char *name,
+		     const struct lxc_trace_span *spans, int count)
+{
+	uint64_t origin;
+	int i;
+
+	if (count <= 0)
+		return;
+	origin = spans[0].begin;
+
+	for (i = 0; i < count; i++) {
+		const struct lxc_trace_span *s = &spans[i];
+
+		fprintf(f, "{\"container\":");
+		trace_print_string(f, name, (size_t)-1);
+		fprintf(f, ",\"span\":");
+		trace_print_string(f, s->name, LXC_TRACE_NAME_MAX);
+		fprintf(f, ",\"pid\":%d,", s->pid);
+		if (s->parent >= 0 && s->parent < count) {
+			fprintf(f, "\"parent\":");
+			trace_print_string(f, spans[s->parent].name,
+					   LXC_TRACE_NAME_MAX);
+			fprintf(f, ",");
+		} else
+			fprintf(f, "\"parent\":null,");
+		fprintf(f, "\"begin_us\":%llu,",
+			(unsigned long long)(s->begin - origin) / 1000);
+		if (s->end)
+			fprintf(f, "\"duration_us\":%llu}\n",
+				(unsigned long long)(s->end - s->begin) / 1000);
+		else
+			fprintf(f, "\"duration_us\":null}\n");
+	}
+}
+
+int lxc_trace_write(struct lxc_trace *trace, const char *name,
+		    const char *path)
+{
+	struct lxc_trace_span spans[LXC_TRACE_SPANS_MAX];
+	FILE *f;
+	int count;
+
+	count = lxc_trace_copy(trace, spans);
+
+	f = fopen(path, "a");
+	if (!f) {
+		SYSERROR("failed to open the trace file '%s'", path);
+		return -1;
+	}
+	lxc_trace_print(f, name, spans, count);
+	if (fclose(f)) {
+		SYSERROR("failed to write the trace file '%s'", path);
+		return -1;
+	}
+	return 0;
+}
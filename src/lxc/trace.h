@@ -0,0 +1,79 @@
+/*
+ * lxc: linux Container library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef __lxc_trace_h
+#define __lxc_trace_h
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define LXC_TRACE_SPANS_MAX	64
+#define LXC_TRACE_NAME_MAX	32
+
+/*
+ * One timed phase of a container start.  Times are CLOCK_MONOTONIC
+ * nanoseconds, end is 0 while the phase is running.
+ */
+struct lxc_trace_span {
+	char name[LXC_TRACE_NAME_MAX];
+	int32_t pid;		/* process which ran the phase */
+	int32_t parent;		/* index of the enclosing span, or -1 */
+	uint64_t begin;
+	uint64_t end;
+};
+
+/*
+ * The spans of one start.  It lives in a shared mapping so that the
+ * phases run by the container's init before it execs are recorded too.
+ */
+struct lxc_trace {
+	int count;
+	struct lxc_trace_span spans[LXC_TRACE_SPANS_MAX];
+};
+
+extern struct lxc_trace *lxc_trace_new(void);
+extern void lxc_trace_free(struct lxc_trace *trace);
+
+/*
+ * Open a span named @name, nested in the innermost span still open in
+ * the calling process.  Returns the span to close, < 0 if it could not
+ * be recorded (no trace, or too many spans), which lxc_trace_end ignores.
+ */
+extern int lxc_trace_begin(struct lxc_trace *trace, const char *name);
+extern void lxc_trace_end(struct lxc_trace *trace, int span);
+
+/*
+ * Copy the spans recorded so far to @spans, which must hold
+ * LXC_TRACE_SPANS_MAX entries.  Returns the number of spans copied.
+ */
+extern int lxc_trace_copy(struct lxc_trace *trace, struct lxc_trace_span *spans);
+
+/*
+ * Print @spans as JSON lines, one object per span, with times in
+ * microseconds relative to the first span.
+ */
+extern void lxc_trace_print(FILE *f, const char *name,
+			    const struct lxc_trace_span *spans, int count);
+
+/*
+ * Append the spans of @trace to the file at @path as JSON lines.
+ * Returns 0 on success, < 0 otherwise
+ */
+extern int lxc_trace_write(struct lxc_trace *trace, const char *name,
+			   const char *path);
+
+#endif
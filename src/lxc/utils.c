@@ -242,6 +242,7 @@ const char *lxc_global_config_value(const char *option_name)
 		{ "lxc.default_config",     NULL            },
 		{ "lxc.cgroup.pattern",     DEFAULT_CGROUP_PATTERN },
 		{ "lxc.cgroup.use",         NULL            },
+		{ "lxc.config_cache",       "0"             },
 		{ NULL, NULL },
 	};
 
@@ -916,7 +917,7 @@ char **lxc_string_split(const char *string, char _sep)
 {
 	char *token, *str, *saveptr = NULL;
 	char sep[2] = { _sep, '\0' };
-	char **result = NULL;
+	char **result = NULL, **p;
 	size_t result_capacity = 0;
 	size_t result_count = 0;
 	int r, saved_errno;
@@ -936,8 +937,13 @@ char **lxc_string_split(const char *string, char _sep)
 		result_count++;
 	}
 
-	/* if we allocated too much, reduce it */
-	return realloc(result, (result_count + 1) * sizeof(char *));
+	/* if we allocated too much, reduce it; for an empty string nothing
+	 * was allocated yet and the terminating NULL must be set here */
+	p = realloc(result, (result_count + 1) * sizeof(char *));
+	if (!p)
+		goto error_out;
+	p[result_count] = NULL;
+	return p;
 error_out:
 	saved_errno = errno;
 	lxc_free_array((void **)result, free);
@@ -949,7 +955,7 @@ char **lxc_string_split_and_trim(const char *string, char _sep)
 {
 	char *token, *str, *saveptr = NULL;
 	char sep[2] = { _sep, '\0' };
-	char **result = NULL;
+	char **result = NULL, **p;
 	size_t result_capacity = 0;
 	size_t result_count = 0;
 	int r, saved_errno;
@@ -977,8 +983,13 @@ char **lxc_string_split_and_trim(const char *string, char _sep)
 		result_count++;
 	}
 
-	/* if we allocated too much, reduce it */
-	return realloc(result, (result_count + 1) * sizeof(char *));
+	/* if we allocated too much, reduce it; for an empty string nothing
+	 * was allocated yet and the terminating NULL must be set here */
+	p = realloc(result, (result_count + 1) * sizeof(char *));
+	if (!p)
+		goto error_out;
+	p[result_count] = NULL;
+	return p;
 error_out:
 	saved_errno = errno;
 	lxc_free_array((void **)result, free);
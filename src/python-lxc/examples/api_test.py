@@ -140,6 +140,13 @@ max_mem = container.get_cgroup_item("memory.max_usage_in_bytes")
 current_limit = container.get_cgroup_item("memory.limit_in_bytes")
 assert(container.set_cgroup_item("memory.limit_in_bytes", max_mem))
 assert(container.get_cgroup_item("memory.limit_in_bytes") != current_limit)
+items = container.get_cgroup_items(["memory.limit_in_bytes",
+                                     "memory.max_usage_in_bytes",
+                                     "memory.no_such_file"])
+assert(items["memory.limit_in_bytes"] ==
+       container.get_cgroup_item("memory.limit_in_bytes"))
+assert("memory.max_usage_in_bytes" in items)
+assert("memory.no_such_file" not in items)
 
 ## Freezing the container
 print("Freezing the container")
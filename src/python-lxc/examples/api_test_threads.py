@@ -0,0 +1,106 @@
+#!/usr/bin/python3
+#
+# api_test_threads.py: Drive several containers from Python threads
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+# USA
+#
+
+import lxc
+import sys
+import threading
+import time
+import uuid
+
+THREADS = 8
+if len(sys.argv) > 1:
+    THREADS = int(sys.argv[1])
+
+## A thread blocked in liblxc must not hold the GIL
+print("Checking that a blocked wait() lets other threads run")
+idle = lxc.Container(str(uuid.uuid1()))
+assert(not idle.defined)
+
+waiter = threading.Thread(target=idle.wait, args=("RUNNING", 3))
+start = time.time()
+waiter.start()
+
+ticks = 0
+while waiter.is_alive() and time.time() - start < 2:
+    ticks += 1
+
+# while holding the GIL, the waiter would have kept us out for 3 seconds
+assert(waiter.is_alive())
+assert(ticks > 1000)
+waiter.join()
+
+## Run the whole life cycle of a container in each thread
+print("Running %d containers from %d threads" % (THREADS, THREADS))
+errors = []
+
+
+def lifecycle(name):
+    def check(cond, what):
+        if not cond:
+            raise Exception("%s: %s failed" % (name, what))
+
+    container = lxc.Container(name)
+    try:
+        check(container.create("busybox"), "create")
+        check(container.start(), "start")
+        check(container.wait("RUNNING", 10), "wait RUNNING")
+
+        check(container.init_pid > 1, "init_pid")
+        check(container.state == "RUNNING", "state")
+        check(name in lxc.list_containers(active=True, defined=False),
+              "list_containers")
+        container.get_ips()
+
+        check(container.freeze(), "freeze")
+        check(container.wait("FROZEN", 10), "wait FROZEN")
+        check(container.unfreeze(), "unfreeze")
+        check(container.wait("RUNNING", 10), "wait RUNNING")
+
+        if not container.shutdown(1):
+            check(container.stop(), "stop")
+        check(container.wait("STOPPED", 10), "wait STOPPED")
+    except Exception as e:
+        errors.append(str(e))
+    finally:
+        if container.running:
+            container.stop()
+        if container.defined:
+            container.destroy()
+
+
+names = [str(uuid.uuid1()) for i in range(THREADS)]
+threads = [threading.Thread(target=lifecycle, args=(name,))
+           for name in names]
+
+start = time.time()
+for thread in threads:
+    thread.start()
+for thread in threads:
+    thread.join()
+elapsed = time.time() - start
+
+for error in errors:
+    print(error)
+assert(not errors)
+
+for name in names:
+    assert(not lxc.Container(name).defined)
+
+print("%d containers in %.1fs" % (THREADS, elapsed))
@@ -378,12 +378,14 @@ LXC_list_containers(PyObject *self, PyObject *args, PyObject *kwds)
     }
 
     /* Call the right API function based on filters */
+    Py_BEGIN_ALLOW_THREADS
     if (list_active == 1 && list_defined == 1)
         list_count = list_all_containers(config_path, &names, NULL);
     else if (list_active == 1)
         list_count = list_active_containers(config_path, &names, NULL);
     else if (list_defined == 1)
         list_count = list_defined_containers(config_path, &names, NULL);
+    Py_END_ALLOW_THREADS
 
     /* Handle failure */
     if (list_count < 0) {
@@ -433,7 +435,9 @@ Container_init(Container *self, PyObject *args, PyObject *kwds)
         assert(config_path != NULL);
     }
 
+    Py_BEGIN_ALLOW_THREADS
     self->container = lxc_container_new(name, config_path);
+    Py_END_ALLOW_THREADS
     if (!self->container) {
         Py_XDECREF(fs_config_path);
         fprintf(stderr, "%d: error creating container %s\n", __LINE__, name);
@@ -485,7 +489,13 @@ Container_defined(Container *self, void *closure)
 static PyObject *
 Container_init_pid(Container *self, void *closure)
 {
-    return PyLong_FromLong(self->container->init_pid(self->container));
+    pid_t pid;
+
+    Py_BEGIN_ALLOW_THREADS
+    pid = self->container->init_pid(self->container);
+    Py_END_ALLOW_THREADS
+
+    return PyLong_FromLong(pid);
 }
 
 static PyObject *
@@ -497,7 +507,13 @@ Container_name(Container *self, void *closure)
 static PyObject *
 Container_running(Container *self, void *closure)
 {
-    if (self->container->is_running(self->container)) {
+    bool ret;
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->is_running(self->container);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -507,7 +523,13 @@ Container_running(Container *self, void *closure)
 static PyObject *
 Container_state(Container *self, void *closure)
 {
-    return PyUnicode_FromString(self->container->state(self->container));
+    const char *state;
+
+    Py_BEGIN_ALLOW_THREADS
+    state = self->container->state(self->container);
+    Py_END_ALLOW_THREADS
+
+    return PyUnicode_FromString(state);
 }
 
 /* Container Functions */
@@ -515,6 +537,7 @@ static PyObject *
 Container_add_device_node(Container *self, PyObject *args, PyObject *kwds)
 {
     static char *kwlist[] = {"src_path", "dest_path", NULL};
+    bool ret;
     char *src_path = NULL;
     char *dst_path = NULL;
     PyObject *py_src_path = NULL;
@@ -535,8 +558,12 @@ Container_add_device_node(Container *self, PyObject *args, PyObject *kwds)
         assert(dst_path != NULL);
     }
 
-    if (self->container->add_device_node(self->container, src_path,
-                                         dst_path)) {
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->add_device_node(self->container, src_path,
+                                           dst_path);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_XDECREF(py_src_path);
         Py_XDECREF(py_dst_path);
         Py_RETURN_TRUE;
@@ -567,13 +594,16 @@ Container_attach_and_possibly_wait(Container *self, PyObject *args,
     if (!options)
         return NULL;
 
+    /* the payload is run by the attached child, with our GIL */
     ret = self->container->attach(self->container, lxc_attach_python_exec,
                                   &payload, options, &pid);
     if (ret < 0)
         goto out;
 
     if (wait) {
+        Py_BEGIN_ALLOW_THREADS
         ret = lxc_wait_for_pid_status(pid);
+        Py_END_ALLOW_THREADS
         /* handle case where attach fails */
         if (WIFEXITED(ret) && WEXITSTATUS(ret) == 255)
             ret = -1;
@@ -666,9 +696,11 @@ Container_clone(Container *self, PyObject *args, PyObject *kwds)
         assert(config_path != NULL);
     }
 
+    Py_BEGIN_ALLOW_THREADS
     new_container = self->container->clone(self->container, newname,
                                            config_path, flags, bdevtype,
                                            bdevdata, newsize, hookargs);
+    Py_END_ALLOW_THREADS
 
     Py_XDECREF(py_config_path);
 
@@ -693,14 +725,19 @@ Container_console(Container *self, PyObject *args, PyObject *kwds)
     static char *kwlist[] = {"ttynum", "stdinfd", "stdoutfd", "stderrfd",
                              "escape", NULL};
     int ttynum = -1, stdinfd = 0, stdoutfd = 1, stderrfd = 2, escape = 1;
+    int ret;
 
     if (! PyArg_ParseTupleAndKeywords(args, kwds, "|iiiii", kwlist,
                                       &ttynum, &stdinfd, &stdoutfd, &stderrfd,
                                       &escape))
         return NULL;
 
-    if (self->container->console(self->container, ttynum,
-            stdinfd, stdoutfd, stderrfd, escape) == 0) {
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->console(self->container, ttynum,
+            stdinfd, stdoutfd, stderrfd, escape);
+    Py_END_ALLOW_THREADS
+
+    if (ret == 0) {
         Py_RETURN_TRUE;
     }
     Py_RETURN_FALSE;
@@ -731,6 +768,7 @@ Container_create(Container *self, PyObject *args, PyObject *kwds)
     char** create_args = {NULL};
     PyObject *retval = NULL, *vargs = NULL;
     int i = 0;
+    bool ret;
     static char *kwlist[] = {"template", "flags", "args", NULL};
 
     if (! PyArg_ParseTupleAndKeywords(args, kwds, "s|iO", kwlist,
@@ -750,8 +788,12 @@ Container_create(Container *self, PyObject *args, PyObject *kwds)
         }
     }
 
-    if (self->container->create(self->container, template_name, NULL, NULL,
-                                flags, create_args))
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->create(self->container, template_name, NULL, NULL,
+                                  flags, create_args);
+    Py_END_ALLOW_THREADS
+
+    if (ret)
         retval = Py_True;
     else
         retval = Py_False;
@@ -772,7 +814,13 @@ Container_create(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_destroy(Container *self, PyObject *args, PyObject *kwds)
 {
-    if (self->container->destroy(self->container)) {
+    bool ret;
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->destroy(self->container);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -782,7 +830,13 @@ Container_destroy(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_freeze(Container *self, PyObject *args, PyObject *kwds)
 {
-    if (self->container->freeze(self->container)) {
+    bool ret;
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->freeze(self->container);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -824,6 +878,55 @@ Container_get_cgroup_item(Container *self, PyObject *args, PyObject *kwds)
     return ret;
 }
 
+static PyObject *
+Container_get_cgroup_items(Container *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"keys", NULL};
+    PyObject *keys = NULL;
+    PyObject *dict = NULL;
+    char **keys_array = NULL;
+    struct lxc_cgroup_item *items = NULL;
+    int count = 0;
+    int i = 0;
+
+    if (! PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist,
+                                      &keys))
+        return NULL;
+
+    keys_array = convert_tuple_to_char_pointer_array(keys);
+    if (!keys_array)
+        return NULL;
+
+    count = self->container->get_cgroup_items(self->container,
+                                              (const char **)keys_array,
+                                              &items);
+
+    for (i = 0; keys_array[i]; i++)
+        free(keys_array[i]);
+    free(keys_array);
+
+    if (count < 0) {
+        PyErr_SetString(PyExc_KeyError, "Unable to read cgroup entries");
+        return NULL;
+    }
+
+    dict = PyDict_New();
+    for (i = 0; i < count; i++) {
+        if (dict && items[i].value) {
+            PyObject *value = PyUnicode_FromString(items[i].value);
+
+            if (!value || PyDict_SetItemString(dict, items[i].key, value)) {
+                Py_CLEAR(dict);
+            }
+            Py_XDECREF(value);
+        }
+        items[i].free(&items[i]);
+    }
+    free(items);
+
+    return dict;
+}
+
 static PyObject *
 Container_get_config_item(Container *self, PyObject *args, PyObject *kwds)
 {
@@ -914,7 +1017,9 @@ Container_get_interfaces(Container *self)
     PyObject* ret;
 
     /* Get the interfaces */
+    Py_BEGIN_ALLOW_THREADS
     interfaces = self->container->get_interfaces(self->container);
+    Py_END_ALLOW_THREADS
     if (!interfaces)
         return PyTuple_New(0);
 
@@ -969,7 +1074,9 @@ Container_get_ips(Container *self, PyObject *args, PyObject *kwds)
         return NULL;
 
     /* Get the IPs */
+    Py_BEGIN_ALLOW_THREADS
     ips = self->container->get_ips(self->container, interface, family, scope);
+    Py_END_ALLOW_THREADS
     if (!ips)
         return PyTuple_New(0);
 
@@ -1019,7 +1126,9 @@ Container_get_running_config_item(Container *self, PyObject *args,
                                       &key))
         return NULL;
 
+    Py_BEGIN_ALLOW_THREADS
     value = self->container->get_running_config_item(self->container, key);
+    Py_END_ALLOW_THREADS
 
     if (!value)
         Py_RETURN_NONE;
@@ -1058,7 +1167,13 @@ Container_load_config(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_reboot(Container *self, PyObject *args, PyObject *kwds)
 {
-    if (self->container->reboot(self->container)) {
+    bool ret;
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->reboot(self->container);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -1068,6 +1183,7 @@ Container_reboot(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_rename(Container *self, PyObject *args, PyObject *kwds)
 {
+    bool ret;
     char *new_name = NULL;
     static char *kwlist[] = {"new_name", NULL};
 
@@ -1075,7 +1191,11 @@ Container_rename(Container *self, PyObject *args, PyObject *kwds)
                                       &new_name))
         return NULL;
 
-    if (self->container->rename(self->container, new_name)) {
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->rename(self->container, new_name);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -1086,6 +1206,7 @@ static PyObject *
 Container_remove_device_node(Container *self, PyObject *args, PyObject *kwds)
 {
     static char *kwlist[] = {"src_path", "dest_path", NULL};
+    bool ret;
     char *src_path = NULL;
     char *dst_path = NULL;
     PyObject *py_src_path = NULL;
@@ -1106,8 +1227,12 @@ Container_remove_device_node(Container *self, PyObject *args, PyObject *kwds)
         assert(dst_path != NULL);
     }
 
-    if (self->container->remove_device_node(self->container, src_path,
-                                            dst_path)) {
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->remove_device_node(self->container, src_path,
+                                              dst_path);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_XDECREF(py_src_path);
         Py_XDECREF(py_dst_path);
         Py_RETURN_TRUE;
@@ -1199,6 +1324,7 @@ Container_set_config_path(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_shutdown(Container *self, PyObject *args, PyObject *kwds)
 {
+    bool ret;
     static char *kwlist[] = {"timeout", NULL};
     int timeout = -1;
 
@@ -1206,7 +1332,11 @@ Container_shutdown(Container *self, PyObject *args, PyObject *kwds)
                                       &timeout))
         return NULL;
 
-    if (self->container->shutdown(self->container, timeout)) {
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->shutdown(self->container, timeout);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -1232,7 +1362,9 @@ Container_snapshot(Container *self, PyObject *args, PyObject *kwds)
         assert(comment_path != NULL);
     }
 
+    Py_BEGIN_ALLOW_THREADS
     retval = self->container->snapshot(self->container, comment_path);
+    Py_END_ALLOW_THREADS
 
     Py_XDECREF(py_comment_path);
 
@@ -1251,6 +1383,7 @@ Container_snapshot(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_snapshot_destroy(Container *self, PyObject *args, PyObject *kwds)
 {
+    bool ret;
     char *name = NULL;
     static char *kwlist[] = {"name", NULL};
 
@@ -1258,7 +1391,11 @@ Container_snapshot_destroy(Container *self, PyObject *args, PyObject *kwds)
                                       &name))
         return NULL;
 
-    if (self->container->snapshot_destroy(self->container, name)) {
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->snapshot_destroy(self->container, name);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -1273,7 +1410,9 @@ Container_snapshot_list(Container *self, PyObject *args, PyObject *kwds)
     PyObject *list = NULL;
     int i = 0;
 
+    Py_BEGIN_ALLOW_THREADS
     snap_count = self->container->snapshot_list(self->container, &snap);
+    Py_END_ALLOW_THREADS
 
     if (snap_count < 0) {
         PyErr_SetString(PyExc_KeyError, "Unable to list snapshots");
@@ -1306,6 +1445,7 @@ Container_snapshot_list(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_snapshot_restore(Container *self, PyObject *args, PyObject *kwds)
 {
+    bool ret;
     char *name = NULL;
     char *newname = NULL;
     static char *kwlist[] = {"name", "newname", NULL};
@@ -1314,7 +1454,11 @@ Container_snapshot_restore(Container *self, PyObject *args, PyObject *kwds)
                                       &name, &newname))
         return NULL;
 
-    if (self->container->snapshot_restore(self->container, name, newname)) {
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->snapshot_restore(self->container, name, newname);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -1333,6 +1477,7 @@ Container_start(Container *self, PyObject *args, PyObject *kwds)
 
     PyObject *retval = NULL;
     int init_useinit = 0, i = 0;
+    bool ret;
     static char *kwlist[] = {"useinit", "daemonize", "close_fds",
                              "cmd", NULL};
 
@@ -1366,7 +1511,11 @@ Container_start(Container *self, PyObject *args, PyObject *kwds)
         self->container->want_daemonize(self->container, false);
     }
 
-    if (self->container->start(self->container, init_useinit, init_args))
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->start(self->container, init_useinit, init_args);
+    Py_END_ALLOW_THREADS
+
+    if (ret)
         retval = Py_True;
     else
         retval = Py_False;
@@ -1387,7 +1536,13 @@ Container_start(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_stop(Container *self, PyObject *args, PyObject *kwds)
 {
-    if (self->container->stop(self->container)) {
+    bool ret;
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->stop(self->container);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -1397,7 +1552,13 @@ Container_stop(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_unfreeze(Container *self, PyObject *args, PyObject *kwds)
 {
-    if (self->container->unfreeze(self->container)) {
+    bool ret;
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->unfreeze(self->container);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -1407,6 +1568,7 @@ Container_unfreeze(Container *self, PyObject *args, PyObject *kwds)
 static PyObject *
 Container_wait(Container *self, PyObject *args, PyObject *kwds)
 {
+    bool ret;
     static char *kwlist[] = {"state", "timeout", NULL};
     char *state = NULL;
     int timeout = -1;
@@ -1415,7 +1577,11 @@ Container_wait(Container *self, PyObject *args, PyObject *kwds)
                                       &state, &timeout))
         return NULL;
 
-    if (self->container->wait(self->container, state, timeout)) {
+    Py_BEGIN_ALLOW_THREADS
+    ret = self->container->wait(self->container, state, timeout);
+    Py_END_ALLOW_THREADS
+
+    if (ret) {
         Py_RETURN_TRUE;
     }
 
@@ -1531,6 +1697,13 @@ static PyMethodDef Container_methods[] = {
      "\n"
      "Get the current value of a cgroup entry."
     },
+    {"get_cgroup_items", (PyCFunction)Container_get_cgroup_items,
+     METH_VARARGS|METH_KEYWORDS,
+     "get_cgroup_items(keys) -> dict\n"
+     "\n"
+     "Get the current values of several cgroup entries at once. "
+     "Entries which could not be read are left out."
+    },
     {"get_config_item", (PyCFunction)Container_get_config_item,
      METH_VARARGS|METH_KEYWORDS,
      "get_config_item(key) -> string\n"
@@ -1724,6 +1897,60 @@ PyVarObject_HEAD_INIT(NULL, 0)
     Container_new,                  /* tp_new */
 };
 
+static PyObject *
+LXC_shutdown_containers(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"containers", "timeout", NULL};
+    struct lxc_container **containers = NULL;
+    PyObject *py_containers = NULL;
+    PyObject *seq = NULL;
+    int timeout = -1;
+    int count, i, ret;
+
+    if (! PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist,
+                                      &py_containers, &timeout))
+        return NULL;
+
+    seq = PySequence_Fast(py_containers, "containers must be a sequence");
+    if (!seq)
+        return NULL;
+
+    count = PySequence_Fast_GET_SIZE(seq);
+    containers = malloc((count ? count : 1) * sizeof(*containers));
+    if (!containers) {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+
+    for (i = 0; i < count; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+
+        if (!PyObject_TypeCheck(item, &_lxc_ContainerType)) {
+            PyErr_SetString(PyExc_TypeError,
+                            "containers must be Container objects");
+            free(containers);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        containers[i] = ((Container *)item)->container;
+    }
+
+    /* seq holds references to the containers until we are done */
+    Py_BEGIN_ALLOW_THREADS
+    ret = lxc_shutdown_containers(containers, count, timeout);
+    Py_END_ALLOW_THREADS
+
+    free(containers);
+    Py_DECREF(seq);
+
+    if (ret < 0) {
+        PyErr_SetString(PyExc_ValueError, "failure to shut down containers");
+        return NULL;
+    }
+
+    return PyLong_FromLong(ret);
+}
+
 static PyMethodDef LXC_methods[] = {
     {"arch_to_personality", (PyCFunction)LXC_arch_to_personality, METH_O,
      "Returns the process personality of the corresponding architecture"},
@@ -1741,6 +1968,10 @@ static PyMethodDef LXC_methods[] = {
     {"list_containers", (PyCFunction)LXC_list_containers,
      METH_VARARGS|METH_KEYWORDS,
      "Returns a list of container names or objects"},
+    {"shutdown_containers", (PyCFunction)LXC_shutdown_containers,
+     METH_VARARGS|METH_KEYWORDS,
+     "Shuts down several containers at once, stopping those still running "
+     "after timeout seconds. Returns the number of clean shutdowns"},
     {NULL, NULL, 0, NULL}
 };
 
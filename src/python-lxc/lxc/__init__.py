@@ -280,6 +280,16 @@ class Container(_lxc.Container):
         else:
             return value.rstrip("\n")
 
+    def get_cgroup_items(self, keys):
+        """
+            Returns a dict of the values for the given cgroup entries.
+            Entries which couldn't be read are left out.
+        """
+        values = _lxc.Container.get_cgroup_items(self, list(keys))
+
+        return dict((key, value.rstrip("\n"))
+                    for key, value in values.items())
+
     def get_config_item(self, key):
         """
             Returns the value for a given config key.
@@ -435,6 +445,19 @@ def list_containers(active=True, defined=True,
         return entries
 
 
+def shutdown_containers(containers, timeout=-1):
+    """
+        Shut down several containers in parallel.
+
+        The halt signal is sent to all of them at once and those still
+        running after timeout seconds are stopped. A timeout of -1 waits
+        forever. Returns the number of containers which shut down
+        cleanly.
+    """
+
+    return _lxc.shutdown_containers(containers, timeout)
+
+
 def attach_run_command(cmd):
     """
         Run a command when attaching
@@ -99,6 +99,32 @@ static int test_running_container(const char *lxcpath,
 		goto err3;
 	}
 
+	/* test reading several values at once */
+	{
+		const char *keys[] = { "memory.soft_limit_in_bytes",
+			"freezer.state", "memory.no_such_file", NULL };
+		struct lxc_cgroup_item *items;
+		int i, n;
+
+		n = c->get_cgroup_items(c, keys, &items);
+		if (n != 3) {
+			TSTERR("get_cgroup_items returned %d", n);
+			ret = -1;
+			goto err3;
+		}
+		if (!items[0].value || strcmp(items[0].value, "536870912\n") ||
+		    !items[1].value || strcmp(items[1].value, "THAWED\n") ||
+		    items[2].value) {
+			TSTERR("get_cgroup_items returned wrong values");
+			ret = -1;
+		}
+		for (i = 0; i < n; i++)
+			items[i].free(&items[i]);
+		free(items);
+		if (ret < 0)
+			goto err3;
+	}
+
 	/* restore original value */
 	ret = lxc_cgroup_set("memory.soft_limit_in_bytes", value_save,
 			     c->name, c->config_path);
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
+#include <time.h>
 #define _GNU_SOURCE
 #include <getopt.h>
 
@@ -34,6 +35,10 @@ static int quiet = 0;
 static int delay = 0;
 static const char *template = "busybox";
 
+/* in "read" mode, all threads read from the same container */
+#define READ_OPS 1000
+static struct lxc_container *reader;
+
 static const struct option options[] = {
     { "threads",     required_argument, NULL, 'j' },
     { "iterations",  required_argument, NULL, 'i' },
@@ -54,7 +59,7 @@ static void usage(void) {
         "  -i, --iterations=N           Number times to run the test (default: 1)\n"
         "  -t, --template=t             Template to use (default: busybox)\n"
         "  -d, --delay=N                Delay in seconds between start and stop\n"
-        "  -m, --modes=<mode,mode,...>  Modes to run (create, start, stop, destroy)\n"
+        "  -m, --modes=<mode,mode,...>  Modes to run (create, read, start, stop, destroy)\n"
         "  -q, --quiet                  Don't produce any output\n"
         "  -D, --debug                  Create a debug log\n"
         "  -?, --help                   Give this help list\n"
@@ -69,12 +74,36 @@ struct thread_args {
     const char *mode;
 };
 
+static void do_read(struct thread_args *args)
+{
+    char buf[4096];
+    int i;
+
+    args->return_code = 1;
+    for (i = 0; i < READ_OPS; i++) {
+        if (!reader->is_defined(reader)) {
+            fprintf(stderr, "Container (%s) is not defined...\n", reader->name);
+            return;
+        }
+        if (reader->get_config_item(reader, "lxc.utsname", buf, sizeof(buf)) < 0) {
+            fprintf(stderr, "Reading the config of (%s) failed...\n", reader->name);
+            return;
+        }
+    }
+    args->return_code = 0;
+}
+
 static void do_function(void *arguments)
 {
     char name[NAME_MAX+1];
     struct thread_args *args = arguments;
     struct lxc_container *c;
 
+    if (strcmp(args->mode, "read") == 0) {
+        do_read(args);
+        return;
+    }
+
     sprintf(name, "lxc-test-concurrent-%d", args->thread_id);
 
     args->return_code = 1;
@@ -148,8 +177,10 @@ int main(int argc, char *argv[]) {
     pthread_attr_t attr;
     pthread_t *threads;
     struct thread_args *args;
+    struct timespec begin, end;
+    double elapsed;
 
-    char *modes_default[] = {"create", "start", "stop", "destroy", NULL};
+    char *modes_default[] = {"create", "read", "start", "stop", "destroy", NULL};
     char **modes = modes_default;
 
     pthread_attr_init(&attr);
@@ -215,6 +246,14 @@ int main(int argc, char *argv[]) {
         for (i = 0; modes[i];i++) {
             if (!quiet)
                 printf("Executing (%s) for %d containers...\n", modes[i], nthreads);
+            if (strcmp(modes[i], "read") == 0) {
+                reader = lxc_container_new("lxc-test-concurrent-0", NULL);
+                if (!reader) {
+                    fprintf(stderr, "Unable to instantiate container (lxc-test-concurrent-0)\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &begin);
             for (j = 0; j < nthreads; j++) {
                 args[j].thread_id = j;
                 args[j].mode = modes[i];
@@ -241,6 +280,18 @@ int main(int argc, char *argv[]) {
                     exit(EXIT_FAILURE);
                 }
             }
+
+            if (reader) {
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                elapsed = end.tv_sec - begin.tv_sec +
+                          (end.tv_nsec - begin.tv_nsec) / 1e9;
+                if (!quiet)
+                    printf("%d reads in %.3fs (%.0f reads/s)\n",
+                           2 * READ_OPS * nthreads, elapsed,
+                           2 * READ_OPS * nthreads / elapsed);
+                lxc_container_put(reader);
+                reader = NULL;
+            }
         }
     }
 
@@ -0,0 +1,156 @@
+/* liblxcapi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Time the parsing of a large container configuration, as done by every
+ * lxc_container_new().
+ *
+ * usage: lxc-test-config-bench [iterations [networks [mount entries]]]
+ */
+#include <lxc/lxccontainer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MYNAME "lxctest1"
+
+static char lxcpath[] = "/tmp/lxc-config-bench-XXXXXX";
+static char cdir[sizeof(lxcpath) + sizeof(MYNAME) + 1];
+static char cfile[sizeof(cdir) + sizeof("/config.cache")];
+
+static int write_config(int networks, int mounts)
+{
+	FILE *f;
+	int i;
+
+	f = fopen(cfile, "w");
+	if (!f)
+		return -1;
+
+	fprintf(f, "# generated by lxc-test-config-bench\n");
+	fprintf(f, "lxc.utsname = %s\n", MYNAME);
+	fprintf(f, "lxc.rootfs = /var/lib/lxc/%s/rootfs\n", MYNAME);
+	fprintf(f, "lxc.tty = 4\n");
+	fprintf(f, "lxc.pts = 1024\n");
+	fprintf(f, "lxc.cgroup.devices.deny = a\n");
+	for (i = 0; i < networks; i++) {
+		fprintf(f, "lxc.network.type = veth\n");
+		fprintf(f, "lxc.network.flags = up\n");
+		fprintf(f, "lxc.network.link = lxcbr%d\n", i % 4);
+		fprintf(f, "lxc.network.name = eth%d\n", i);
+		fprintf(f, "lxc.network.hwaddr = 00:16:3e:%02x:%02x:%02x\n",
+			(i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+		fprintf(f, "lxc.network.ipv4 = 10.%d.%d.2/24\n",
+			(i >> 8) & 0xff, i & 0xff);
+	}
+	for (i = 0; i < networks; i++)
+		fprintf(f, "lxc.network.%d.mtu = 1400\n", i);
+	for (i = 0; i < mounts; i++)
+		fprintf(f, "lxc.mount.entry = /srv/data%d srv/data%d none bind,create=dir 0 0\n", i, i);
+
+	return fclose(f);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	struct lxc_container *c;
+	int i, iterations = 100, networks = 200, mounts = 500, ret = 1;
+	char key[64], buf[64];
+	double start, elapsed;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (argc > 2)
+		networks = atoi(argv[2]);
+	if (argc > 3)
+		mounts = atoi(argv[3]);
+	if (iterations < 1 || networks < 1 || mounts < 0) {
+		fprintf(stderr, "usage: %s [iterations [networks [mount entries]]]\n", argv[0]);
+		exit(1);
+	}
+
+	if (!mkdtemp(lxcpath)) {
+		perror("mkdtemp");
+		exit(1);
+	}
+	sprintf(cdir, "%s/%s", lxcpath, MYNAME);
+	sprintf(cfile, "%s/config", cdir);
+	if (mkdir(cdir, 0755) < 0) {
+		perror("mkdir");
+		goto out_lxcpath;
+	}
+	if (write_config(networks, mounts) < 0) {
+		fprintf(stderr, "%d: failed to write %s\n", __LINE__, cfile);
+		goto out_cdir;
+	}
+
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		c = lxc_container_new(MYNAME, lxcpath);
+		if (!c) {
+			fprintf(stderr, "%d: failed to load %s\n", __LINE__, cfile);
+			goto out_cfile;
+		}
+		if (i < iterations - 1)
+			lxc_container_put(c);
+	}
+	elapsed = now() - start;
+
+	/* the last nic must have been configured by both kinds of keys */
+	sprintf(key, "lxc.network.%d.link", networks - 1);
+	if (c->get_config_item(c, key, buf, sizeof(buf)) <= 0 ||
+	    strncmp(buf, "lxcbr", 5)) {
+		fprintf(stderr, "%d: bad value for %s\n", __LINE__, key);
+		lxc_container_put(c);
+		goto out_cfile;
+	}
+	sprintf(key, "lxc.network.%d.mtu", networks - 1);
+	if (c->get_config_item(c, key, buf, sizeof(buf)) <= 0 ||
+	    strcmp(buf, "1400")) {
+		fprintf(stderr, "%d: bad value for %s\n", __LINE__, key);
+		lxc_container_put(c);
+		goto out_cfile;
+	}
+	lxc_container_put(c);
+
+	printf("parsed %d lines %d times in %.3fs, %.3fms per config\n",
+	       6 * networks + networks + mounts + 6, iterations, elapsed,
+	       elapsed * 1000 / iterations);
+	ret = 0;
+
+out_cfile:
+	unlink(cfile);
+	/* written when lxc.config_cache is enabled */
+	strcat(cfile, ".cache");
+	unlink(cfile);
+out_cdir:
+	rmdir(cdir);
+out_lxcpath:
+	rmdir(lxcpath);
+	exit(ret);
+}
@@ -19,18 +19,29 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#define _GNU_SOURCE
 #include <lxc/lxccontainer.h>
 
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 
 #define TTYCNT      4
 #define TTYCNT_STR "4"
+#define CONSOLE_BUFSZ 65536
+#define CONSOLE_BUFSZ_STR "65536"
 #define TSTNAME    "lxcconsoletest"
 #define MAXCONSOLES 512
+#define THROUGHPUT_BYTES (16 * 1024 * 1024)
 
 #define TSTERR(fmt, ...) do { \
 	fprintf(stderr, "%s:%d " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__); \
@@ -108,6 +119,231 @@ err1:
 	return ret;
 }
 
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define LOG_MARKER "lxc-console-log-marker"
+#define LOG_LINES_STR "2000"
+
+/* Write something to /dev/console from within the container */
+static int test_console_write(struct lxc_container *c, const char *cmd)
+{
+	lxc_attach_options_t attach_options = LXC_ATTACH_OPTIONS_DEFAULT;
+	int ret;
+
+	ret = c->attach_run_waitl(c, &attach_options, "/bin/sh", "sh", "-c",
+				  cmd, NULL);
+	if (ret < 0 || !WIFEXITED(ret) || WEXITSTATUS(ret)) {
+		TSTERR("failed to run '%s' in the container: %d", cmd, ret);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * The console output goes through the container's mainloop, so wait
+ * for marker to show up in the console log.  Returns the log length and
+ * the log in buf, or -1.
+ */
+static int test_console_log_wait(struct lxc_container *c, const char *marker,
+				 char **buf)
+{
+	double end = now() + 10;
+	int len;
+
+	while (now() < end) {
+		len = c->console_log(c, false, buf);
+		if (len < 0) {
+			TSTERR("console log returned %d", len);
+			return -1;
+		}
+		if (len > 0 && memmem(*buf, len, marker, strlen(marker)))
+			return len;
+		free(*buf);
+		usleep(100000);
+	}
+	TSTERR("'%s' not found in the console log", marker);
+	return -1;
+}
+
+static int test_console_log(struct lxc_container *c)
+{
+	char *buf, *first, *second;
+	int len;
+
+	/* whatever the container wrote so far, up to the buffer size */
+	len = c->console_log(c, true, &buf);
+	if (len < 0 || len > CONSOLE_BUFSZ) {
+		TSTERR("console log returned %d", len);
+		return -1;
+	}
+	free(buf);
+
+	if (test_console_write(c, "echo " LOG_MARKER " > /dev/console") < 0)
+		return -1;
+	len = test_console_log_wait(c, LOG_MARKER, &buf);
+	if (len < 0)
+		return -1;
+	free(buf);
+
+	/* reading with clear empties the log */
+	len = c->console_log(c, true, &buf);
+	if (len <= 0) {
+		TSTERR("console log returned %d", len);
+		return -1;
+	}
+	free(buf);
+	len = c->console_log(c, true, &buf);
+	if (len != 0) {
+		TSTERR("console log not cleared, %d bytes left", len);
+		free(buf);
+		return -1;
+	}
+	free(buf);
+
+	/* overflow the log, only the newest output is to be kept */
+	if (test_console_write(c, "(echo " LOG_MARKER "-start; i=0; "
+			       "while [ $i -lt " LOG_LINES_STR " ]; do "
+			       "echo \"line $i ................................\"; "
+			       "i=$((i+1)); done; "
+			       "echo " LOG_MARKER "-end) > /dev/console") < 0)
+		return -1;
+	len = test_console_log_wait(c, LOG_MARKER "-end", &buf);
+	if (len < 0)
+		return -1;
+	if (len != CONSOLE_BUFSZ) {
+		TSTERR("console log is %d bytes, not %d", len, CONSOLE_BUFSZ);
+		goto err;
+	}
+	if (memmem(buf, len, LOG_MARKER "-start", strlen(LOG_MARKER "-start"))) {
+		TSTERR("oldest output was not dropped from the console log");
+		goto err;
+	}
+	first = memmem(buf, len, "line 1998 ", 10);
+	second = memmem(buf, len, "line 1999 ", 10);
+	if (!first || !second || first > second ||
+	    !memmem(second, len - (second - buf), LOG_MARKER "-end",
+		    strlen(LOG_MARKER "-end"))) {
+		TSTERR("console log is not in order");
+		goto err;
+	}
+	free(buf);
+	return 0;
+
+err:
+	free(buf);
+	return -1;
+}
+
+/*
+ * Wait for the console client in pid to exit, draining what it writes
+ * to its terminal meanwhile. Returns its exit status or -1 on timeout.
+ */
+static int test_console_reap(pid_t pid, int master)
+{
+	char buf[4096];
+	struct pollfd pfd = { .fd = master, .events = POLLIN };
+	double end = now() + 10;
+	int status;
+
+	while (now() < end) {
+		if (waitpid(pid, &status, WNOHANG) == pid)
+			return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+		if (poll(&pfd, 1, 100) > 0 && read(master, buf, sizeof(buf)) < 0 &&
+		    errno != EAGAIN)
+			usleep(10000);
+	}
+	kill(pid, SIGKILL);
+	waitpid(pid, &status, 0);
+	return -1;
+}
+
+/*
+ * Push data through lxc_console(), as if pasted in the terminal, and
+ * check that Ctrl+a q right behind it ends the console.
+ */
+static int test_console_throughput(struct lxc_container *c)
+{
+	char in[65536], out[4096];
+	struct pollfd pfd;
+	int master, slave, ret;
+	size_t total = 0;
+	double start, elapsed;
+	ssize_t n;
+	pid_t pid;
+
+	if (openpty(&master, &slave, NULL, NULL, NULL)) {
+		TSTERR("openpty failed: %s", strerror(errno));
+		return -1;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		TSTERR("fork failed: %s", strerror(errno));
+		close(master);
+		close(slave);
+		return -1;
+	}
+	if (!pid) {
+		close(master);
+		exit(c->console(c, 1, slave, slave, 2, 1) ? 1 : 0);
+	}
+	close(slave);
+	fcntl(master, F_SETFL, O_NONBLOCK);
+
+	/* no escape character in there */
+	memset(in, 'x', sizeof(in));
+	pfd.fd = master;
+	start = now();
+	while (total < THROUGHPUT_BYTES) {
+		pfd.events = POLLIN | POLLOUT;
+		if (poll(&pfd, 1, 5000) <= 0) {
+			TSTERR("console stalled after %zu bytes", total);
+			goto err;
+		}
+		if (pfd.revents & (POLLERR | POLLHUP)) {
+			TSTERR("console exited after %zu bytes", total);
+			goto err;
+		}
+		/* the echo of the container tty */
+		if (pfd.revents & POLLIN)
+			n = read(master, out, sizeof(out));
+		if (pfd.revents & POLLOUT) {
+			n = write(master, in, sizeof(in));
+			if (n > 0)
+				total += n;
+		}
+	}
+	elapsed = now() - start;
+
+	if (write(master, "\001q", 2) != 2) {
+		TSTERR("failed to send the escape sequence");
+		goto err;
+	}
+	ret = test_console_reap(pid, master);
+	close(master);
+	if (ret) {
+		TSTERR("console did not exit cleanly on Ctrl+a q: %d", ret);
+		return -1;
+	}
+
+	printf("console: %d MiB in %.2fs, %.1f MiB/s\n",
+	       THROUGHPUT_BYTES >> 20, elapsed,
+	       THROUGHPUT_BYTES / elapsed / (1 << 20));
+	return 0;
+
+err:
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	close(master);
+	return -1;
+}
+
 /* test_container: test console function
  *
  * @lxcpath  : the lxcpath in which to create the container
@@ -146,6 +382,7 @@ static int test_console(const char *lxcpath,
 	}
 	c->load_config(c, NULL);
 	c->set_config_item(c, "lxc.tty", TTYCNT_STR);
+	c->set_config_item(c, "lxc.console.buffer.size", CONSOLE_BUFSZ_STR);
 	c->save_config(c, NULL);
 	c->want_daemonize(c, true);
 	if (!c->startl(c, 0, NULL)) {
@@ -154,6 +391,10 @@ static int test_console(const char *lxcpath,
 	}
 
 	ret = test_console_running_container(c);
+	if (!ret)
+		ret = test_console_log(c);
+	if (!ret)
+		ret = test_console_throughput(c);
 
 	c->stop(c);
 out3:
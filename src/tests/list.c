@@ -78,6 +78,46 @@ static void test_list_func(const char *lxcpath, const char *type,
 	}
 }
 
+static void test_list_lazy(const char *lxcpath, const char *type, int flags,
+			   int (*func)(const char *path, char ***names,
+				       struct lxc_container ***cret))
+{
+	struct lxc_container_list *list;
+	struct lxc_container *c;
+	char **names;
+	int i, n;
+
+	printf("%-10s Listing containers lazily\n", type);
+	list = lxc_container_list_new(lxcpath, flags);
+	if (!list) {
+		fprintf(stderr, "ERROR: could not list containers\n");
+		return;
+	}
+
+	n = func(lxcpath, &names, NULL);
+	if (n != lxc_container_list_count(list))
+		printf("Warning: list has %d containers, expected %d\n",
+		       lxc_container_list_count(list), n);
+	for (i = 0; i < n; i++) {
+		if (i < lxc_container_list_count(list) &&
+		    strcmp(names[i], lxc_container_list_name(list, i)))
+			fprintf(stderr, "ERROR: name mismatch!\n");
+		free(names[i]);
+	}
+	if (n > 0)
+		free(names);
+
+	for (i = 0; i < lxc_container_list_count(list); i++) {
+		c = lxc_container_list_get(list, i);
+		if (!c)
+			continue;
+		printf("%-10s  Loaded container struct %s\n", type, c->name);
+		if (c != lxc_container_list_get(list, i))
+			fprintf(stderr, "ERROR: container loaded twice!\n");
+	}
+	lxc_container_list_free(list);
+}
+
 int main(int argc, char *argv[])
 {
 	const char *lxcpath = NULL;
@@ -88,6 +128,8 @@ int main(int argc, char *argv[])
 	test_list_func(lxcpath, "Defined:", list_defined_containers);
 	test_list_func(lxcpath, "Active:", list_active_containers);
 	test_list_func(lxcpath, "All:", list_all_containers);
+	test_list_lazy(lxcpath, "Defined:", LXC_LIST_DEFINED, list_defined_containers);
+	test_list_lazy(lxcpath, "All:", LXC_LIST_ALL, list_all_containers);
 
 	exit(0);
 }
@@ -24,9 +24,21 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <time.h>
 
 #define mycontainername "lxctest.sem"
 #define TIMEOUT_SECS 3
+#define READERS 8
+#define HOLD_USECS 100000
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
 static void test_two_locks(void)
 {
@@ -93,6 +105,135 @@ static void test_two_locks(void)
 	lxc_putlock(l);
 }
 
+/*
+ * A shared lock held by the parent lets a child in for reading, but
+ * not for writing until the parent lets go.
+ */
+static void test_shared_locks(void)
+{
+	struct lxc_lock *l;
+	pid_t pid;
+	int status;
+	double start;
+
+	l = lxc_newlock("/tmp", "lxctest-sem");
+	if (!l || lxclock_shared(l, 0) < 0) {
+		fprintf(stderr, "%d: failed to take shared lock\n", __LINE__);
+		exit(1);
+	}
+	if ((pid = fork()) < 0)
+		exit(1);
+	if (pid == 0) {
+		l = lxc_newlock("/tmp", "lxctest-sem");
+		if (!l || lxclock_shared(l, 1) < 0) {
+			fprintf(stderr, "%d: child: failed to share lock\n", __LINE__);
+			exit(1);
+		}
+		lxcunlock(l);
+		start = now();
+		if (lxclock(l, 1) != -1 || errno != ETIMEDOUT) {
+			fprintf(stderr, "%d: child: took a shared lock exclusively\n", __LINE__);
+			exit(1);
+		}
+		if (now() - start < 0.9 || now() - start > 1.5) {
+			fprintf(stderr, "%d: child: timeout took %.2fs\n", __LINE__,
+				now() - start);
+			exit(1);
+		}
+		if (lxclock(l, TIMEOUT_SECS) < 0) {
+			fprintf(stderr, "%d: child: failed to grab released lock\n", __LINE__);
+			exit(1);
+		}
+		lxcunlock(l);
+		lxc_putlock(l);
+		exit(0);
+	}
+	sleep(2);
+	lxcunlock(l);
+	lxc_putlock(l);
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "%d: shared lock test failed\n", __LINE__);
+		exit(1);
+	}
+}
+
+/*
+ * Have READERS processes each hold the lock for HOLD_USECS, and return
+ * the time it took them all.
+ */
+static double time_readers(int shared)
+{
+	struct lxc_lock *l;
+	pid_t pids[READERS];
+	double start;
+	int i, ret, status;
+
+	start = now();
+	for (i = 0; i < READERS; i++) {
+		if ((pids[i] = fork()) < 0)
+			exit(1);
+		if (pids[i] == 0) {
+			l = lxc_newlock("/tmp", "lxctest-sem");
+			if (!l)
+				exit(1);
+			ret = shared ? lxclock_shared(l, 0) : lxclock(l, 0);
+			if (ret < 0)
+				exit(1);
+			usleep(HOLD_USECS);
+			lxcunlock(l);
+			lxc_putlock(l);
+			exit(0);
+		}
+	}
+	for (i = 0; i < READERS; i++) {
+		if (waitpid(pids[i], &status, 0) != pids[i] ||
+		    !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			fprintf(stderr, "%d: reader %d failed\n", __LINE__, i);
+			exit(1);
+		}
+	}
+	return now() - start;
+}
+
+static void test_reader_throughput(void)
+{
+	double exclusive, shared;
+
+	exclusive = time_readers(0);
+	shared = time_readers(1);
+	printf("%d readers holding the lock for %dms: %.0fms exclusive, %.0fms shared\n",
+		READERS, HOLD_USECS / 1000, exclusive * 1000, shared * 1000);
+	if (shared * 2 > exclusive) {
+		fprintf(stderr, "%d: shared lock readers were serialized\n", __LINE__);
+		exit(1);
+	}
+}
+
+static void test_rwlock(void)
+{
+	struct lxc_lock *l;
+
+	l = lxc_newrwlock();
+	if (!l) {
+		fprintf(stderr, "%d: failed to get rwlock\n", __LINE__);
+		exit(1);
+	}
+	if (lxclock_shared(l, 0) || lxclock_shared(l, 1)) {
+		fprintf(stderr, "%d: failed to share rwlock\n", __LINE__);
+		exit(1);
+	}
+	if (lxcunlock(l) || lxcunlock(l)) {
+		fprintf(stderr, "%d: failed to put shared rwlock\n", __LINE__);
+		exit(1);
+	}
+	if (lxclock(l, 1) || lxcunlock(l)) {
+		fprintf(stderr, "%d: failed to take rwlock\n", __LINE__);
+		exit(1);
+	}
+	lxc_putlock(l);
+}
+
 int main(int argc, char *argv[])
 {
 	int ret;
@@ -132,6 +273,9 @@ int main(int argc, char *argv[])
 	lxc_putlock(lock);
 
 	test_two_locks();
+	test_shared_locks();
+	test_reader_throughput();
+	test_rwlock();
 
 	fprintf(stderr, "all tests passed\n");
 
@@ -0,0 +1,138 @@
+/* liblxcapi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Time the start of a container at each log level, with the log file
+ * written event by event and through a log buffer.  Must be run as root.
+ *
+ * usage: lxc-test-log-bench [iterations [template]]
+ */
+#include <lxc/lxccontainer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MYNAME "lxctest1"
+#define LOGFILE "/tmp/lxc-log-bench.log"
+
+static const char *levels[] = {
+	"TRACE", "DEBUG", "INFO", "NOTICE", "WARN", "ERROR", NULL
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Start and stop the container iterations times with the given log
+ * settings.  Returns the average start time in seconds, < 0 on error.
+ */
+static double bench(struct lxc_container *c, int iterations,
+		    const char *level, const char *buffer, long *logsize)
+{
+	double start, elapsed = 0;
+	struct stat st;
+	int i;
+
+	unlink(LOGFILE);
+	if (!c->set_config_item(c, "lxc.loglevel", level) ||
+	    !c->set_config_item(c, "lxc.logfile", LOGFILE) ||
+	    !c->set_config_item(c, "lxc.logfile.buffer", buffer)) {
+		fprintf(stderr, "%d: failed to set the log options\n", __LINE__);
+		return -1;
+	}
+
+	for (i = 0; i < iterations; i++) {
+		start = now();
+		if (!c->startl(c, 0, NULL)) {
+			fprintf(stderr, "%d: failed to start %s\n", __LINE__, c->name);
+			return -1;
+		}
+		elapsed += now() - start;
+
+		if (!c->stop(c) || !c->wait(c, "STOPPED", 30)) {
+			fprintf(stderr, "%d: failed to stop %s\n", __LINE__, c->name);
+			return -1;
+		}
+	}
+
+	*logsize = stat(LOGFILE, &st) ? 0 : st.st_size;
+	return elapsed / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+	struct lxc_container *c;
+	const char *template = "busybox";
+	int i, iterations = 5, ret = 1;
+	double plain, buffered;
+	long logsize;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (argc > 2)
+		template = argv[2];
+	if (iterations < 1) {
+		fprintf(stderr, "usage: %s [iterations [template]]\n", argv[0]);
+		exit(1);
+	}
+
+	c = lxc_container_new(MYNAME, NULL);
+	if (!c) {
+		fprintf(stderr, "%d: failed to load %s\n", __LINE__, MYNAME);
+		exit(1);
+	}
+	if (c->is_defined(c)) {
+		fprintf(stderr, "%d: %s already exists\n", __LINE__, MYNAME);
+		goto out;
+	}
+	if (!c->createl(c, template, NULL, NULL, 0, NULL)) {
+		fprintf(stderr, "%d: failed to create %s\n", __LINE__, MYNAME);
+		goto out;
+	}
+	c->want_daemonize(c, true);
+
+	printf("%-8s %12s %12s %12s\n", "level", "unbuffered", "buffered",
+	       "log/start");
+	for (i = 0; levels[i]; i++) {
+		plain = bench(c, iterations, levels[i], "0", &logsize);
+		if (plain < 0)
+			goto out_destroy;
+		buffered = bench(c, iterations, levels[i], "65536", &logsize);
+		if (buffered < 0)
+			goto out_destroy;
+		printf("%-8s %10.1fms %10.1fms %10ldkB\n", levels[i],
+		       plain * 1000, buffered * 1000, logsize / 1024 / iterations);
+	}
+	ret = 0;
+
+out_destroy:
+	if (c->is_running(c))
+		c->stop(c);
+	c->destroy(c);
+	unlink(LOGFILE);
+out:
+	lxc_container_put(c);
+	exit(ret);
+}
@@ -0,0 +1,284 @@
+/* liblxcapi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Compare the TCP throughput between two network namespaces linked by a
+ * veth pair and by two ipvlan interfaces, as lxc would set them up for two
+ * containers.  Everything happens in a scratch network namespace, so the
+ * host network is left alone.  Must be run as root.
+ *
+ * usage: lxc-test-netdev-bench [seconds]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "lxc/network.h"
+
+#define PORT 5555
+#define IPVLAN_MODE_L2 0
+
+struct peer {
+	pid_t pid;
+	int go[2];		/* the parent moved our interface */
+	int result[2];		/* bytes received, from the server */
+};
+
+static int seconds = 2;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int setup_addr(const char *ifname, const char *addr)
+{
+	struct in_addr in, bcast;
+	int ifindex;
+
+	ifindex = if_nametoindex(ifname);
+	if (!ifindex) {
+		fprintf(stderr, "%d: no interface %s\n", __LINE__, ifname);
+		return -1;
+	}
+	inet_pton(AF_INET, addr, &in);
+	inet_pton(AF_INET, "10.200.0.255", &bcast);
+	if (lxc_ipv4_addr_add(ifindex, &in, &bcast, 24) ||
+	    lxc_netdev_up(ifname) || lxc_netdev_up("lo")) {
+		fprintf(stderr, "%d: failed to configure %s\n", __LINE__, ifname);
+		return -1;
+	}
+	return 0;
+}
+
+static int serve(struct peer *p)
+{
+	char buf[65536];
+	long long total = 0;
+	int fd, conn, one = 1;
+	ssize_t ret;
+	struct sockaddr_in sin = {
+		.sin_family = AF_INET,
+		.sin_port = htons(PORT),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) || listen(fd, 1))
+		return -1;
+	conn = accept(fd, NULL, NULL);
+	if (conn < 0)
+		return -1;
+	while ((ret = read(conn, buf, sizeof(buf))) > 0)
+		total += ret;
+	close(conn);
+	close(fd);
+	if (write(p->result[1], &total, sizeof(total)) != sizeof(total))
+		return -1;
+	return 0;
+}
+
+static int send_to(const char *addr)
+{
+	static char buf[65536];
+	struct sockaddr_in sin = {
+		.sin_family = AF_INET,
+		.sin_port = htons(PORT),
+	};
+	double end;
+	int fd, i;
+
+	inet_pton(AF_INET, addr, &sin.sin_addr);
+	/* the server may not listen yet */
+	for (i = 0; i < 100; i++) {
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		if (!connect(fd, (struct sockaddr *)&sin, sizeof(sin)))
+			break;
+		close(fd);
+		fd = -1;
+		usleep(20000);
+	}
+	if (fd < 0)
+		return -1;
+
+	end = now() + seconds;
+	while (now() < end) {
+		if (write(fd, buf, sizeof(buf)) < 0)
+			return -1;
+	}
+	close(fd);
+	return 0;
+}
+
+static int start_peer(struct peer *p, const char *ifname, const char *addr,
+		      const char *server)
+{
+	char c;
+
+	if (pipe(p->go) || pipe(p->result))
+		return -1;
+
+	p->pid = fork();
+	if (p->pid < 0)
+		return -1;
+	if (p->pid) {
+		close(p->go[0]);
+		close(p->result[1]);
+		return 0;
+	}
+
+	close(p->go[1]);
+	close(p->result[0]);
+	if (unshare(CLONE_NEWNET)) {
+		perror("unshare");
+		exit(1);
+	}
+	if (write(p->result[1], "", 1) != 1 || read(p->go[0], &c, 1) != 1)
+		exit(1);
+	if (setup_addr(ifname, addr))
+		exit(1);
+	if (server)
+		exit(send_to(server) ? 1 : 0);
+	exit(serve(p) ? 1 : 0);
+}
+
+static int wait_peer(struct peer *p)
+{
+	int status;
+
+	close(p->go[1]);
+	close(p->result[0]);
+	if (waitpid(p->pid, &status, 0) < 0)
+		return -1;
+	return WIFEXITED(status) && !WEXITSTATUS(status) ? 0 : -1;
+}
+
+/*
+ * Run the client in one namespace and the server in another, once the
+ * two interfaces named a and b in the scratch namespace have been moved
+ * to them.  Returns the throughput in Mbit/s, < 0 on error.
+ */
+static double bench(const char *a, const char *b)
+{
+	struct peer server, client;
+	long long total;
+	double begin, elapsed;
+	char c;
+
+	if (start_peer(&server, b, "10.200.0.2", NULL) ||
+	    start_peer(&client, a, "10.200.0.1", "10.200.0.2"))
+		return -1;
+
+	/* both are in their namespace when they wrote to the result pipe */
+	if (read(server.result[0], &c, 1) != 1 ||
+	    read(client.result[0], &c, 1) != 1)
+		return -1;
+
+	if (lxc_netdev_move_by_name((char *)a, client.pid) ||
+	    lxc_netdev_move_by_name((char *)b, server.pid)) {
+		fprintf(stderr, "%d: failed to move %s and %s\n", __LINE__, a, b);
+		kill(server.pid, SIGKILL);
+		kill(client.pid, SIGKILL);
+		wait_peer(&server);
+		wait_peer(&client);
+		return -1;
+	}
+
+	begin = now();
+	if (write(server.go[1], "", 1) != 1 || write(client.go[1], "", 1) != 1)
+		return -1;
+	if (read(server.result[0], &total, sizeof(total)) != sizeof(total))
+		total = -1;
+	elapsed = now() - begin;
+
+	if (wait_peer(&client) || wait_peer(&server) || total < 0)
+		return -1;
+
+	return total * 8 / elapsed / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+	double veth, ipvlan;
+	int err;
+
+	if (argc > 1)
+		seconds = atoi(argv[1]);
+	if (seconds < 1) {
+		fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+		exit(1);
+	}
+
+	if (unshare(CLONE_NEWNET)) {
+		perror("unshare");
+		exit(1);
+	}
+
+	if (lxc_veth_create("bench-a", "bench-b")) {
+		fprintf(stderr, "%d: failed to create the veth pair\n", __LINE__);
+		exit(1);
+	}
+	veth = bench("bench-a", "bench-b");
+	if (veth < 0) {
+		fprintf(stderr, "%d: veth run failed\n", __LINE__);
+		exit(1);
+	}
+	printf("veth:   %10.1f Mbit/s\n", veth);
+
+	/* the ipvlan interfaces hang off one side of a veth pair */
+	if (lxc_veth_create("bench-m", "bench-n") || lxc_netdev_up("bench-m")) {
+		fprintf(stderr, "%d: failed to create the ipvlan master\n", __LINE__);
+		exit(1);
+	}
+	err = lxc_ipvlan_create("bench-m", "bench-c", IPVLAN_MODE_L2);
+	if (err == -EOPNOTSUPP) {
+		printf("ipvlan: not supported by the kernel, skipped\n");
+		exit(0);
+	}
+	if (err || lxc_ipvlan_create("bench-m", "bench-d", IPVLAN_MODE_L2)) {
+		fprintf(stderr, "%d: failed to create the ipvlan interfaces\n", __LINE__);
+		exit(1);
+	}
+	ipvlan = bench("bench-c", "bench-d");
+	if (ipvlan < 0) {
+		fprintf(stderr, "%d: ipvlan run failed\n", __LINE__);
+		exit(1);
+	}
+	printf("ipvlan: %10.1f Mbit/s (%+.0f%% over veth)\n", ipvlan,
+	       (ipvlan - veth) * 100 / veth);
+
+	exit(0);
+}
@@ -77,6 +77,22 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
+	/* Again, through the fleet shutdown */
+	if (!c->startl(c, 0, NULL)) {
+		fprintf(stderr, "%d: failed to restart %s\n", __LINE__, MYNAME);
+		goto out;
+	}
+	sleep(10);
+
+	if (lxc_shutdown_containers(&c, 1, 60) != 1) {
+		fprintf(stderr, "%d: failed to shut down %s with lxc_shutdown_containers\n", __LINE__, MYNAME);
+		goto out;
+	}
+	if (c->is_running(c)) {
+		fprintf(stderr, "%d: %s still running after shutdown\n", __LINE__, MYNAME);
+		goto out;
+	}
+
 	if (!c->destroy(c)) {
 		fprintf(stderr, "%d: error deleting %s\n", __LINE__, MYNAME);
 		goto out;
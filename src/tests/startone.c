@@ -183,6 +183,45 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
+	/* repeated queries share one connection to the command socket */
+	pid_t initpid = c->init_pid(c);
+	for (len = 0; len < 100; len++) {
+		s = c->state(c);
+		if (!s || strcmp(s, "RUNNING") || c->init_pid(c) != initpid) {
+			fprintf(stderr, "%d: %s changed state or init pid on query %d\n", __LINE__, c->name, len);
+			goto out;
+		}
+	}
+
+	/* states served from the monitor stream agree with the container */
+	if (!lxc_state_cache_enable(c->config_path, 1000)) {
+		fprintf(stderr, "%d: failed to enable the state cache\n", __LINE__);
+		goto out;
+	}
+	for (len = 0; len < 100; len++) {
+		if (!c->is_running(c)) {
+			fprintf(stderr, "%d: %s not running with the state cache\n", __LINE__, c->name);
+			lxc_state_cache_disable(c->config_path);
+			goto out;
+		}
+	}
+	lxc_state_cache_disable(c->config_path);
+
+	/* the container registered itself as running */
+	char **active;
+	int nactive = list_active_containers(c->config_path, &active, NULL);
+	for (len = 0, b = false; len < nactive; len++) {
+		if (!strcmp(active[len], MYNAME))
+			b = true;
+		free(active[len]);
+	}
+	if (nactive > 0)
+		free(active);
+	if (!b) {
+		fprintf(stderr, "%d: %s is not listed as active\n", __LINE__, c->name);
+		goto out;
+	}
+
 	len = c->get_cgroup_item(c, "cpuset.cpus", buf, 0);
 	if (len <= 0) {
 		fprintf(stderr, "%d: not able to get length of cpuset.cpus (ret %d)\n", __LINE__, len);
@@ -212,6 +251,32 @@ int main(int argc, char *argv[])
 	c->set_cgroup_item(c, "freezer.state", "THAWED");
 
 	c->stop(c);
+	c->wait(c, "STOPPED", 5);
+
+	/* park it, then run init in it */
+	if (!c->park(c)) {
+		fprintf(stderr, "%d: failed to park %s\n", __LINE__, c->name);
+		goto out;
+	}
+	if (strcmp(c->state(c), "PARKED")) {
+		fprintf(stderr, "%d: %s is %s instead of parked\n", __LINE__, c->name, c->state(c));
+		goto out;
+	}
+	char *init_args[] = { "/sbin/init", NULL };
+	if (!c->unpark(c, init_args)) {
+		fprintf(stderr, "%d: failed to unpark %s\n", __LINE__, c->name);
+		goto out;
+	}
+	if (strcmp(c->state(c), "RUNNING")) {
+		fprintf(stderr, "%d: %s is %s after unparking\n", __LINE__, c->name, c->state(c));
+		goto out;
+	}
+	if (c->unpark(c, init_args)) {
+		fprintf(stderr, "%d: unparked %s twice\n", __LINE__, c->name);
+		goto out;
+	}
+
+	c->stop(c);
 
     /* feh - multilib has moved the lxc-init crap */
 #if 0